@@ -0,0 +1,556 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <ftw.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+/**
+ *  Turns the searches recorded by the audit library (AUDIT_LIBSTDCXX_RECORD, see objsearch_record.h) into per-executable
+ *  recommendations for DT_RUNPATH/DT_RPATH: prune the entries no library was ever found in, and reorder the others so the
+ *  most used ones, and the shipped libstdc++, are searched first.
+ *
+ *  Usage: analyze_objsearch [-r report] <recording or directory of recordings>...
+ *    -r report  Write the report to this file instead of stdout
+ *
+ *  Recordings of the same executable are aggregated. Each probe of DT_RUNPATH/DT_RPATH (ld.so's and the audit library's)
+ *  is attributed to the entry of the requesting object it expands to, or else to the DT_RPATH of the executable, which its
+ *  dependencies inherit. An entry is only moved ahead of another if it does not hold any library found in the other one,
+ *  so the recommended order loads the same files. The recommendation only covers the runs recorded: an entry used by
+ *  a code path that was not exercised is pruned too.
+ *
+ *  The report, per executable:
+ *    <executable> runs=<n> probes=<n> misses=<n> miss_time=<us>us
+ *      object <path> <DT_RUNPATH|DT_RPATH>="<entries>"
+ *        [<index>] <entry> hits=<n> misses=<n> miss_time=<us>us <keep|prune> [libstdc++]
+ *        recommend <DT_RUNPATH|DT_RPATH>="<entries>" misses=<n>-><n> [libstdc++ <index>-><index>]
+ *      other <flag> probes=<n> misses=<n> miss_time=<us>us
+ */
+
+#define MAX_ENTRIES 64
+#define MAX_NAMES 32
+#define LIBSTDCXX_SONAME "libstdc++.so.6"
+
+typedef struct {
+  char* text;
+  char* dir;
+  unsigned long hits;
+  unsigned long misses;
+  uint64_t miss_ns;
+  int has_libstdcxx;
+  size_t num_names;
+  char* names[MAX_NAMES];
+} entry_t;
+
+typedef struct {
+  char* path;
+  int is_runpath;
+  char* dt_path;
+  // Searches that went through every entry without a hit
+  unsigned long pass_through;
+  size_t num_entries;
+  entry_t entries[MAX_ENTRIES];
+} object_stats_t;
+
+// Probes outside of DT_RUNPATH/DT_RPATH, by flag of la_objsearch
+// The last one collects the DT_RUNPATH/DT_RPATH probes that match no entry
+static const char* const other_flags[] = {"orig", "libpath", "cache", "default", "secure", "unknown", "unattributed"};
+#define NUM_OTHER_FLAGS (sizeof(other_flags) / sizeof(other_flags[0]))
+
+typedef struct {
+  char* exe;
+  unsigned long runs;
+  size_t num_objects;
+  object_stats_t** objects;
+  unsigned long other_probes[NUM_OTHER_FLAGS];
+  unsigned long other_misses[NUM_OTHER_FLAGS];
+  uint64_t other_miss_ns[NUM_OTHER_FLAGS];
+} exe_stats_t;
+
+static size_t num_exes = 0;
+static exe_stats_t** exes = NULL;
+
+static size_t num_recordings = 0;
+static char** recordings = NULL;
+
+static char* copy_string(const char* const str) {
+  char* const copy = strdup(str);
+  ASSERT(copy, "Out of memory\n");
+  return copy;
+}
+
+static exe_stats_t* find_exe(const char* const exe) {
+  for (size_t i = 0; i < num_exes; i++) {
+    if (0 == strcmp(exes[i]->exe, exe)) {
+      return exes[i];
+    }
+  }
+  exes = (exe_stats_t**)realloc(exes, (num_exes + 1) * sizeof(exe_stats_t*));
+  exe_stats_t* const stats = (exe_stats_t*)calloc(1, sizeof(exe_stats_t));
+  ASSERT(exes && stats, "Out of memory\n");
+  stats->exe = copy_string(exe);
+  exes[num_exes++] = stats;
+  return stats;
+}
+
+/**
+ * Expand an entry of DT_RUNPATH/DT_RPATH into the directory ld.so probes: $ORIGIN substituted, trailing slashes removed
+ */
+static char* expand_entry(const char* const text, const size_t len_text, const char* const ORIGIN) {
+  char dir[PATH_MAX];
+  if ((len_text >= 9) && (0 == strncmp(text, "${ORIGIN}", 9))) {
+    snprintf(dir, sizeof(dir), "%s%.*s", ORIGIN, (int)(len_text - 9), text + 9);
+  } else if ((len_text >= 7) && (0 == strncmp(text, "$ORIGIN", 7))) {
+    snprintf(dir, sizeof(dir), "%s%.*s", ORIGIN, (int)(len_text - 7), text + 7);
+  } else {
+    snprintf(dir, sizeof(dir), "%.*s", (int)len_text, text);
+  }
+  for (size_t len = strlen(dir); (len > 1) && (dir[len - 1] == '/'); len--) {
+    dir[len - 1] = '\0';
+  }
+  return copy_string(dir);
+}
+
+/**
+ * Find the statistics of an object of an executable, created from its recorded DT_RUNPATH/DT_RPATH on first sight
+ */
+static object_stats_t* find_object(exe_stats_t* const exe, const char* const path, const char* const ORIGIN, const char* const dt_runpath, const char* const dt_rpath) {
+  for (size_t i = 0; i < exe->num_objects; i++) {
+    if (0 == strcmp(exe->objects[i]->path, path)) {
+      return exe->objects[i];
+    }
+  }
+  exe->objects = (object_stats_t**)realloc(exe->objects, (exe->num_objects + 1) * sizeof(object_stats_t*));
+  object_stats_t* const object = (object_stats_t*)calloc(1, sizeof(object_stats_t));
+  ASSERT(exe->objects && object, "Out of memory\n");
+  object->path = copy_string(path);
+  // ld.so ignores DT_RPATH when there is a DT_RUNPATH
+  object->is_runpath = (dt_runpath[0] != '\0');
+  object->dt_path = copy_string(object->is_runpath ? dt_runpath : dt_rpath);
+  const char* cursor = object->dt_path;
+  while ((*cursor != '\0') && (object->num_entries < MAX_ENTRIES)) {
+    const char* end = strchr(cursor, ':');
+    const size_t len_text = (NULL != end) ? (size_t)(end - cursor) : strlen(cursor);
+    if (len_text > 0) {
+      entry_t* const entry = &object->entries[object->num_entries++];
+      entry->text = strndup(cursor, len_text);
+      ASSERT(entry->text, "Out of memory\n");
+      entry->dir = expand_entry(cursor, len_text, ORIGIN);
+    }
+    cursor += len_text + ((NULL != end) ? 1 : 0);
+  }
+  exe->objects[exe->num_objects++] = object;
+  return object;
+}
+
+/**
+ * Find the entry of `object` that expands to `dir`. The audit library expands $ORIGIN with its own `ORIGIN`, if not NULL
+ */
+static entry_t* find_entry(object_stats_t* const object, const char* const dir, const char* const ORIGIN) {
+  if (NULL == object) {
+    return NULL;
+  }
+  for (size_t i = 0; i < object->num_entries; i++) {
+    entry_t* const entry = &object->entries[i];
+    if (NULL == ORIGIN) {
+      if (0 == strcmp(entry->dir, dir)) {
+        return entry;
+      }
+      continue;
+    }
+    char* const audit_dir = expand_entry(entry->text, strlen(entry->text), ORIGIN);
+    const int match = (0 == strcmp(audit_dir, dir));
+    free(audit_dir);
+    if (match) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static void add_name(entry_t* const entry, const char* const name) {
+  for (size_t i = 0; i < entry->num_names; i++) {
+    if (0 == strcmp(entry->names[i], name)) {
+      return;
+    }
+  }
+  if (entry->num_names < MAX_NAMES) {
+    entry->names[entry->num_names++] = copy_string(name);
+  }
+}
+
+/**
+ * Split a recorded line into its tab separated fields, in place
+ * @return the number of fields
+ */
+static size_t split_fields(char* const line, char** const fields, const size_t max_fields) {
+  size_t num_fields = 0;
+  char* cursor = line;
+  while (num_fields < max_fields) {
+    fields[num_fields++] = cursor;
+    char* const tab = strchr(cursor, '\t');
+    if (NULL == tab) {
+      break;
+    }
+    *tab = '\0';
+    cursor = tab + 1;
+  }
+  return num_fields;
+}
+
+/**
+ * Aggregate one recording into the statistics of its executable
+ * @return 0 on success
+ */
+static int analyze_recording(const char* const recording) {
+  FILE* const file = fopen(recording, "r");
+  if (NULL == file) {
+    ERROR("Cannot read %s\n", recording);
+    return 1;
+  }
+  size_t num_lines = 0;
+  char** lines = NULL;
+  char* line = NULL;
+  size_t len_line = 0;
+  ssize_t len;
+  while ((len = getline(&line, &len_line, file)) > 0) {
+    if (line[len - 1] == '\n') {
+      line[len - 1] = '\0';
+    }
+    lines = (char**)realloc(lines, (num_lines + 1) * sizeof(char*));
+    ASSERT(lines, "Out of memory\n");
+    lines[num_lines++] = copy_string(line);
+  }
+  free(line);
+  fclose(file);
+
+  exe_stats_t* exe = NULL;
+  char* header[4];
+  const char* audit_ORIGIN = NULL;
+  if ((num_lines > 0) && (0 == strncmp(lines[0], "exe\t", 4)) && (3 == split_fields(lines[0], header, 4))) {
+    audit_ORIGIN = header[1];
+    exe = find_exe(header[2]);
+    exe->runs++;
+  } else {
+    ERROR("%s is not a recording of la_objsearch\n", recording);
+  }
+
+  // The objects first: the audit library records its own search before the executable is announced.
+  // The audit library numbers the objects from 0, so an id is below the number of objects, or the recording is corrupt
+  size_t num_ids = 0;
+  for (size_t i = 1; i < num_lines; i++) {
+    num_ids += (0 == strncmp(lines[i], "object\t", 7));
+  }
+  object_stats_t** const by_id = (object_stats_t**)calloc((num_ids > 0) ? num_ids : 1, sizeof(object_stats_t*));
+  ASSERT(by_id, "Out of memory\n");
+  for (size_t i = 1; (NULL != exe) && (i < num_lines); i++) {
+    char* fields[8];
+    if ((0 != strncmp(lines[i], "object\t", 7)) || (6 != split_fields(lines[i], fields, 8))) {
+      continue;
+    }
+    char* end = NULL;
+    const unsigned long id = strtoul(fields[1], &end, 10);
+    if ((end == fields[1]) || (*end != '\0') || (id >= num_ids)) {
+      ERROR("%s: ignoring the object %s with the id %s\n", recording, fields[5], fields[1]);
+      continue;
+    }
+    by_id[id] = find_object(exe, fields[5], fields[2], fields[3], fields[4]);
+  }
+
+  // Search in progress through the entries of an object: its object, requester and name, and whether it was found there
+  object_stats_t* search_object = NULL;
+  size_t search_requester = 0;
+  const char* search_name = "";
+  for (size_t i = 1; (NULL != exe) && (i <= num_lines); i++) {
+    char* fields[8];
+    if (i == num_lines) {
+      if (NULL != search_object) {
+        search_object->pass_through++;
+      }
+      break;
+    }
+    if ((0 != strncmp(lines[i], "probe\t", 6)) || (7 != split_fields(lines[i], fields, 8))) {
+      continue;
+    }
+    const size_t requester = strtoul(fields[1], NULL, 10);
+    const char* const flag = fields[2];
+    const char* const outcome = fields[3];
+    const uint64_t ns = strtoull(fields[4], NULL, 10);
+    const char* const name = fields[5];
+    char* const path = fields[6];
+    const int hit = (0 == strcmp(outcome, "hit"));
+    const int miss = (0 == strcmp(outcome, "miss"));
+
+    entry_t* entry = NULL;
+    object_stats_t* object = NULL;
+    const int is_audit = (0 == strcmp(flag, "audit"));
+    if ((0 == strcmp(flag, "runpath")) || is_audit) {
+      char* const slash = strrchr(path, '/');
+      if (NULL != slash) {
+        *slash = '\0';
+        const char* const dir = (slash == path) ? "/" : path;
+        object = (requester < num_ids) ? by_id[requester] : NULL;
+        entry = find_entry(object, dir, is_audit ? audit_ORIGIN : NULL);
+        if ((NULL == entry) && !is_audit) {
+          object = (num_ids > 0) ? by_id[0] : NULL;
+          entry = find_entry(object, dir, NULL);
+        }
+      }
+    }
+    // A probe of another search, or past the entries, ends the search through the entries without a hit
+    if ((NULL != search_object) && ((search_object != object) || (search_requester != requester) || (0 != strcmp(search_name, name)))) {
+      search_object->pass_through++;
+      search_object = NULL;
+    }
+    if (NULL != entry) {
+      search_object = hit ? NULL : object;
+      search_requester = requester;
+      search_name = name;
+      if (hit) {
+        entry->hits++;
+        add_name(entry, name);
+        entry->has_libstdcxx |= (0 == strcmp(name, LIBSTDCXX_SONAME));
+      } else if (miss) {
+        entry->misses++;
+        entry->miss_ns += ns;
+      }
+      continue;
+    }
+    // Outside of DT_RUNPATH/DT_RPATH, or a DT_RPATH entry of a loader other than the executable
+    for (size_t f = 0; f < NUM_OTHER_FLAGS; f++) {
+      if ((0 == strcmp(flag, other_flags[f])) || (f == (NUM_OTHER_FLAGS - 1))) {
+        if (hit || miss) {
+          exe->other_probes[f]++;
+          exe->other_misses[f] += miss;
+          exe->other_miss_ns[f] += miss ? ns : 0;
+        }
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < num_lines; i++) {
+    free(lines[i]);
+  }
+  free(lines);
+  free(by_id);
+  return (NULL != exe) ? 0 : 1;
+}
+
+/**
+ * Whether `ahead`, moved in front of `behind`, would shadow a library that was found in `behind`
+ */
+static int shadows(const entry_t* const ahead, const entry_t* const behind) {
+  for (size_t i = 0; i < behind->num_names; i++) {
+    char path[PATH_MAX];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", ahead->dir, behind->names[i]);
+    if (0 == stat(path, &st)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Whether `a` should be searched before `b`: the shipped libstdc++ first, then by number of hits
+ */
+static int precedes(const entry_t* const a, const entry_t* const b) {
+  if (a->has_libstdcxx != b->has_libstdcxx) {
+    return a->has_libstdcxx;
+  }
+  return a->hits > b->hits;
+}
+
+/**
+ * Misses to find every recorded hit, if the entries were searched in `order`: each hit costs a miss per entry before it
+ */
+static unsigned long misses_in_order(const object_stats_t* const object, const size_t* const order, const size_t num_order) {
+  unsigned long misses = 0;
+  for (size_t position = 0; position < num_order; position++) {
+    misses += object->entries[order[position]].hits * position;
+  }
+  return misses;
+}
+
+static void report_object(FILE* const report, const object_stats_t* const object, const unsigned long runs) {
+  const char* const tag = object->is_runpath ? "DT_RUNPATH" : "DT_RPATH";
+  unsigned long probes = 0;
+  for (size_t i = 0; i < object->num_entries; i++) {
+    probes += object->entries[i].hits + object->entries[i].misses;
+  }
+  if (0 == probes) {
+    return;
+  }
+  fprintf(report, "  object %s %s=\"%s\"\n", object->path, tag, object->dt_path);
+
+  // Keep the entries that served a library, in a stable order that moves an entry ahead only if it shadows nothing
+  size_t order[MAX_ENTRIES];
+  size_t num_order = 0;
+  unsigned long current_misses = 0;
+  size_t libstdcxx_from = SIZE_MAX;
+  for (size_t i = 0; i < object->num_entries; i++) {
+    const entry_t* const entry = &object->entries[i];
+    current_misses += entry->misses;
+    if (entry->has_libstdcxx && (libstdcxx_from == SIZE_MAX)) {
+      libstdcxx_from = i;
+    }
+    fprintf(report, "    [%lu] %s hits=%lu misses=%lu miss_time=%.1fus %s%s\n", (unsigned long)i, entry->text, entry->hits, entry->misses,
+            (double)entry->miss_ns / 1000.0, (entry->hits > 0) ? "keep" : "prune", entry->has_libstdcxx ? " libstdc++" : "");
+    if (entry->hits == 0) {
+      continue;
+    }
+    size_t position = num_order++;
+    for (; position > 0; position--) {
+      const entry_t* const before = &object->entries[order[position - 1]];
+      if (!precedes(entry, before) || shadows(entry, before)) {
+        break;
+      }
+      order[position] = order[position - 1];
+    }
+    order[position] = i;
+  }
+
+  char recommended[PATH_MAX * 4] = "";
+  size_t len_recommended = 0;
+  size_t libstdcxx_to = SIZE_MAX;
+  for (size_t position = 0; position < num_order; position++) {
+    const entry_t* const entry = &object->entries[order[position]];
+    if (order[position] == libstdcxx_from) {
+      libstdcxx_to = position;
+    }
+    len_recommended += (size_t)snprintf(recommended + len_recommended, sizeof(recommended) - len_recommended, "%s%s", (position > 0) ? ":" : "", entry->text);
+    if (len_recommended >= sizeof(recommended)) {
+      len_recommended = sizeof(recommended) - 1;
+    }
+  }
+  // Searches that do not find their library in the entries still probe all of them
+  const unsigned long recommended_misses = misses_in_order(object, order, num_order) + (object->pass_through * num_order);
+  if ((0 == strcmp(recommended, object->dt_path)) || (current_misses <= recommended_misses)) {
+    fprintf(report, "    recommend no change, misses=%lu per %lu runs\n", current_misses, runs);
+    return;
+  }
+  fprintf(report, "    recommend %s=\"%s\" misses=%lu->%lu per %lu runs", tag, recommended, current_misses, recommended_misses, runs);
+  if ((libstdcxx_from != SIZE_MAX) && (libstdcxx_to != libstdcxx_from)) {
+    fprintf(report, " libstdc++ %lu->%lu", (unsigned long)libstdcxx_from, (unsigned long)libstdcxx_to);
+  }
+  fprintf(report, "\n");
+}
+
+static void report_exe(FILE* const report, const exe_stats_t* const exe) {
+  unsigned long probes = 0;
+  unsigned long misses = 0;
+  uint64_t miss_ns = 0;
+  for (size_t i = 0; i < exe->num_objects; i++) {
+    for (size_t e = 0; e < exe->objects[i]->num_entries; e++) {
+      const entry_t* const entry = &exe->objects[i]->entries[e];
+      probes += entry->hits + entry->misses;
+      misses += entry->misses;
+      miss_ns += entry->miss_ns;
+    }
+  }
+  for (size_t f = 0; f < NUM_OTHER_FLAGS; f++) {
+    probes += exe->other_probes[f];
+    misses += exe->other_misses[f];
+    miss_ns += exe->other_miss_ns[f];
+  }
+  fprintf(report, "%s runs=%lu probes=%lu misses=%lu miss_time=%.1fus\n", exe->exe, exe->runs, probes, misses, (double)miss_ns / 1000.0);
+  for (size_t i = 0; i < exe->num_objects; i++) {
+    report_object(report, exe->objects[i], exe->runs);
+  }
+  for (size_t f = 0; f < NUM_OTHER_FLAGS; f++) {
+    if (exe->other_probes[f] > 0) {
+      fprintf(report, "  other %s probes=%lu misses=%lu miss_time=%.1fus\n", other_flags[f], exe->other_probes[f], exe->other_misses[f], (double)exe->other_miss_ns[f] / 1000.0);
+    }
+  }
+}
+
+static int collect_recording(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+  (void)st;
+  (void)ftw;
+  const size_t len = strlen(path);
+  if ((type == FTW_F) && (len > 10) && (0 == strcmp(path + len - 10, ".objsearch"))) {
+    recordings = (char**)realloc(recordings, (num_recordings + 1) * sizeof(char*));
+    ASSERT(recordings, "Out of memory\n");
+    recordings[num_recordings++] = copy_string(path);
+  }
+  return 0;
+}
+
+static int compare_strings(const void* a, const void* b) {
+  return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+int main(int argc, char* argv[]) {
+  const char* report_path = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:")) != -1) {
+    switch (opt) {
+      case 'r':
+        report_path = optarg;
+        break;
+      default:
+        ASSERT(0, "Usage: %s [-r report] <recording or directory of recordings>...\n", argv[0]);
+    }
+  }
+  ASSERT(optind < argc, "Usage: %s [-r report] <recording or directory of recordings>...\n", argv[0]);
+
+  int num_errors = 0;
+  for (int i = optind; i < argc; i++) {
+    struct stat st;
+    if ((0 == stat(argv[i], &st)) && S_ISREG(st.st_mode)) {
+      collect_recording(argv[i], &st, FTW_F, NULL);
+    } else if (0 != nftw(argv[i], &collect_recording, 64, FTW_PHYS)) {
+      ERROR("Cannot walk %s\n", argv[i]);
+      num_errors++;
+    }
+  }
+  // Aggregate in a stable order, whatever the order of the directory entries
+  if (num_recordings > 0) {
+    qsort(recordings, num_recordings, sizeof(char*), &compare_strings);
+  }
+  for (size_t i = 0; i < num_recordings; i++) {
+    num_errors += analyze_recording(recordings[i]);
+  }
+
+  FILE* report = stdout;
+  if (report_path) {
+    report = fopen(report_path, "w");
+    ASSERT(report, "Cannot write %s\n", report_path);
+  }
+  for (size_t i = 0; i < num_exes; i++) {
+    report_exe(report, exes[i]);
+  }
+  if (report != stdout) {
+    ASSERT(fclose(report) == 0, "Cannot write %s\n", report_path);
+  }
+  fprintf(stderr, "Analyzed %lu recordings of %lu executables\n", (unsigned long)num_recordings, (unsigned long)num_exes);
+  return (num_errors > 0) ? 1 : 0;
+}
@@ -0,0 +1,265 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/ptrace.h>
+
+#include "macros.h"
+
+/**
+ *  Measures the wall clock startup cost and the peak resident size of an executable by running it repeatedly.
+ *
+ *  Usage: startup_benchmark [-n runs] [-l label] [-c file]... [-s] -- command [args...]
+ *    -n runs   Number of measured runs (default 50)
+ *    -l label  Label printed in front of the result line
+ *    -c file   Evict `file` from the page cache before every run (cold cache). May be repeated.
+ *              Pass the audit library and the libstdc++ candidates to measure a cold start.
+ *    -s        Instead of timing, run the command once under ptrace and count its system calls
+ *
+ *  The command's stdout is discarded. One result line is printed:
+ *    <label> runs=<n> min_us=<..> median_us=<..> mean_us=<..> median_rss_kb=<..>
+ *    <label> syscalls=<total> open=<..> stat=<..> mmap=<..> munmap=<..> read=<..> fadvise=<..>
+ */
+
+#define MAX_COLD_FILES 64
+
+static int compare_u64(const void* a, const void* b) {
+  const uint64_t x = *(const uint64_t*)a;
+  const uint64_t y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Drop the clean page cache pages of a file. Does not require privileges for files we can open
+ */
+static void evict_from_page_cache(const char* const path) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    ERROR("Cannot open %s to evict it from the page cache\n", path);
+    return;
+  }
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+static void exec_command(char* const* const argv) {
+  const int devnull = open("/dev/null", O_WRONLY);
+  if (devnull >= 0) {
+    dup2(devnull, STDOUT_FILENO);
+  }
+  execv(argv[0], argv);
+  _exit(127);
+}
+
+/**
+ * System call counters, grouped by what the audit library does with them
+ */
+typedef struct {
+  unsigned long total;
+  unsigned long open;
+  unsigned long stat;
+  unsigned long mmap;
+  unsigned long munmap;
+  unsigned long read;
+  unsigned long fadvise;
+} syscall_counts_t;
+
+static void count_syscall(syscall_counts_t* const counts, const unsigned long nr) {
+  counts->total++;
+  switch (nr) {
+#ifdef SYS_open
+    case SYS_open:
+#endif
+    case SYS_openat:
+      counts->open++;
+      break;
+#ifdef SYS_stat
+    case SYS_stat:
+#endif
+#ifdef SYS_fstat
+    case SYS_fstat:
+#endif
+#ifdef SYS_newfstatat
+    case SYS_newfstatat:
+#endif
+    case SYS_statx:
+      counts->stat++;
+      break;
+    case SYS_mmap:
+      counts->mmap++;
+      break;
+    case SYS_munmap:
+      counts->munmap++;
+      break;
+    case SYS_read:
+    case SYS_pread64:
+      counts->read++;
+      break;
+#ifdef SYS_fadvise64
+    case SYS_fadvise64:
+      counts->fadvise++;
+      break;
+#endif
+    default:
+      break;
+  }
+}
+
+/**
+ * Run the command once under ptrace and count every system call it enters
+ */
+static syscall_counts_t count_syscalls(char* const* const argv) {
+  syscall_counts_t counts = {0, 0, 0, 0, 0, 0, 0};
+  const pid_t pid = fork();
+  ASSERT(pid >= 0, "fork failed\n");
+  if (pid == 0) {
+    ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+    exec_command(argv);
+  }
+  int status = 0;
+  // The child stops with SIGTRAP once execv succeeded
+  ASSERT(waitpid(pid, &status, 0) == pid && WIFSTOPPED(status), "Failed to trace %s\n", argv[0]);
+  ptrace(PTRACE_SETOPTIONS, pid, NULL, (void*)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+
+  int signal = 0;
+  for (;;) {
+    ASSERT(ptrace(PTRACE_SYSCALL, pid, NULL, (void*)(intptr_t)signal) == 0, "PTRACE_SYSCALL failed\n");
+    ASSERT(waitpid(pid, &status, 0) == pid, "waitpid failed\n");
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+      break;
+    }
+    signal = 0;
+    if (WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+      // Forward real signals to the child
+      signal = WSTOPSIG(status);
+      continue;
+    }
+    struct ptrace_syscall_info info;
+    if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, (void*)sizeof(info), &info) > 0 && info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+      count_syscall(&counts, (unsigned long)info.entry.nr);
+    }
+  }
+  ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, "%s did not exit cleanly (status %d)\n", argv[0], status);
+  return counts;
+}
+
+/**
+ * fork/exec the command once and wait for it. Its peak resident size is stored into `max_rss_kb`
+ * @return elapsed wall time in nanoseconds
+ */
+static uint64_t run_once(char* const* const argv, uint64_t* const max_rss_kb) {
+  const uint64_t start = now_ns();
+  const pid_t pid = fork();
+  ASSERT(pid >= 0, "fork failed\n");
+  if (pid == 0) {
+    exec_command(argv);
+  }
+  int status = 0;
+  struct rusage usage;
+  ASSERT(wait4(pid, &status, 0, &usage) == pid, "wait4 failed\n");
+  const uint64_t elapsed = now_ns() - start;
+  *max_rss_kb = (uint64_t)usage.ru_maxrss;
+  ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, "%s did not exit cleanly (status %d)\n", argv[0], status);
+  return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+  long runs = 50;
+  const char* label = "startup";
+  const char* cold_files[MAX_COLD_FILES];
+  size_t num_cold_files = 0;
+  int syscalls = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "+n:l:c:s")) != -1) {
+    switch (opt) {
+      case 'n':
+        runs = strtol(optarg, NULL, 10);
+        break;
+      case 'l':
+        label = optarg;
+        break;
+      case 'c':
+        ASSERT(num_cold_files < MAX_COLD_FILES, "Too many -c files\n");
+        cold_files[num_cold_files++] = optarg;
+        break;
+      case 's':
+        syscalls = 1;
+        break;
+      default:
+        ASSERT(0, "Usage: %s [-n runs] [-l label] [-c file]... [-s] -- command [args...]\n", argv[0]);
+    }
+  }
+  ASSERT(optind < argc, "Missing command. Usage: %s [-n runs] [-l label] [-c file]... [-s] -- command [args...]\n", argv[0]);
+  ASSERT(runs > 0, "Number of runs must be positive\n");
+
+  char* const* const command = &argv[optind];
+
+  if (syscalls) {
+    const syscall_counts_t counts = count_syscalls(command);
+    printf("%-28s syscalls=%lu open=%lu stat=%lu mmap=%lu munmap=%lu read=%lu fadvise=%lu\n", label, counts.total, counts.open, counts.stat,
+           counts.mmap, counts.munmap, counts.read, counts.fadvise);
+    return 0;
+  }
+
+  // One warm-up run so the first measured run is not penalized by unrelated cold files
+  uint64_t* rss_samples = calloc((size_t)runs, sizeof(uint64_t));
+  ASSERT(rss_samples, "Out of memory\n");
+  run_once(command, &rss_samples[0]);
+
+  uint64_t* samples = calloc((size_t)runs, sizeof(uint64_t));
+  ASSERT(samples, "Out of memory\n");
+  uint64_t total = 0;
+  for (long i = 0; i < runs; i++) {
+    for (size_t f = 0; f < num_cold_files; f++) {
+      evict_from_page_cache(cold_files[f]);
+    }
+    samples[i] = run_once(command, &rss_samples[i]);
+    total += samples[i];
+  }
+  qsort(samples, (size_t)runs, sizeof(uint64_t), compare_u64);
+  qsort(rss_samples, (size_t)runs, sizeof(uint64_t), compare_u64);
+
+  printf("%-28s runs=%ld min_us=%lu median_us=%lu mean_us=%lu median_rss_kb=%lu\n", label, runs, (unsigned long)(samples[0] / 1000),
+         (unsigned long)(samples[runs / 2] / 1000), (unsigned long)(total / (uint64_t)runs / 1000), (unsigned long)rss_samples[runs / 2]);
+  free(samples);
+  free(rss_samples);
+  return 0;
+}
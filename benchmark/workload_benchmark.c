@@ -0,0 +1,223 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "get_libstdcxx_version.h"
+#include "macros.h"
+
+/**
+ *  Compares the hot paths of libstdc++ candidates, by running workload_payload under each of them.
+ *
+ *  Usage: workload_benchmark [-n runs] [-s scale] <workload_payload> [libstdc++]...
+ *    -n runs   Number of runs per candidate (default 5). The median of each workload is reported
+ *    -s scale  Number of operations of each workload, in percent of the default (default 100)
+ *
+ *  The payload uses the audit library. It first runs with the policy of the audit library, then once per candidate with
+ *  AUDIT_LIBSTDCXX_FORCE=<candidate>. Prints one row per run set, with the nanoseconds per operation of each workload:
+ *    <libstdc++ loaded> <GLIBCXX version> <workload>... (ns/op)
+ *  A candidate that cannot run the payload (too old for it) or that the audit library did not load is reported as such.
+ */
+
+#define MAX_WORKLOADS 16
+#define MAX_LEN_WORKLOAD_NAME 32
+
+typedef struct {
+  char name[MAX_LEN_WORKLOAD_NAME];
+  double* samples;
+} workload_t;
+
+typedef struct {
+  char libstdcxx[PATH_MAX];
+  size_t num_workloads;
+  workload_t workloads[MAX_WORKLOADS];
+} results_t;
+
+static int compare_double(const void* a, const void* b) {
+  const double x = *(const double*)a;
+  const double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Run the payload once, with AUDIT_LIBSTDCXX_FORCE=`forced` unless NULL, and add its numbers to `results` as run `run`
+ * @return error_code_t ec_non_fatal_error if the payload failed
+ */
+static error_code_t run_payload(char* const* const argv, const char* const forced, results_t* const results, const long run, const long runs) {
+  int pipe_fds[2];
+  ASSERT(pipe(pipe_fds) == 0, "pipe failed\n");
+  const pid_t pid = fork();
+  ASSERT(pid >= 0, "fork failed\n");
+  if (pid == 0) {
+    dup2(pipe_fds[1], STDOUT_FILENO);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    const int devnull = open("/dev/null", O_WRONLY);
+    if (devnull >= 0) {
+      dup2(devnull, STDERR_FILENO);
+    }
+    if (forced) {
+      setenv("AUDIT_LIBSTDCXX_FORCE", forced, 1);
+    } else {
+      unsetenv("AUDIT_LIBSTDCXX_FORCE");
+    }
+    execv(argv[0], argv);
+    _exit(127);
+  }
+  close(pipe_fds[1]);
+  FILE* const output = fdopen(pipe_fds[0], "r");
+  ASSERT(output, "fdopen failed\n");
+  char line[PATH_MAX + 64];
+  while (fgets(line, sizeof(line), output)) {
+    line[strcspn(line, "\n")] = '\0';
+    char* const value = strchr(line, ' ');
+    if (NULL == value) {
+      continue;
+    }
+    *value = '\0';
+    if (0 == strcmp(line, "libstdcxx")) {
+      snprintf(results->libstdcxx, sizeof(results->libstdcxx), "%s", value + 1);
+      continue;
+    }
+    if (0 == strcmp(line, "checksum")) {
+      continue;
+    }
+    size_t i = 0;
+    while ((i < results->num_workloads) && (0 != strcmp(results->workloads[i].name, line))) {
+      i++;
+    }
+    if (i == results->num_workloads) {
+      if ((i == MAX_WORKLOADS) || (strlen(line) >= MAX_LEN_WORKLOAD_NAME)) {
+        continue;
+      }
+      memcpy(results->workloads[i].name, line, strlen(line) + 1);
+      results->workloads[i].samples = calloc((size_t)runs, sizeof(double));
+      ASSERT(results->workloads[i].samples, "Out of memory\n");
+      results->num_workloads++;
+    }
+    results->workloads[i].samples[run] = strtod(value + 1, NULL);
+  }
+  fclose(output);
+  int status = 0;
+  ASSERT(waitpid(pid, &status, 0) == pid, "waitpid failed\n");
+  return (WIFEXITED(status) && (WEXITSTATUS(status) == 0)) ? ec_success : ec_non_fatal_error;
+}
+
+static void print_version(const char* const path) {
+  uint32_t version = 0;
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if ((fd < 0) || (ec_success != get_libstdcxx_version(fd, path, &version))) {
+    printf(" %-10s", "?");
+    return;
+  }
+  char text[16];
+  snprintf(text, sizeof(text), "%u.%u.%u", version >> 16, (version >> 8) & 0xFF, version & 0xFF);
+  printf(" %-10s", text);
+}
+
+static void free_results(results_t* const results) {
+  for (size_t i = 0; i < results->num_workloads; i++) {
+    free(results->workloads[i].samples);
+  }
+  free(results);
+}
+
+/**
+ * Run the payload `runs` times and print the row of the table. The header is printed with the first row, from the workloads the payload reported
+ */
+static void benchmark_candidate(char* const* const argv, const char* const label, const char* const forced, const long runs) {
+  static int header_printed = 0;
+  results_t* const results = calloc(1, sizeof(results_t));
+  ASSERT(results, "Out of memory\n");
+  memcpy(results->libstdcxx, "?", 2);
+  error_code_t error = ec_success;
+  // The first run warms the page cache up and is overwritten
+  for (long run = -1; (run < runs) && (ec_success == error); run++) {
+    error = run_payload(argv, forced, results, (run < 0) ? 0 : run, runs);
+  }
+  if (!header_printed && (ec_success == error)) {
+    printf("%-8s %-60s %-10s", "run", "libstdc++", "GLIBCXX");
+    for (size_t i = 0; i < results->num_workloads; i++) {
+      printf(" %12s", results->workloads[i].name);
+    }
+    printf("   (ns/op, median of %ld runs)\n", runs);
+    header_printed = 1;
+  }
+
+  printf("%-8s ", label);
+  if (ec_success != error) {
+    printf("%-60s cannot run %s (libstdc++ too old for it?)\n", forced ? forced : "?", argv[0]);
+    free_results(results);
+    return;
+  }
+  printf("%-60s", results->libstdcxx);
+  print_version(results->libstdcxx);
+  // The audit library ignores a forced path it cannot use
+  char forced_real_path[PATH_MAX];
+  if (forced && ((NULL == realpath(forced, forced_real_path)) || (0 != strcmp(forced_real_path, results->libstdcxx)))) {
+    printf(" instead of %s\n", forced);
+    free_results(results);
+    return;
+  }
+  for (size_t i = 0; i < results->num_workloads; i++) {
+    qsort(results->workloads[i].samples, (size_t)runs, sizeof(double), compare_double);
+    printf(" %12.1f", results->workloads[i].samples[runs / 2]);
+  }
+  printf("\n");
+  free_results(results);
+}
+
+int main(int argc, char* argv[]) {
+  long runs = 5;
+  const char* scale = "100";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "+n:s:")) != -1) {
+    switch (opt) {
+      case 'n':
+        runs = strtol(optarg, NULL, 10);
+        break;
+      case 's':
+        scale = optarg;
+        break;
+      default:
+        ASSERT(0, "Usage: %s [-n runs] [-s scale] <workload_payload> [libstdc++]...\n", argv[0]);
+    }
+  }
+  ASSERT(optind < argc, "Missing payload. Usage: %s [-n runs] [-s scale] <workload_payload> [libstdc++]...\n", argv[0]);
+  ASSERT(runs > 0, "Number of runs must be positive\n");
+  char* const payload[] = {argv[optind], (char*)scale, NULL};
+
+  benchmark_candidate(payload, "policy", NULL, runs);
+  for (int i = optind + 1; i < argc; i++) {
+    benchmark_candidate(payload, "forced", argv[i], runs);
+  }
+  return 0;
+}
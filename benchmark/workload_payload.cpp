@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <link.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "workload_thrower.h"
+
+/**
+ *  Hot paths of libstdc++, measured in the libstdc++ the audit library chose (or was forced to with AUDIT_LIBSTDCXX_FORCE).
+ *  Like the example executable, it lists the libstdc++ it loaded. Prints one line per workload, for workload_benchmark:
+ *    libstdcxx <path of the loaded libstdc++>
+ *    <workload> <nanoseconds per operation>
+ *    checksum <value>
+ */
+
+static uint64_t checksum = 0;
+
+// ld.so names an object after the candidate it searched, also when the audit library redirected it to another file.
+// The file really mapped at the base address of libstdc++ is in /proc/self/maps
+static int find_libstdcxx(dl_phdr_info *info, size_t unused, void *p_path) {
+  (void)unused;
+  if (std::string(info->dlpi_name).find("libstdc++.so") == std::string::npos) {
+    return 0;
+  }
+  std::ifstream maps("/proc/self/maps");
+  for (std::string line; std::getline(maps, line);) {
+    if ((std::strtoul(line.c_str(), nullptr, 16) == info->dlpi_addr) && (line.find('/') != std::string::npos)) {
+      *reinterpret_cast<std::string *>(p_path) = line.substr(line.find('/'));
+      return 1;
+    }
+  }
+  *reinterpret_cast<std::string *>(p_path) = info->dlpi_name;
+  return 1;
+}
+
+template <typename Workload>
+static void measure(const char *const name, const long operations, Workload workload) {
+  const auto start = std::chrono::steady_clock::now();
+  workload(operations);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << name << " " << (std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(operations)) << "\n";
+}
+
+// Thrown in the shared library workload_thrower, caught here
+static void exceptions(const long operations) {
+  for (long i = 0; i < operations; i++) {
+    try {
+      workload_throw(static_cast<int>(i));
+    } catch (const std::runtime_error &error) {
+      checksum += error.what()[9];
+    }
+  }
+}
+
+// Keys built, hashed, inserted and erased, so the table keeps rehashing and the strings keep allocating
+static void string_map(const long operations) {
+  std::unordered_map<std::string, long> map;
+  for (long i = 0; i < operations; i++) {
+    std::string key = "key/" + std::to_string(i % 4096) + "/" + std::to_string(i % 7);
+    map[key] += i;
+    if ((i % 3) == 0) {
+      map.erase(key.substr(0, key.size() - 1) + std::to_string((i + 1) % 7));
+    }
+  }
+  checksum += map.size();
+}
+
+// Formatted output then input of mixed lines, through std::stringstream and a std::ofstream
+static void iostream(const long operations) {
+  std::ofstream devnull("/dev/null");
+  std::stringstream stream;
+  for (long i = 0; i < operations; i++) {
+    stream << i << ' ' << (static_cast<double>(i) / 7.0) << " item" << (i % 10) << '\n';
+    devnull << i << ' ' << (static_cast<double>(i) / 3.0) << '\n';
+  }
+  long integer = 0;
+  double real = 0;
+  std::string word;
+  while (stream >> integer >> real >> word) {
+    checksum += static_cast<uint64_t>(integer) + word.size();
+  }
+}
+
+// Short lived nodes of several sizes: map nodes, list nodes, vectors that grow, shared_ptr control blocks
+static void allocation(const long operations) {
+  std::map<long, std::vector<long>> map;
+  std::list<std::shared_ptr<std::string>> list;
+  for (long i = 0; i < operations; i++) {
+    map[i % 1024].push_back(i);
+    list.push_back(std::make_shared<std::string>(static_cast<size_t>(16 + (i % 64)), 'x'));
+    if (list.size() > 256) {
+      list.pop_front();
+    }
+    if ((i % 1024) == 1023) {
+      map.clear();
+    }
+  }
+  checksum += map.size() + list.size();
+}
+
+int main(int argc, char **argv) {
+  // The number of operations scales with an optional first argument, in percent
+  const long scale = (argc > 1) ? std::max(1L, std::strtol(argv[1], nullptr, 10)) : 100L;
+  std::string libstdcxx = "unknown";
+  dl_iterate_phdr(find_libstdcxx, &libstdcxx);
+  std::cout << "libstdcxx " << libstdcxx << "\n";
+  measure("exceptions", 200 * scale, exceptions);
+  measure("string_map", 2000 * scale, string_map);
+  measure("iostream", 1000 * scale, iostream);
+  measure("allocation", 2000 * scale, allocation);
+  std::cout << "checksum " << checksum << std::endl;
+  return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef _WORKLOAD_THROWER_H_
+#define _WORKLOAD_THROWER_H_
+
+/**
+ * Throws a std::runtime_error from the shared library workload_thrower
+ */
+void workload_throw(const int value);
+
+#endif
@@ -3,6 +3,7 @@ cmake_minimum_required(VERSION 3.21)
 include("${CMAKE_CURRENT_LIST_DIR}/find_highest_libstdcxx.cmake")
 include("${CMAKE_CURRENT_LIST_DIR}/find_compiler_libstdcxx.cmake")
 include("${CMAKE_CURRENT_LIST_DIR}/custom_transitive_build_rpath.cmake")
+include("${CMAKE_CURRENT_LIST_DIR}/libstdcxx_note.cmake")
 
 option(AuditLibstdcxx_LIBSTDCXX_SO_PATHS
   "List of paths to search for libstdc++.so.6 candidate libraries" "")
@@ -13,6 +14,9 @@ option(AuditLibstdcxx_AUTO_LINK_LIBSTDCXX_SO
 option(AuditLibstdcxx_AUTO_LINK_LIBSTDCXX_EXE
   "Use of `link_libraries` to pseudo-global link `libstdcxx_exe` target with CXX,GNU executable targets" ON)
 
+option(AuditLibstdcxx_LIBSTDCXX_NOTE
+  "Stamp a .note.audit_libstdcxx describing the shipped libstdc++.so.6 into executables that link `link_audit_libstdcxx`" ON)
+
 # Executable target that links with libstdc++ and applies the audit library
 add_library(libstdcxx_exe INTERFACE)
 add_library(AuditLibstdcxx::libstdcxx_exe ALIAS libstdcxx_exe)
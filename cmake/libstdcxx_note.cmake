@@ -0,0 +1,45 @@
+# Function: libstdcxx_note
+# ------------------------
+# Stamps a `.note.audit_libstdcxx` ELF note describing the shipped `libstdc++.so.6` into every executable that links
+# with an interface target (normally `AuditLibstdcxx::link_audit_libstdcxx`).
+#
+# Parameters:
+#   TARGET (IN)         - The interface target whose CXX,GNU users receive the note.
+#   LIBSTDCXX_PATH (IN) - Path to the shipped `libstdc++.so.6`.
+#
+# Behavior:
+#   - Uses the helper target `AuditLibstdcxx::get_libstdcxx_version` to generate a source that defines the note, with the
+#     GLIBCXX version, size and build-id of `LIBSTDCXX_PATH`.
+#   - Compiles it in an object library and links its object into the users of `TARGET`. Like the `--audit` flag, it
+#     propagates through link libraries, so it also reaches executables linked by `AuditLibstdcxx_AUTO_LINK_LIBSTDCXX_EXE`.
+#   - The note names the soname. At startup, the audit library looks it up in DT_RUNPATH/DT_RPATH with `stat`, and reads
+#     the build-id from its first page, instead of parsing the shipped libstdc++. So the same note is valid in the build
+#     and the install tree.
+#
+# Notes:
+#   - If the libstdc++ found is missing or does not have the recorded size or build-id, the note is stale and the audit
+#     library falls back to parsing the libstdc++ it finds.
+#
+# Example Usage:
+#   libstdcxx_note(AuditLibstdcxx::link_audit_libstdcxx "${LIBSTDCXXSO_PATH}")
+include_guard(GLOBAL)
+
+function(libstdcxx_note TARGET LIBSTDCXX_PATH)
+  get_target_property(get_libstdcxx_version_path AuditLibstdcxx::get_libstdcxx_version LOCATION)
+
+  string(MAKE_C_IDENTIFIER "${TARGET}_libstdcxx_note" NOTE_NAME)
+  set(NOTE_SOURCE "${CMAKE_CURRENT_BINARY_DIR}/${NOTE_NAME}.cpp")
+  execute_process(
+    COMMAND ${get_libstdcxx_version_path} -n ${NOTE_SOURCE} ${LIBSTDCXX_PATH}
+    RESULT_VARIABLE RESULT
+  )
+  if (NOT RESULT EQUAL 0)
+    message(WARNING "libstdcxx_note: Could not describe ${LIBSTDCXX_PATH}. Executables will not carry a .note.audit_libstdcxx")
+    return()
+  endif()
+
+  if (NOT TARGET ${NOTE_NAME})
+    add_library(${NOTE_NAME} OBJECT ${NOTE_SOURCE})
+  endif()
+  set_property(TARGET ${TARGET} APPEND PROPERTY INTERFACE_LINK_LIBRARIES "$<$<LINK_LANG_AND_ID:CXX,GNU>:$<TARGET_OBJECTS:${NOTE_NAME}>>")
+endfunction()
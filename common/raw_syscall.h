@@ -0,0 +1,53 @@
+#ifndef _RAW_SYSCALL_H_
+#define _RAW_SYSCALL_H_
+
+/**
+ *  System calls without libc: the result is returned as is, -errno on failure, and errno is never written.
+ *  They are safe where the thread pointer is not the caller's own, such as in a thread created with a bare clone,
+ *  and they are the system calls of audit_libstdcxx_freestanding.
+ *  RAW_SYSCALL_AVAILABLE is 0 on the architectures without an implementation
+ */
+
+#ifndef STATIC_INLINE
+#ifndef GOOGLE_TEST
+#define STATIC_INLINE static inline
+#else
+#define STATIC_INLINE
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define RAW_SYSCALL_AVAILABLE 1
+#else
+#define RAW_SYSCALL_AVAILABLE 0
+#endif
+
+// The definitions are C. test.cpp includes the header for the types only
+#if RAW_SYSCALL_AVAILABLE && !defined(__cplusplus)
+
+STATIC_INLINE long raw_syscall6(long nr, long a, long b, long c, long d, long e, long f) {
+#if defined(__x86_64__)
+  register long r10 __asm__("r10") = d;
+  register long r8 __asm__("r8") = e;
+  register long r9 __asm__("r9") = f;
+  long result;
+  __asm__ volatile("syscall" : "=a"(result) : "a"(nr), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8), "r"(r9) : "rcx", "r11", "memory");
+  return result;
+#elif defined(__aarch64__)
+  register long x8 __asm__("x8") = nr;
+  register long x0 __asm__("x0") = a;
+  register long x1 __asm__("x1") = b;
+  register long x2 __asm__("x2") = c;
+  register long x3 __asm__("x3") = d;
+  register long x4 __asm__("x4") = e;
+  register long x5 __asm__("x5") = f;
+  __asm__ volatile("svc 0" : "+r"(x0) : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5) : "memory");
+  return x0;
+#endif
+}
+
+#define raw_syscall(nr, a, b, c, d, e, f) raw_syscall6((nr), (long)(a), (long)(b), (long)(c), (long)(d), (long)(e), (long)(f))
+
+#endif
+
+#endif
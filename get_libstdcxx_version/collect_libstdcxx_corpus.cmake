@@ -0,0 +1,65 @@
+# Script: collect_libstdcxx_corpus
+# --------------------------------
+# Copies the libstdc++ of each container image of a list into a corpus directory, for generate_libstdcxx_fingerprints.cmake.
+# Run it with `cmake -P` or through the `collect_libstdcxx_corpus` target.
+#
+# Parameters (-D):
+#   IMAGES (IN)   - Path to the list of images, libstdcxx_fingerprint_images.txt.
+#   CORPUS (OUT)  - Directory of the corpus. The libstdc++ of image <name>:<tag> is written to <name>_<tag>/libstdc++.so.6.
+#   ENGINE (IN)   - Optional. Container engine, docker or podman. The first one found by default.
+#
+# Behavior:
+#   - Pulls and runs each image, and copies the first libstdc++.so.6 found in it, following symbolic links.
+#   - An image that cannot be run, or holds no libstdc++, is reported and skipped. Files already collected are kept.
+#
+# Example Usage:
+#   cmake -DIMAGES=get_libstdcxx_version/libstdcxx_fingerprint_images.txt -DCORPUS=build/corpus
+#         -P get_libstdcxx_version/collect_libstdcxx_corpus.cmake
+cmake_minimum_required(VERSION 3.21)
+
+foreach(parameter IMAGES CORPUS)
+  if (NOT ${parameter})
+    message(FATAL_ERROR "collect_libstdcxx_corpus: ${parameter} is not set")
+  endif()
+endforeach()
+if (NOT ENGINE)
+  find_program(ENGINE NAMES docker podman)
+  if (NOT ENGINE)
+    message(FATAL_ERROR "collect_libstdcxx_corpus: Neither docker nor podman was found, set ENGINE")
+  endif()
+endif()
+
+# Release builds of GCC first, as the GCC images are based on a distribution that has its own libstdc++
+set(FIND_LIBSTDCXX
+  "for f in /usr/local/lib64/libstdc++.so.6 /usr/lib64/libstdc++.so.6 /usr/lib/*-linux-gnu/libstdc++.so.6 /usr/lib/libstdc++.so.6; do [ -e \"$f\" ] && exec cat \"$f\"; done; exit 1"
+)
+
+file(STRINGS "${IMAGES}" lines)
+set(collected 0)
+foreach(line IN LISTS lines)
+  string(REGEX REPLACE "#.*" "" image "${line}")
+  string(STRIP "${image}" image)
+  if (image STREQUAL "")
+    continue()
+  endif()
+  string(REGEX REPLACE "[/:]" "_" directory "${image}")
+  set(library "${CORPUS}/${directory}/libstdc++.so.6")
+  if (EXISTS "${library}")
+    math(EXPR collected "${collected} + 1")
+    continue()
+  endif()
+  file(MAKE_DIRECTORY "${CORPUS}/${directory}")
+  execute_process(
+    COMMAND ${ENGINE} run --rm --entrypoint sh ${image} -c "${FIND_LIBSTDCXX}"
+    OUTPUT_FILE "${library}.part"
+    RESULT_VARIABLE result
+  )
+  if (result EQUAL 0)
+    file(RENAME "${library}.part" "${library}")
+    math(EXPR collected "${collected} + 1")
+  else()
+    file(REMOVE "${library}.part")
+    message(WARNING "collect_libstdcxx_corpus: No libstdc++ collected from ${image}")
+  endif()
+endforeach()
+message(STATUS "collect_libstdcxx_corpus: ${collected} libstdc++ in ${CORPUS}")
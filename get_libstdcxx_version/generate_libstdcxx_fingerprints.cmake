@@ -0,0 +1,86 @@
+# Script: generate_libstdcxx_fingerprints
+# ---------------------------------------
+# Refreshes libstdcxx_fingerprints.inc, the table of known libstdc++ builds that get_libstdcxx_version identifies by
+# build-id, from a corpus of libstdc++. Run it with `cmake -P` or through the `update_libstdcxx_fingerprints` target.
+#
+# Parameters (-D):
+#   TOOL (IN)     - Path to the get_libstdcxx_version executable.
+#   TABLE (IN)    - Path to libstdcxx_fingerprints.inc. Its rows are kept.
+#   CORPUS (IN)   - List of libstdc++ files and directories. Directories are searched recursively for `libstdc++.so*`.
+#
+# Behavior:
+#   - Runs `get_libstdcxx_version -f` on the corpus. The version of each row comes from parsing .gnu.version_d, never
+#     from the table. Files without a build-id or of another architecture are skipped.
+#   - Merges the rows with those of TABLE, drops duplicates and sorts them, as the audit library binary searches the table.
+#
+# Example Usage:
+#   cmake -DTOOL=build/get_libstdcxx_version/get_libstdcxx_version -DTABLE=get_libstdcxx_version/libstdcxx_fingerprints.inc
+#         "-DCORPUS=/usr/lib;/opt/conda/pkgs" -P get_libstdcxx_version/generate_libstdcxx_fingerprints.cmake
+cmake_minimum_required(VERSION 3.21)
+
+foreach(parameter TOOL TABLE CORPUS)
+  if (NOT ${parameter})
+    message(FATAL_ERROR "generate_libstdcxx_fingerprints: ${parameter} is not set")
+  endif()
+endforeach()
+
+set(LIBRARIES)
+foreach(entry IN LISTS CORPUS)
+  if (IS_DIRECTORY "${entry}")
+    file(GLOB_RECURSE found LIST_DIRECTORIES false "${entry}/libstdc++.so*")
+    list(APPEND LIBRARIES ${found})
+  elseif (EXISTS "${entry}")
+    list(APPEND LIBRARIES "${entry}")
+  endif()
+endforeach()
+# Symbolic links name the same files
+set(REAL_LIBRARIES)
+foreach(library IN LISTS LIBRARIES)
+  if (NOT library MATCHES "\\.py$")
+    file(REAL_PATH "${library}" real_library)
+    list(APPEND REAL_LIBRARIES "${real_library}")
+  endif()
+endforeach()
+list(REMOVE_DUPLICATES REAL_LIBRARIES)
+
+set(ROWS)
+if (EXISTS "${TABLE}")
+  file(STRINGS "${TABLE}" ROWS REGEX "^  {{")
+endif()
+list(LENGTH ROWS count_before)
+
+if (REAL_LIBRARIES)
+  execute_process(
+    COMMAND ${TOOL} -f ${REAL_LIBRARIES}
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE result
+  )
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "generate_libstdcxx_fingerprints: ${TOOL} failed")
+  endif()
+  string(REPLACE "\n" ";" new_rows "${output}")
+  list(FILTER new_rows INCLUDE REGEX "^  {{")
+  list(APPEND ROWS ${new_rows})
+endif()
+list(REMOVE_DUPLICATES ROWS)
+list(SORT ROWS)
+list(LENGTH ROWS count_after)
+
+# Two builds cannot share a build-id, a row with another version for the same build-id is a corrupt corpus
+set(previous_key "")
+foreach(row IN LISTS ROWS)
+  string(REGEX REPLACE ", 0x[0-9a-f]+},$" "" key "${row}")
+  if (key STREQUAL previous_key)
+    message(FATAL_ERROR "generate_libstdcxx_fingerprints: Conflicting versions for the build-id of\n${row}")
+  endif()
+  set(previous_key "${key}")
+endforeach()
+
+string(REPLACE ";" "\n" body "${ROWS}")
+file(WRITE "${TABLE}"
+  "// Generated by generate_libstdcxx_fingerprints.cmake. Do not edit, run the update_libstdcxx_fingerprints target\n"
+  "// {build-id zero padded, length of the build-id, max GLIBCXX version}, sorted\n"
+  "${body}\n"
+)
+math(EXPR count_added "${count_after} - ${count_before}")
+message(STATUS "generate_libstdcxx_fingerprints: ${count_after} fingerprints, ${count_added} new, from ${CORPUS}")
@@ -3,24 +3,156 @@
 
 #include <stdint.h>
 
+#include "libstdcxx_note.h"
 #include "macros.h"
 
 /**
  *  This simple utility opens the provided libstdc++.so in the first argument and
  *  prints the 32bit hex representation of the version
+ *
+ *  With `-n <note source> [-p <path>]`, it instead writes a C/C++ source that defines the .note.audit_libstdcxx note
+ *  describing the libstdc++ (version, size, build-id). <path> is the path to the libstdc++ stored in the note. The soname
+ *  (the default) is looked up in the DT_RUNPATH/DT_RPATH of the executable, a relative path is relative to the directory
+ *  of the executable and an absolute one is used as is. Other bare names are rejected. The AUDIT_LIBSTDCXX_NOTE_PATH
+ *  definition overrides it when the source is compiled
+ *
+ *  With `-f <libstdc++.so.6>...`, it instead prints a row of libstdcxx_fingerprints.inc for each libstdc++ that has a build-id.
+ *  generate_libstdcxx_fingerprints.cmake merges them into the table
  */
 
+static void write_note_source(FILE* const out, const char* const libstdcxx, const char* const path, const uint32_t version,
+                              const uint64_t file_size, const uint8_t* const build_id, const uint32_t len_build_id) {
+  fprintf(out, "/* Generated by get_libstdcxx_version from %s. Do not edit */\n", libstdcxx);
+  fprintf(out, "#include <stdint.h>\n\n");
+  fprintf(out, "#ifndef AUDIT_LIBSTDCXX_NOTE_PATH\n#define AUDIT_LIBSTDCXX_NOTE_PATH \"%s\"\n#endif\n\n", path);
+  fprintf(out, "struct audit_libstdcxx_note {\n");
+  fprintf(out, "  uint32_t namesz;\n  uint32_t descsz;\n  uint32_t type;\n");
+  fprintf(out, "  char name[%lu];\n", (unsigned long)elf_note_align(sizeof(LIBSTDCXX_NOTE_NAME)));
+  fprintf(out, "  uint32_t glibcxx_version;\n  uint32_t file_size_low;\n  uint32_t file_size_high;\n  uint32_t len_build_id;\n");
+  fprintf(out, "  uint8_t build_id[%d];\n", LIBSTDCXX_NOTE_MAX_BUILD_ID);
+  fprintf(out, "  char path[(sizeof(AUDIT_LIBSTDCXX_NOTE_PATH) + 3) & ~3];\n");
+  fprintf(out, "};\n\n");
+  fprintf(out, "__attribute__((section(\"%s\"), aligned(4), used))\n", LIBSTDCXX_NOTE_SECTION);
+  fprintf(out, "static const struct audit_libstdcxx_note audit_libstdcxx_note = {\n");
+  fprintf(out, "  %lu,\n", (unsigned long)sizeof(LIBSTDCXX_NOTE_NAME));
+  fprintf(out, "  %lu + ((sizeof(AUDIT_LIBSTDCXX_NOTE_PATH) + 3) & ~3),\n", (unsigned long)sizeof(libstdcxx_note_desc_t));
+  fprintf(out, "  %d,\n", LIBSTDCXX_NOTE_TYPE);
+  fprintf(out, "  \"%s\",\n", LIBSTDCXX_NOTE_NAME);
+  fprintf(out, "  0x%08x,\n", version);
+  fprintf(out, "  0x%08x,\n", (uint32_t)(file_size & 0xFFFFFFFFu));
+  fprintf(out, "  0x%08x,\n", (uint32_t)(file_size >> 32));
+  fprintf(out, "  %u,\n", len_build_id);
+  fprintf(out, "  {");
+  for (uint32_t i = 0; i < len_build_id; i++) {
+    fprintf(out, "%s0x%02x", (i == 0) ? "" : ", ", build_id[i]);
+  }
+  fprintf(out, "},\n");
+  fprintf(out, "  AUDIT_LIBSTDCXX_NOTE_PATH,\n");
+  fprintf(out, "};\n");
+}
+
+/**
+ * Print the row of libstdcxx_fingerprints.inc describing `libstdcxx`, from its build-id and its parsed .gnu.version_d
+ * Build-ids are zero padded and the length has a fixed width, so sorting the rows as text sorts the table
+ * @return error_code_t ec_non_fatal_error if `libstdcxx` cannot be fingerprinted
+ */
+static error_code_t print_fingerprint(const char* const libstdcxx) {
+  const int fd_libstdcxx = open(libstdcxx, O_RDONLY);
+  if (fd_libstdcxx < 0) {
+    ERROR("Cannot open %s\n", libstdcxx);
+    return ec_non_fatal_error;
+  }
+  struct stat st;
+  ASSERT(fstat(fd_libstdcxx, &st) == 0, "Cannot stat %s\n", libstdcxx);
+  const char* const mapped = (const char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd_libstdcxx, 0);
+  ASSERT(mapped != MAP_FAILED, "Cannot map %s\n", libstdcxx);
+  uint8_t build_id[LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID] = {0};
+  uint32_t len_build_id = 0;
+  const error_code_t error_build_id = get_elf_build_id(mapped, (size_t)st.st_size, build_id, sizeof(build_id), &len_build_id);
+  munmap((void*)mapped, (size_t)st.st_size);
+  if (ec_success != error_build_id) {
+    ERROR("%s has no build-id of at most %d bytes, skipped\n", libstdcxx, LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID);
+    close(fd_libstdcxx);
+    return ec_non_fatal_error;
+  }
+
+  uint32_t version = 0;
+  // The table is filled from the parse only, never from itself
+  if (ec_success != get_libstdcxx_version_from_verdef(fd_libstdcxx, libstdcxx, &version)) {
+    ERROR("%s is not a libstdc++ of this architecture, skipped\n", libstdcxx);
+    return ec_non_fatal_error;
+  }
+  printf("  {{");
+  for (uint32_t i = 0; i < LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID; i++) {
+    printf("%s0x%02x", (i == 0) ? "" : ", ", build_id[i]);
+  }
+  printf("}, %2u, 0x%08x},\n", len_build_id, version);
+  return ec_success;
+}
+
 int main(int argc, char* argv[]) {
-  ASSERT(argc == 2, "Number of args should be exactly one\n");
-  ASSERT(argv[1] != NULL, "Invalid string arg\n");
+  const char* note_source = NULL;
+  const char* note_path = "libstdc++.so.6";
+  int fingerprints = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "fn:p:")) != -1) {
+    switch (opt) {
+      case 'f':
+        fingerprints = 1;
+        break;
+      case 'n':
+        note_source = optarg;
+        break;
+      case 'p':
+        note_path = optarg;
+        break;
+      default:
+        ASSERT(0, "Usage: %s [-n <note source> [-p <path>]] <libstdc++.so.6>\n       %s -f <libstdc++.so.6>...\n", argv[0], argv[0]);
+    }
+  }
+  if (fingerprints) {
+    ASSERT(NULL == note_source, "-f and -n are exclusive\n");
+    for (int i = optind; i < argc; i++) {
+      print_fingerprint(argv[i]);
+    }
+    return 0;
+  }
+  ASSERT((NULL != strchr(note_path, '/')) || (0 == strcmp(note_path, "libstdc++.so.6")),
+         "The note path %s is neither a path nor the soname libstdc++.so.6\n", note_path);
+  ASSERT(argc - optind == 1, "Number of args should be exactly one\n");
+  const char* const libstdcxx = argv[optind];
+  ASSERT(libstdcxx != NULL, "Invalid string arg\n");
+
+  const int fd_libstdcxx = open(libstdcxx, O_RDONLY);
+  ASSERT(fd_libstdcxx >= 0, "Invalid or missing file supplied: %s\n", libstdcxx);
+
+  struct stat st;
+  ASSERT(fstat(fd_libstdcxx, &st) == 0, "Cannot stat %s\n", libstdcxx);
+  uint8_t build_id[LIBSTDCXX_NOTE_MAX_BUILD_ID] = {0};
+  uint32_t len_build_id = 0;
+  if (note_source) {
+    const char* const mapped = (const char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd_libstdcxx, 0);
+    ASSERT(mapped != MAP_FAILED, "Cannot map %s\n", libstdcxx);
+    // A libstdc++ without build-id is described by its version and size only
+    const error_code_t error_build_id = get_elf_build_id(mapped, (size_t)st.st_size, build_id, sizeof(build_id), &len_build_id);
+    ASSERT(error_build_id >= ec_success, "Fatal Error reading the build-id of %s\n", libstdcxx);
+    munmap((void*)mapped, (size_t)st.st_size);
+  }
 
-  const int fd_libstdcxx = open(argv[1], O_RDONLY);
-  ASSERT(fd_libstdcxx >= 0, "Invalid or missing file supplied: %s\n", argv[1]);
   uint32_t version = 0;
-  const error_code_t error = get_libstdcxx_version(fd_libstdcxx, argv[1], &version);
-  ASSERT(error >= ec_success, "Fatal Error reading supplied libstdc++.so.6: %s\n", argv[1]);
-  ASSERT(error == ec_success, "Architecture (32b vs 64b) Error reading supplied libstdc++.so.6: %s\n", argv[1]);
-  printf("%08x\n", version);
+  const error_code_t error = get_libstdcxx_version(fd_libstdcxx, libstdcxx, &version);
+  ASSERT(error >= ec_success, "Fatal Error reading supplied libstdc++.so.6: %s\n", libstdcxx);
+  ASSERT(error == ec_success, "Architecture (32b vs 64b) Error reading supplied libstdc++.so.6: %s\n", libstdcxx);
   // `fd_libstdcxx` is closed by `get_libstdcxx_version`
+
+  if (note_source) {
+    FILE* const out = fopen(note_source, "w");
+    ASSERT(out, "Cannot write %s\n", note_source);
+    write_note_source(out, libstdcxx, note_path, version, (uint64_t)st.st_size, build_id, len_build_id);
+    ASSERT(fclose(out) == 0, "Cannot write %s\n", note_source);
+    return 0;
+  }
+  printf("%08x\n", version);
   return error;
 }
@@ -18,6 +18,7 @@
 
 #include "macros.h"
 #include "error_types.h"
+#include "libstdcxx_fingerprints.h"
 
 #ifndef STATIC
 #ifndef GOOGLE_TEST
@@ -64,9 +65,10 @@ STATIC uint32_t version_string_to_int(const char* const str) {
  * Function to extract the glibcxx version from a libstdc++ shared library
  * Examines the .gnu.version_d section to find the max version of the version strings of the form GLIBCXX_Major.Minor.Revision
  * Versions returned are of the form 0x00AABBCC
+ * Closes `fd`
  * @return error_code_t
  */
-STATIC error_code_t get_libstdcxx_version(const int fd, const char* const filename, uint32_t* const glibcxx_version) {
+STATIC error_code_t get_libstdcxx_version_from_verdef(const int fd, const char* const filename, uint32_t* const glibcxx_version) {
   ASSERT(fd >= 0, "Expecting an open file descriptor");
   ASSERT(filename && glibcxx_version, "Unexpected NULL arguments");
 
@@ -204,4 +206,23 @@ STATIC error_code_t get_libstdcxx_version(const int fd, const char* const filena
   return ec_success;
 }
 
+/**
+ * Function to extract the glibcxx version from a libstdc++ shared library
+ * A libstdc++ whose build-id is in the fingerprint table is identified from its first page, any other is parsed
+ * by get_libstdcxx_version_from_verdef
+ * Versions returned are of the form 0x00AABBCC
+ * Closes `fd`
+ * @return error_code_t
+ */
+STATIC error_code_t get_libstdcxx_version(const int fd, const char* const filename, uint32_t* const glibcxx_version) {
+  ASSERT(fd >= 0, "Expecting an open file descriptor");
+  ASSERT(filename && glibcxx_version, "Unexpected NULL arguments");
+  if (ec_success == get_libstdcxx_version_from_fingerprint(fd, libstdcxx_fingerprints, LIBSTDCXX_FINGERPRINTS_COUNT, glibcxx_version)) {
+    TRACE_ELF("%s identified by its build-id\n", filename);
+    close(fd);
+    return ec_success;
+  }
+  return get_libstdcxx_version_from_verdef(fd, filename, glibcxx_version);
+}
+
 #endif
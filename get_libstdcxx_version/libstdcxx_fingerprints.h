@@ -0,0 +1,120 @@
+#ifndef _LIBSTDCXX_FINGERPRINTS_H_
+#define _LIBSTDCXX_FINGERPRINTS_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <elf.h>
+#include <link.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "error_types.h"
+#include "libstdcxx_note.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+/**
+ * Table of known libstdc++ builds, identified by their GNU build-id, and their max GLIBCXX version.
+ * A libstdc++ found in the table is identified from the first page of the file, without mapping it and walking .gnu.version_d.
+ * The rows are in libstdcxx_fingerprints.inc, generated by generate_libstdcxx_fingerprints.cmake from a corpus of libstdc++
+ * (see the update_libstdcxx_fingerprints target). They are sorted by build-id, zero padded to LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID
+ * bytes, then by its length, for a binary search.
+ */
+#define LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID 20
+// The ELF header, program headers and PT_NOTE of the build-id are at the start of the file
+#define LIBSTDCXX_FINGERPRINT_PAGE_SIZE 4096
+#if __ELF_NATIVE_CLASS == 64
+#define LIBSTDCXX_FINGERPRINT_ELFCLASS ELFCLASS64
+#else
+#define LIBSTDCXX_FINGERPRINT_ELFCLASS ELFCLASS32
+#endif
+
+typedef struct {
+  uint8_t build_id[LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID];
+  uint32_t len_build_id;
+  uint32_t glibcxx_version;
+} libstdcxx_fingerprint_t;
+
+// The definitions are C. test.cpp includes the header for the types only
+#ifndef __cplusplus
+
+static const libstdcxx_fingerprint_t libstdcxx_fingerprints[] = {
+#include "libstdcxx_fingerprints.inc"
+};
+#define LIBSTDCXX_FINGERPRINTS_COUNT (sizeof(libstdcxx_fingerprints) / sizeof(libstdcxx_fingerprints[0]))
+
+STATIC int libstdcxx_fingerprint_compare(const uint8_t* const build_id, const uint32_t len_build_id, const libstdcxx_fingerprint_t* const fingerprint) {
+  const int order = memcmp(build_id, fingerprint->build_id, LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID);
+  if (0 != order) {
+    return order;
+  }
+  return (len_build_id > fingerprint->len_build_id) - (len_build_id < fingerprint->len_build_id);
+}
+
+/**
+ * Binary search of a build-id in a sorted table of fingerprints
+ * @return error_code_t ec_success if found, ec_non_fatal_error otherwise
+ */
+STATIC error_code_t libstdcxx_fingerprint_lookup(const libstdcxx_fingerprint_t* const table, const size_t count, const uint8_t* const build_id,
+                                                 const uint32_t len_build_id, uint32_t* const glibcxx_version) {
+  ASSERT(build_id && glibcxx_version, "Unexpected NULL arguments");
+  if ((0 == len_build_id) || (len_build_id > LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID)) {
+    return ec_non_fatal_error;
+  }
+  uint8_t padded[LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID] = {0};
+  memcpy(padded, build_id, len_build_id);
+  size_t low = 0;
+  size_t high = count;
+  while (low < high) {
+    const size_t middle = low + ((high - low) / 2);
+    const int order = libstdcxx_fingerprint_compare(padded, len_build_id, &table[middle]);
+    if (0 == order) {
+      *glibcxx_version = table[middle].glibcxx_version;
+      return ec_success;
+    } else if (order < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  return ec_non_fatal_error;
+}
+
+/**
+ * Identify a libstdc++ from the build-id in the first page of the file `fd`. The file offset of `fd` is unchanged
+ * @return error_code_t ec_success if its build-id is in `table`, ec_non_fatal_error if it has to be parsed
+ */
+STATIC error_code_t get_libstdcxx_version_from_fingerprint(const int fd, const libstdcxx_fingerprint_t* const table, const size_t count,
+                                                           uint32_t* const glibcxx_version) {
+  ASSERT(fd >= 0, "Expecting an open file descriptor");
+  ASSERT(glibcxx_version, "Unexpected NULL arguments");
+  if (0 == count) {
+    return ec_non_fatal_error;
+  }
+  char page[LIBSTDCXX_FINGERPRINT_PAGE_SIZE] __attribute__((aligned(8)));
+  const ssize_t len_page = pread(fd, page, sizeof(page), 0);
+  if ((len_page < (ssize_t)sizeof(ElfW(Ehdr))) || (((const ElfW(Ehdr)*)page)->e_ident[EI_CLASS] != LIBSTDCXX_FINGERPRINT_ELFCLASS)) {
+    return ec_non_fatal_error;
+  }
+  uint8_t build_id[LIBSTDCXX_FINGERPRINT_MAX_BUILD_ID];
+  uint32_t len_build_id = 0;
+  // PT_NOTE segments outside of the page are not read, the file is then parsed
+  if (ec_success != get_elf_build_id(page, (size_t)len_page, build_id, sizeof(build_id), &len_build_id)) {
+    return ec_non_fatal_error;
+  }
+  return libstdcxx_fingerprint_lookup(table, count, build_id, len_build_id, glibcxx_version);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef _LIBSTDCXX_NOTE_H_
+#define _LIBSTDCXX_NOTE_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <elf.h>
+#include <link.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "macros.h"
+#include "error_types.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+// Helpers of a header that not every including file uses
+#ifndef STATIC_INLINE
+#ifndef GOOGLE_TEST
+#define STATIC_INLINE static inline
+#else
+#define STATIC_INLINE
+#endif
+#endif
+
+/**
+ * Layout of the .note.audit_libstdcxx ELF note that link_audit_libstdcxx stamps into an executable.
+ * It describes the shipped libstdc++ the executable was linked against, so the audit library does not have to find
+ * and parse it at every exec. The note is an ordinary ELF note (Elf_Nhdr, name, desc) in an allocated SHT_NOTE
+ * section, which the linker places in a PT_NOTE segment.
+ * All desc fields are 32 bit so the desc only needs the 4 byte alignment of ELF notes.
+ */
+#define LIBSTDCXX_NOTE_SECTION ".note.audit_libstdcxx"
+#define LIBSTDCXX_NOTE_NAME "AuditLibstdcxx"
+#define LIBSTDCXX_NOTE_TYPE 1
+#define LIBSTDCXX_NOTE_MAX_BUILD_ID 64
+
+typedef struct {
+  uint32_t glibcxx_version;
+  // Size of the shipped libstdc++ in bytes. A different size on disk means the note is stale
+  uint32_t file_size_low;
+  uint32_t file_size_high;
+  uint32_t len_build_id;
+  uint8_t build_id[LIBSTDCXX_NOTE_MAX_BUILD_ID];
+  // Followed by the NUL terminated path of the shipped libstdc++. The soname is looked up in DT_RUNPATH/DT_RPATH, a relative
+  // path is relative to the directory of the executable
+} libstdcxx_note_desc_t;
+
+// The definitions are C. test.cpp includes the header for the types only
+#ifndef __cplusplus
+
+STATIC_INLINE size_t elf_note_align(const size_t size) {
+  return (size + 3) & ~(size_t)3;
+}
+
+/**
+ * Find the first note called `name` of type `type` in a buffer of ELF notes (the contents of a PT_NOTE segment)
+ * @return error_code_t ec_success if found, ec_non_fatal_error if absent, ec_fatal_error if the notes are malformed
+ */
+STATIC_INLINE error_code_t elf_note_find(
+  const char* const notes,
+  const size_t len_notes,
+  const char* const name,
+  const uint32_t type,
+  const char** const p_desc,
+  size_t* const p_len_desc
+) {
+  ASSERT(notes && name && p_desc && p_len_desc, "Unexpected NULL arguments");
+  const size_t len_name = strlen(name) + 1;
+  size_t offset = 0;
+  while ((len_notes - offset) >= sizeof(ElfW(Nhdr))) {
+    const ElfW(Nhdr)* const nhdr = (const ElfW(Nhdr)*)(notes + offset);
+    const size_t offset_name = offset + sizeof(ElfW(Nhdr));
+    const size_t len_name_padded = elf_note_align(nhdr->n_namesz);
+    const size_t len_desc_padded = elf_note_align(nhdr->n_descsz);
+    if ((len_name_padded > (len_notes - offset_name)) || (len_desc_padded > (len_notes - offset_name - len_name_padded))) {
+      return ec_fatal_error;
+    }
+    if ((nhdr->n_type == type) && (nhdr->n_namesz == len_name) && (0 == memcmp(notes + offset_name, name, len_name))) {
+      *p_desc = notes + offset_name + len_name_padded;
+      *p_len_desc = nhdr->n_descsz;
+      return ec_success;
+    }
+    offset = offset_name + len_name_padded + len_desc_padded;
+  }
+  return ec_non_fatal_error;
+}
+
+/**
+ * Validate the desc of a .note.audit_libstdcxx note and return its path
+ * @return error_code_t ec_success if the desc is well formed
+ */
+STATIC_INLINE error_code_t libstdcxx_note_parse(const char* const desc, const size_t len_desc, const libstdcxx_note_desc_t** const p_note, const char** const p_path) {
+  ASSERT(desc && p_note && p_path, "Unexpected NULL arguments");
+  if (len_desc <= sizeof(libstdcxx_note_desc_t)) {
+    return ec_fatal_error;
+  }
+  const libstdcxx_note_desc_t* const note = (const libstdcxx_note_desc_t*)desc;
+  if ((0 == note->glibcxx_version) || (note->len_build_id > LIBSTDCXX_NOTE_MAX_BUILD_ID)) {
+    return ec_fatal_error;
+  }
+  const char* const path = desc + sizeof(libstdcxx_note_desc_t);
+  const size_t len_path_max = len_desc - sizeof(libstdcxx_note_desc_t);
+  if ((path[0] == '\0') || (NULL == memchr(path, '\0', len_path_max))) {
+    return ec_fatal_error;
+  }
+  *p_note = note;
+  *p_path = path;
+  return ec_success;
+}
+
+/**
+ * Read the GNU build-id of a mapped ELF file of the native class from its PT_NOTE segments
+ * @return error_code_t ec_success if found, ec_non_fatal_error if the file has no build-id, ec_fatal_error if it is not a valid ELF
+ */
+STATIC_INLINE error_code_t get_elf_build_id(const char* const mapped, const size_t file_size, uint8_t* const build_id, const size_t len_build_id_max, uint32_t* const p_len_build_id) {
+  ASSERT(mapped && build_id && p_len_build_id, "Unexpected NULL arguments");
+  *p_len_build_id = 0;
+  if ((file_size < sizeof(ElfW(Ehdr))) || (0 != memcmp(mapped, ELFMAG, SELFMAG))) {
+    return ec_fatal_error;
+  }
+  const ElfW(Ehdr)* const ehdr = (const ElfW(Ehdr)*)mapped;
+  if ((ehdr->e_phoff >= file_size) || (ehdr->e_phnum > ((file_size - ehdr->e_phoff) / sizeof(ElfW(Phdr))))) {
+    return ec_fatal_error;
+  }
+  const ElfW(Phdr)* const phdr = (const ElfW(Phdr)*)(mapped + ehdr->e_phoff);
+  for (size_t i = 0; i < ehdr->e_phnum; i++) {
+    if ((phdr[i].p_type != PT_NOTE) || (phdr[i].p_offset >= file_size) || (phdr[i].p_filesz > (file_size - phdr[i].p_offset))) {
+      continue;
+    }
+    const char* desc = NULL;
+    size_t len_desc = 0;
+    if ((ec_success == elf_note_find(mapped + phdr[i].p_offset, phdr[i].p_filesz, "GNU", NT_GNU_BUILD_ID, &desc, &len_desc)) &&
+        (len_desc <= len_build_id_max)) {
+      memcpy(build_id, desc, len_desc);
+      *p_len_build_id = (uint32_t)len_desc;
+      return ec_success;
+    }
+  }
+  return ec_non_fatal_error;
+}
+
+#endif
+
+#endif
@@ -24,15 +24,25 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include <elf.h>
 #include <fcntl.h>
 #include <libgen.h>
+#include <limits.h>
 #include <link.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/auxv.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "audit_libstdcxx_export.h"
+#include "decision_env.h"
+#include "dt_path_probe.h"
+#include "find_libstdcxx.h"
 #include "get_libstdcxx_version.h"
+#include "libstdcxx_memo.h"
+#include "libstdcxx_note.h"
+#include "objsearch_record.h"
 #include "macros.h"
 #include "error_types.h"
 
@@ -44,223 +54,501 @@ OTHER DEALINGS IN THE SOFTWARE.
 #endif
 #endif
 
-static const char libstdcxx_rel_path[] = "/libstdc++.so.6";
-static const size_t len_libstdcxx_rel_path = 15;
-static const uint32_t invalid_glibcxx_version = 0xDEADBEEF;
+// Set by the audit_libstdcxx_freestanding target, whose process has no libc of the audit library for ld.so to load first
+#ifndef AUDIT_LIBSTDCXX_FREESTANDING
+#define AUDIT_LIBSTDCXX_FREESTANDING 0
+#endif
 
-STATIC size_t size_t_min(size_t a, size_t b) {
-  return (a < b) ? a : b;
-}
+static const uint32_t invalid_glibcxx_version = 0xDEADBEEF;
 
 /**
- * Retrieve the dt_runpath or dt_rpath from the parent exectuable's Program Header
- * @return error_code_t
+ * Retrieve the .note.audit_libstdcxx note of the parent executable from its PT_NOTE segments, which are already mapped
+ * @return error_code_t ec_success if the executable carries a well formed note
  */
-STATIC error_code_t get_parent_executable_runpath_rpath(const ElfW(Phdr) * const phdr, const size_t phnum, const char** const dt_runpath, const char** const dt_rpath) {
-  ASSERT(dt_runpath && dt_rpath, "Unexpected NULL arguments\n");
-
-  ASSERT(phdr && phnum, "Failed to retrieve program headers from aux vectors\n");
-
-  // Find the base address by finding PT_PHDR and working backwards
-  ElfW(Addr) base_address = 0;
+STATIC error_code_t get_parent_executable_libstdcxx_note(const ElfW(Phdr) * const phdr, const size_t phnum, const libstdcxx_note_desc_t** const p_note, const char** const p_path) {
+  ASSERT(phdr && phnum && p_note && p_path, "Unexpected NULL arguments\n");
 
+  const ElfW(Addr) base_address = get_parent_executable_base_address(phdr, phnum);
   for (size_t i = 0; i < phnum; i++) {
-    if (phdr[i].p_type == PT_PHDR) {
-      base_address = (ElfW(Addr))phdr - phdr[i].p_vaddr;
-      break;
+    if (phdr[i].p_type != PT_NOTE) {
+      continue;
+    }
+    const char* desc = NULL;
+    size_t len_desc = 0;
+    const error_code_t error = elf_note_find((const char*)(base_address + phdr[i].p_vaddr), phdr[i].p_filesz, LIBSTDCXX_NOTE_NAME, LIBSTDCXX_NOTE_TYPE, &desc, &len_desc);
+    if (ec_success == error) {
+      return libstdcxx_note_parse(desc, len_desc, p_note, p_path);
     }
   }
+  return ec_non_fatal_error;
+}
 
-  TRACE("base_address %lu\n", (unsigned long)base_address);
+// Candidates read ahead at once: the shipped libstdc++ and the one of ld.so.cache
+#define LIBSTDCXX_READAHEAD_MAX 2
 
-  error_code_t error = ec_fatal_error;
-  // Iterate over program headers to locate PT_DYNAMIC
-  for (size_t i = 0; i < phnum; i++) {
-    if (phdr[i].p_type == PT_DYNAMIC) {
-      ElfW(Dyn)* dynamic = (ElfW(Dyn)*)(base_address + phdr[i].p_vaddr);
-      const char* strtab = NULL;
-
-      // Parse the dynamic section to find DT_RUNPATH and DT_RPATH
-      for (ElfW(Dyn)* dyn = dynamic; dyn->d_tag != DT_NULL; dyn++) {
-        if (dyn->d_tag == DT_STRTAB) {
-          strtab = (const char*)(dyn->d_un.d_ptr);
-        }
-      }
+/**
+ * Ask the kernel to start reading the first page of the libstdc++ candidates `fds`, which holds the ELF header, the program
+ * headers and the build-id that get_libstdcxx_version looks up in the fingerprint table. Nothing is read here: la_version
+ * returns at once, and the reads overlap with what ld.so does until the first search for libstdc++, which parses them
+ */
+STATIC void readahead_libstdcxx(const int* const fds, const size_t count) {
+  ASSERT(count <= LIBSTDCXX_READAHEAD_MAX, "Too many candidates\n");
+  for (size_t i = 0; i < count; i++) {
+    posix_fadvise(fds[i], 0, LIBSTDCXX_FINGERPRINT_PAGE_SIZE, POSIX_FADV_WILLNEED);
+  }
+}
 
-      ASSERT(strtab, "No strtab found in program header\n");
-
-      for (ElfW(Dyn)* dyn = dynamic; dyn->d_tag != DT_NULL; dyn++) {
-        if (dyn->d_tag == DT_RUNPATH) {
-          *dt_runpath = strtab + dyn->d_un.d_val;
-          error = ec_success;
-          TRACE("DT_RUNPATH: %s\n", strtab + dyn->d_un.d_val);
-        } else if (dyn->d_tag == DT_RPATH) {
-          *dt_rpath = strtab + dyn->d_un.d_val;
-          error = ec_success;
-          TRACE("DT_RPATH: %s\n", strtab + dyn->d_un.d_val);
-        }
-      }
-      break;
-    }
+/**
+ * Find the first libstdc++ of a DT_RUNPATH or DT_RPATH accepted by `trypath_callback`.
+ * With AUDIT_LIBSTDCXX_CONCURRENT_PROBE, every candidate is probed at once before the ordered search, so missing
+ * entries of a high latency file system cost one round trip in total instead of one each
+ * @return error_code_t
+ */
+STATIC error_code_t find_libstdcxx_in_dt_path(
+  const char* const dt_path,
+  const char* const ORIGIN,
+  error_code_t (*trypath_callback)(const char* const path, void* data),
+  void* callback_data,
+  char** p_path,
+  size_t* p_path_buffer_len
+) {
+  // When recording, every candidate tried is recorded
+  objsearch_record_trypath_t recorded = {trypath_callback, callback_data};
+  if (objsearch_record_enabled()) {
+    trypath_callback = &objsearch_record_trypath;
+    callback_data = (void*)&recorded;
   }
-  return error;
+#if AUDIT_LIBSTDCXX_CONCURRENT_PROBE
+  dt_path_probe_backend_t backend = dt_path_probe_any;
+  return find_libstdcxx_from_dt_path_concurrent(dt_path, ORIGIN, trypath_callback, callback_data, p_path, p_path_buffer_len, &backend, NULL);
+#else
+  return find_libstdcxx_from_dt_path(dt_path, ORIGIN, trypath_callback, callback_data, p_path, p_path_buffer_len);
+#endif
 }
 
 /**
- * This function checks whether a path exists and returns the _open_ fd in the void* data.
- * The caller is responsible for closing the open fd.
- * A callback is used to facilitate unit testing
+ * Callback of find_libstdcxx_from_dt_path that only stats the candidate, into the struct stat at `data`
  * @return error_code_t
  */
-STATIC error_code_t trypath(const char* const path, void* data) {
+STATIC error_code_t statpath(const char* const path, void* data) {
   ASSERT(NULL != data && NULL != path, "Unexpected NULL argument");
-  // Check if the path exists
-  TRACE("Trying path %s\n", path);
-  int fd = open(path, O_RDONLY);
+  TRACE("Stat path %s\n", path);
+  return (0 == stat(path, (struct stat*)data)) ? ec_success : ec_fatal_error;
+}
 
-  // File does not exist
+/**
+ * Check the build-id recorded in a .note.audit_libstdcxx note against the one in the first page of the libstdc++ at `path`
+ * @return error_code_t ec_success if they are the same
+ */
+STATIC error_code_t check_libstdcxx_note_build_id(const char* const path, const libstdcxx_note_desc_t* const note) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
   if (fd < 0) {
     return ec_fatal_error;
   }
-
-  // Store the fd in data pointer, to be used by the caller
-  *((int*)data) = fd;
-
+  char page[LIBSTDCXX_FINGERPRINT_PAGE_SIZE] __attribute__((aligned(8)));
+  const ssize_t len_page = pread(fd, page, sizeof(page), 0);
+  close(fd);
+  uint8_t build_id[LIBSTDCXX_NOTE_MAX_BUILD_ID];
+  uint32_t len_build_id = 0;
+  if ((len_page <= 0) || (ec_success != get_elf_build_id(page, (size_t)len_page, build_id, sizeof(build_id), &len_build_id)) ||
+      (len_build_id != note->len_build_id) || (0 != memcmp(build_id, note->build_id, len_build_id))) {
+    return ec_fatal_error;
+  }
   return ec_success;
 }
 
 /**
- * From a DT_RUNPATH or DT_RPATH, find the first path that contains libstdc++.so.6
- * DT_RUNPATH / DT_PATH are colon separated list of directories to search for dependencies
- * ex:  "$ORIGIN:$ORIGIN../lib"
- * Replace $ORIGIN as necessary
- * NOTE: on a success, the caller of this function owns the buffer at *p_path and must munmap as necessary
- * @return error_code_t
+ * Find the shipped libstdc++ from the .note.audit_libstdcxx note of the parent executable, without parsing the library.
+ * An absolute note path is used as is, a relative one is relative to ORIGIN. The soname, without a directory, is looked up
+ * in DT_RUNPATH then DT_RPATH, like ld.so looks it up. Any other bare name is rejected.
+ * The note is stale, and is ignored, if the library it names is gone, does not have the recorded size or, when the note
+ * records a build-id, does not have the same build-id in its first page.
+ * On success, the path is copied into `path` (of `len_path` bytes) and `st` holds the stat of the library
+ * @return error_code_t ec_success if the note is present and current
  */
-STATIC error_code_t find_libstdcxx_from_dt_path(
-  const char* const dt_path,
+STATIC error_code_t find_libstdcxx_from_note(
+  const ElfW(Phdr) * const phdr,
+  const size_t phnum,
+  const char* const dt_runpath,
+  const char* const dt_rpath,
   const char* const ORIGIN,
-  error_code_t (*trypath_callback)(const char* const path, void* data),
-  void* callback_data,
-  char** p_path,
-  size_t* p_path_buffer_len
+  char* const path,
+  const size_t len_path,
+  uint32_t* const glibcxx_version,
+  struct stat* const st
 ) {
-  ASSERT(p_path && p_path_buffer_len, "Unexpected NULL arguments");
+  ASSERT(dt_runpath && dt_rpath && ORIGIN && path && glibcxx_version && st, "Unexpected NULL arguments\n");
 
-  const size_t dt_path_len = strlen(dt_path);
-  const size_t len_ORIGIN = strlen(ORIGIN);
+  const libstdcxx_note_desc_t* note = NULL;
+  const char* note_path = NULL;
+  if (ec_success != get_parent_executable_libstdcxx_note(phdr, phnum, &note, &note_path)) {
+    TRACE("No .note.audit_libstdcxx\n");
+    return ec_non_fatal_error;
+  }
 
-  char* libstdcxx_path = NULL;
-  size_t len_path_buffer = 0;
-  *p_path = NULL;
-  *p_path_buffer_len = 0;
+  const size_t len_note_path = strlen(note_path);
+  if (note_path[0] == '/') {
+    if ((len_note_path >= len_path) || (0 != stat(note_path, st))) {
+      TRACE("Stale .note.audit_libstdcxx for %s\n", note_path);
+      return ec_fatal_error;
+    }
+    memcpy(path, note_path, len_note_path + 1);
+  } else if (NULL != strchr(note_path, '/')) {
+    const size_t len_ORIGIN = strlen(ORIGIN);
+    if ((len_ORIGIN + 1 + len_note_path) >= len_path) {
+      return ec_fatal_error;
+    }
+    memcpy(path, ORIGIN, len_ORIGIN);
+    path[len_ORIGIN] = '/';
+    memcpy(path + len_ORIGIN + 1, note_path, len_note_path + 1);
+    if (0 != stat(path, st)) {
+      TRACE("Stale .note.audit_libstdcxx for %s\n", path);
+      return ec_fatal_error;
+    }
+  } else if (0 == strcmp(note_path, libstdcxx_rel_path + 1)) {
+    error_code_t found = ec_fatal_error;
+    char* found_path = NULL;
+    size_t len_found_path_buffer = 0;
+    if (dt_runpath[0] != '\0') {
+      found = find_libstdcxx_in_dt_path(dt_runpath, ORIGIN, &statpath, (void*)st, &found_path, &len_found_path_buffer);
+    }
+    if (ec_success != found) {
+      found = find_libstdcxx_in_dt_path(dt_rpath, ORIGIN, &statpath, (void*)st, &found_path, &len_found_path_buffer);
+    }
+    if ((ec_success == found) && (strlen(found_path) < len_path)) {
+      memcpy(path, found_path, strlen(found_path) + 1);
+    } else {
+      found = ec_fatal_error;
+    }
+    path_arena_free(found_path, len_found_path_buffer);
+    if (ec_success != found) {
+      TRACE("Stale .note.audit_libstdcxx, %s is not in DT_RUNPATH/DT_RPATH\n", note_path);
+      return ec_fatal_error;
+    }
+  } else {
+    ERROR("Audit library: .note.audit_libstdcxx names %s, neither a path nor the soname of libstdc++\n", note_path);
+    return ec_fatal_error;
+  }
 
-  const char* dt_path_cursor = dt_path;
+  const uint64_t file_size = ((uint64_t)note->file_size_high << 32) | note->file_size_low;
+  if ((uint64_t)st->st_size != file_size) {
+    TRACE("Stale .note.audit_libstdcxx for %s\n", path);
+    return ec_fatal_error;
+  }
+  // A rebuild of the same size is told apart by its build-id. Without one, the size is all there is to compare
+  if ((note->len_build_id > 0) && (ec_success != check_libstdcxx_note_build_id(path, note))) {
+    TRACE("Stale .note.audit_libstdcxx for %s, its build-id changed\n", path);
+    return ec_fatal_error;
+  }
+  *glibcxx_version = note->glibcxx_version;
+  TRACE("libstdc++ %s (%x) from .note.audit_libstdcxx\n", path, note->glibcxx_version);
+  return ec_success;
+}
 
-  TRACE("dt_path %s\n", dt_path);
-  TRACE("dt_path_len %lu\n", (unsigned long)dt_path_len);
+/**
+ * Retrieve the glibcxx version of the libstdc++ at `path`, whose fstat is `st`.
+ * `fd` is a descriptor of `path` already open, which is consumed, or -1. The file is only opened and parsed if its
+ * identity is not in the memo yet.
+ * A library of the wrong architecture is remembered with invalid_glibcxx_version and reported as ec_non_fatal_error
+ * @return error_code_t
+ */
+STATIC error_code_t get_memoized_libstdcxx_version(const char* const path, int fd, const struct stat* const st, uint32_t* const glibcxx_version) {
+  const libstdcxx_memo_entry_t* const memo = libstdcxx_memo_find(st->st_dev, st->st_ino);
+  if (NULL != memo) {
+    TRACE("Memo hit for %s: %x\n", path, memo->glibcxx_version);
+    if (fd >= 0) {
+      close(fd);
+    }
+    *glibcxx_version = memo->glibcxx_version;
+    return (memo->glibcxx_version == invalid_glibcxx_version) ? ec_non_fatal_error : ec_success;
+  }
+  if (fd < 0) {
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+  }
+  if (fd < 0) {
+    return ec_fatal_error;
+  }
+  const error_code_t error = get_libstdcxx_version(fd, path, glibcxx_version);
+  if (error >= ec_non_fatal_error) {
+    *glibcxx_version = invalid_glibcxx_version;
+  }
+  if (error != ec_fatal_error) {
+    libstdcxx_memo_insert(st->st_dev, st->st_ino, *glibcxx_version);
+  }
+  return error;
+}
 
-  while (dt_path_cursor < (dt_path + dt_path_len)) {
-    const char* end_of_this_section = dt_path_cursor;
-    // Find the termination of this section. (Either the ':' or '\0')
-    // clang-format off
-    for(;
-      (end_of_this_section < (dt_path + dt_path_len)) &&
-      *end_of_this_section != ':' &&
-      *end_of_this_section != '\0'; end_of_this_section++) {
+// All paths live in static storage. Nothing is released at LA_ACT_CONSISTENT, so the resolution stays resident for the
+// life of the process and a later dlopen or dlmopen (in any link-map namespace) is answered in O(1) without rediscovery
+STATIC uint32_t shipped_glibcxx_version = invalid_glibcxx_version;
+STATIC char* shipped_libstdcxx_path = NULL;
+static char shipped_path_storage[PATH_MAX];
+STATIC dev_t shipped_dev = 0;
+STATIC ino_t shipped_ino = 0;
+
+// Decision latch. Once a libstdc++ has been chosen, every later search for libstdc++ is answered with the same path
+// without touching the file system. Its path is `shipped_libstdcxx_path`, `decided_system_path` or `cached_system_path`
+STATIC libstdcxx_decision_t libstdcxx_decision = {NULL, 0, 0, 0};
+static char decided_system_path[PATH_MAX];
+
+// Decision planned in la_version from ld.so.cache, before ld.so starts searching. Applied on the first search for libstdc++
+// that ld.so makes after LD_LIBRARY_PATH, which redirects it to the winner and skips the probes of the remaining directories.
+// DT_RPATH is searched before LD_LIBRARY_PATH, so when the requesting object has no DT_RUNPATH, and ld.so searches the DT_RPATH
+// of it and of its loaders, the plan waits for the ld.so.cache search.
+STATIC libstdcxx_decision_t planned_decision = {NULL, 0, 0, 0};
+static char cached_system_path[PATH_MAX];
+
+// The cookie la_objopen gives an object: whether it has a DT_RUNPATH in the low bit, its id in the recording above it
+#define OBJECT_COOKIE_RUNPATH ((uintptr_t)1)
+#define OBJECT_COOKIE_ID_SHIFT 1
 
-    }
-    // clang-format on
+/**
+ * Latch the decision. Every later search for libstdc++ returns `path`
+ * @return the path to hand back to ld.so
+ */
+static char* latch_libstdcxx_decision(const char* const path, const uint32_t glibcxx_version, const dev_t dev, const ino_t ino) {
+  libstdcxx_decision.path = path;
+  libstdcxx_decision.glibcxx_version = glibcxx_version;
+  libstdcxx_decision.dev = dev;
+  libstdcxx_decision.ino = ino;
+  return (char*)path;
+}
 
-    size_t len_section = (size_t)(end_of_this_section - dt_path_cursor);
-    if (len_section == 0) {
-      dt_path_cursor++;
-      continue;
-    }
+// Override of the policy, to compare candidates: every search for libstdc++ is answered with the libstdc++ at this path
+#define FORCE_ENV "AUDIT_LIBSTDCXX_FORCE"
+static char forced_path[PATH_MAX];
 
-    // Construct a path to libstdc++
-    TRACE("This section and on %s\n", dt_path_cursor);
-    TRACE("section len %lu\n", (unsigned long)len_section);
-    if (0 == strncmp("$ORIGIN", dt_path_cursor, 7)) {
-      TRACE("substitute $ORIGIN\n");
-
-      // Allocate space for the follow path
-      // $ORIGIN/section_path/libstdc++\0
-      size_t needed_len = len_ORIGIN + (len_section - 7) + len_libstdcxx_rel_path + 1;
-      if (needed_len > len_path_buffer) {
-        if (len_path_buffer) {
-          munmap(libstdcxx_path, len_path_buffer);
-        }
-        libstdcxx_path = (char*)mmap(NULL, needed_len, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
-        if (libstdcxx_path == MAP_FAILED) {
-          ERROR("Audit library: Failed to allocate memory for libstdc++ path. runtime link errors may occur\n");
-          return ec_fatal_error;
-        }
-        len_path_buffer = needed_len;
-      }
-      // Truncate
-      libstdcxx_path[0] = '\0';
-
-      // Construct the string
-      strncat(libstdcxx_path, ORIGIN, len_path_buffer - 1);
-      libstdcxx_path[len_path_buffer - 1] = '\0';
-      dt_path_cursor += 7;
-      len_section -= 7;
-      if (len_section > 0) {
-        strncat(libstdcxx_path, dt_path_cursor, size_t_min(len_section, len_path_buffer - 1 - len_ORIGIN));
-        libstdcxx_path[len_path_buffer - 1] = '\0';
-      }
-      strncat(libstdcxx_path, libstdcxx_rel_path, len_path_buffer - 1 - len_ORIGIN - len_section);
-      libstdcxx_path[len_path_buffer - 1] = '\0';
+/**
+ * Latch the libstdc++ at `path` as the decision, whatever its version
+ * @return error_code_t ec_success if `path` is a libstdc++ of this architecture
+ */
+STATIC error_code_t force_libstdcxx(const char* const path) {
+  ASSERT(NULL != path, "Unexpected NULL argument\n");
+  const size_t len_path = strlen(path);
+  struct stat st;
+  uint32_t glibcxx_version = 0;
+  if ((len_path >= sizeof(forced_path)) || (0 != stat(path, &st)) || (ec_success != get_memoized_libstdcxx_version(path, -1, &st, &glibcxx_version))) {
+    return ec_fatal_error;
+  }
+  memcpy(forced_path, path, len_path + 1);
+  latch_libstdcxx_decision(forced_path, glibcxx_version, st.st_dev, st.st_ino);
+  TRACE("Forced libstdc++ %s (%x)\n", forced_path, glibcxx_version);
+  return ec_success;
+}
 
-    } else {
-      size_t needed_len = len_section + len_libstdcxx_rel_path + 1;
-      if (needed_len > len_path_buffer) {
-        if (len_path_buffer) {
-          munmap(libstdcxx_path, len_path_buffer);
-        }
-        libstdcxx_path = (char*)mmap(NULL, needed_len, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
-        if (libstdcxx_path == MAP_FAILED) {
-          ERROR("Audit library: Failed to allocate memory for libstdc++ path. runtime link errors may occur\n");
-          return ec_fatal_error;
-        }
-        len_path_buffer = needed_len;
-      }
-      libstdcxx_path[0] = '\0';
-      strncat(libstdcxx_path, dt_path_cursor, size_t_min(len_section, len_path_buffer - 1));
-      libstdcxx_path[len_path_buffer - 1] = '\0';
-      strncat(libstdcxx_path, libstdcxx_rel_path, len_path_buffer - 1 - len_section);
-      libstdcxx_path[len_path_buffer - 1] = '\0';
-    }
+#if AUDIT_LIBSTDCXX_FREESTANDING
+/**
+ * Whether the directory part of the search candidate `path` exists
+ */
+STATIC int candidate_directory_exists(const char* const path) {
+  const char* const slash = strrchr(path, '/');
+  if ((NULL == slash) || ((size_t)(slash - path) >= PATH_MAX)) {
+    return 0;
+  }
+  char directory[PATH_MAX];
+  const size_t len_directory = (slash == path) ? 1 : (size_t)(slash - path);
+  memcpy(directory, path, len_directory);
+  directory[len_directory] = '\0';
+  struct stat st;
+  return (0 == stat(directory, &st)) && S_ISDIR(st.st_mode);
+}
+#endif
 
-    // Check if the path at `shipped_libstdcxx_path` exists
-    TRACE("Trying path %s\n", libstdcxx_path);
-    if (0 == trypath_callback(libstdcxx_path, callback_data)) {
-      // found libstdc++ in RUNPATH/RPATH. Can return indicating success
+/**
+ * ld.so runs the constructors of the audit library before la_version, with the arguments of the process.
+ * `envp` is the initial environment array, which the libc of the executable adopts later
+ */
+__attribute__((constructor)) static void capture_environment(int argc, char** argv, char** envp) {
+  (void)argc;
+  (void)argv;
+  if (!getauxval(AT_SECURE)) {
+    decision_env_capture(envp);
+  }
+}
 
-      // Return the path and length of the buffer
-      *p_path = libstdcxx_path;
-      *p_path_buffer_len = len_path_buffer;
+// What la_version captured of the executable, for the search of the shipped libstdc++
+static char executable_origin_storage[PATH_MAX];
+static const char* executable_ORIGIN = NULL;
+static const char* executable_dt_runpath = "";
+static const char* executable_dt_rpath = "";
+static const ElfW(Phdr)* executable_phdr = NULL;
+static size_t executable_phnum = 0;
+static error_code_t executable_paths_error = ec_fatal_error;
+
+// Lazy mode: la_version only captures the above, and the shipped libstdc++ is searched and parsed on the first search for
+// libstdc++. A process that never loads libstdc++ (a C tool, a static helper) then pays for little more than getauxval
+#define LAZY_ENV "AUDIT_LIBSTDCXX_LAZY"
+static int shipped_search_pending = 0;
+
+// Between find_shipped_libstdcxx in la_version and parse_shipped_libstdcxx on the first search for libstdc++: the candidates
+// still open, whose first page the kernel reads meanwhile, and what is known of the shipped one without parsing it
+static int shipped_parse_pending = 0;
+static int pending_shipped_fd = -1;
+static int pending_cached_system_fd = -1;
+static struct stat pending_st_shipped;
+static int pending_have_shipped_identity = 0;
+static int pending_use_decision_env = 0;
+static uint64_t pending_decision_key = 0;
 
-      // No munmap occurs! The caller now owns the buffer
-      return ec_success;
+/**
+ * Find the shipped libstdc++ of the executable, from the decision inherited from the parent, the .note.audit_libstdcxx note
+ * or DT_RUNPATH/DT_RPATH, and the ld.so.cache libstdc++. Both are left open and only read ahead: parse_shipped_libstdcxx
+ * reads them on the first search for libstdc++.
+ * On failure, shipped_libstdcxx_path stays NULL and every search is left to ld.so
+ */
+STATIC void find_shipped_libstdcxx(void) {
+  const char* const ORIGIN = executable_ORIGIN;
+  const char* const dt_runpath = executable_dt_runpath;
+  const char* const dt_rpath = executable_dt_rpath;
+  const ElfW(Phdr)* const phdr = executable_phdr;
+  const size_t phnum = executable_phnum;
+  ASSERT(NULL != ORIGIN, "la_version has not captured the executable\n");
+
+  // A parent that searched the same DT_RUNPATH/DT_RPATH from the same ORIGIN published its shipped libstdc++. A relative
+  // ORIGIN depends on the working directory, so it is neither trusted nor published
+  const int use_decision_env = (NULL != decision_env_slot) && (ec_success == executable_paths_error) && (ORIGIN[0] == '/');
+  if (use_decision_env) {
+    const libstdcxx_note_desc_t* note = NULL;
+    const char* note_path = NULL;
+    const int have_note = (ec_success == get_parent_executable_libstdcxx_note(phdr, phnum, &note, &note_path));
+    pending_decision_key = decision_env_key(ORIGIN, dt_runpath, dt_rpath, have_note ? note_path : "");
+  }
+  pending_use_decision_env = use_decision_env;
+
+  // The note stamped at link time describes our libstdc++, which then only has to be found, not opened and parsed.
+  // Only without a current note do we look in DT_RUNPATH then DT_RPATH for libstdc++, and parse it
+  int fd_libstdcxx = -1;
+  if (use_decision_env && (ec_success == decision_env_inherit(pending_decision_key, shipped_path_storage, sizeof(shipped_path_storage),
+                                                              &shipped_glibcxx_version, &pending_st_shipped))) {
+    TRACE("libstdc++ %s (%x) from %s\n", shipped_path_storage, shipped_glibcxx_version, DECISION_ENV);
+    shipped_libstdcxx_path = shipped_path_storage;
+    pending_have_shipped_identity = 1;
+  } else if (ec_success == find_libstdcxx_from_note(phdr, phnum, dt_runpath, dt_rpath, ORIGIN, shipped_path_storage, sizeof(shipped_path_storage),
+                                                    &shipped_glibcxx_version, &pending_st_shipped)) {
+    shipped_libstdcxx_path = shipped_path_storage;
+    pending_have_shipped_identity = 1;
+  } else {
+    if (ec_success != executable_paths_error) {
+      ERROR("Audit library: Cannot find our libstdc++. runtime link errors may occur\n");
+      return;
+    }
+
+    error_code_t found = ec_fatal_error;
+    char* found_path = NULL;
+    size_t len_found_path_buffer = 0;
+    if (dt_runpath[0] != '\0') {
+      found = find_libstdcxx_in_dt_path(dt_runpath, ORIGIN, &trypath, (void*)&fd_libstdcxx, &found_path, &len_found_path_buffer);
+    }
+    if (ec_success != found) {
+      found = find_libstdcxx_in_dt_path(dt_rpath, ORIGIN, &trypath, (void*)&fd_libstdcxx, &found_path, &len_found_path_buffer);
+    }
+    if ((ec_success == found) && (strlen(found_path) >= sizeof(shipped_path_storage))) {
+      ERROR("Audit library: Path to our libstdc++ is too long: %s\n", found_path);
+      close(fd_libstdcxx);
+      found = ec_fatal_error;
+    }
+    if (ec_success != found) {
+      ERROR("Audit library: Cannot find our libstdc++. runtime link errors may occur\n");
+      path_arena_free(found_path, len_found_path_buffer);
+      return;
     }
 
-    dt_path_cursor = end_of_this_section + 1;
+    // Keep the path resident in static storage
+    memcpy(shipped_path_storage, found_path, strlen(found_path) + 1);
+    path_arena_free(found_path, len_found_path_buffer);
+    shipped_libstdcxx_path = shipped_path_storage;
   }
+  TRACE("Our shipped libstdc++ at %s\n", shipped_libstdcxx_path);
 
-  // Free
-  if (NULL != libstdcxx_path) {
-    munmap(libstdcxx_path, len_path_buffer);
+  // Resolve the system libstdc++ the way ld.so will, from ld.so.cache. Without ld.so.cache, the system candidates are
+  // only known when ld.so offers them to la_objsearch
+  if (ec_success == find_system_libstdcxx_from_cache(ld_so_cache_path, cached_system_path, sizeof(cached_system_path))) {
+    pending_cached_system_fd = open(cached_system_path, O_RDONLY | O_CLOEXEC);
   }
 
-  // Did not find a libstdc++ library in dt_path
-  return ec_fatal_error;
+  // Start the reads of the shipped and the ld.so.cache libstdc++, without waiting for them
+  int fds_readahead[LIBSTDCXX_READAHEAD_MAX];
+  size_t count_readahead = 0;
+  if (fd_libstdcxx >= 0) {
+    fds_readahead[count_readahead++] = fd_libstdcxx;
+  }
+  if (pending_cached_system_fd >= 0) {
+    fds_readahead[count_readahead++] = pending_cached_system_fd;
+  }
+  readahead_libstdcxx(fds_readahead, count_readahead);
+  pending_shipped_fd = fd_libstdcxx;
+  shipped_parse_pending = 1;
 }
 
-static uint32_t shipped_glibcxx_version = invalid_glibcxx_version;
-static char* shipped_libstdcxx_path = NULL;
-static size_t len_shipped_path_buffer = 0;
+/**
+ * Parse the version of the shipped libstdc++ found by find_shipped_libstdcxx, unless it is already known. Then plan the
+ * decision against the ld.so.cache libstdc++, whose descriptor is handed to the memo.
+ * On failure, shipped_libstdcxx_path is NULL and every search is left to ld.so
+ */
+STATIC void parse_shipped_libstdcxx(void) {
+  const int fd_libstdcxx = pending_shipped_fd;
+  const int fd_cached_system = pending_cached_system_fd;
+  pending_shipped_fd = -1;
+  pending_cached_system_fd = -1;
+  struct stat st_shipped = pending_st_shipped;
+  int have_shipped_identity = pending_have_shipped_identity;
+
+  error_code_t error_elf = ec_success;
+  if (fd_libstdcxx >= 0) {
+    // Record the identity of the shipped libstdc++ before the fd is consumed, so a system path that
+    // resolves to the very same file is recognized without a second parse
+    have_shipped_identity = (0 == fstat(fd_libstdcxx, &st_shipped));
+
+    // We found libstdc++, record its versions
+    error_elf = get_libstdcxx_version(fd_libstdcxx, shipped_libstdcxx_path, &shipped_glibcxx_version);
+    if (error_elf <= ec_fatal_error) {
+      if (shipped_libstdcxx_path) {
+        ERROR("Audit library: Could not determine shipped libstdc++ version from %s", shipped_libstdcxx_path);
+      } else {
+        ERROR("Audit library: Could not determine shipped libstdc++ version");
+      }
+    } else if (error_elf >= ec_non_fatal_error) {
+      ERROR("Audit library: Could not determine shipped libstdc++ version from %s", shipped_libstdcxx_path);
+      ERROR("An architecture (32b vs 64b) occured. An invalid libstdc++.so.6 exists in the DT_RUNPATH/DT_RPATH of this exectuable");
+    }
+  }
+  if (error_elf != ec_success) {
+    // Later code expects shipped_glibcxx_version to be modified from invalid_glibcxx_version
+    // Be explicit here
+    shipped_glibcxx_version = invalid_glibcxx_version;
+    shipped_libstdcxx_path = NULL;
+  } else if (have_shipped_identity) {
+    shipped_dev = st_shipped.st_dev;
+    shipped_ino = st_shipped.st_ino;
+    libstdcxx_memo_insert(shipped_dev, shipped_ino, shipped_glibcxx_version);
+    if (pending_use_decision_env) {
+      decision_env_publish(pending_decision_key, shipped_libstdcxx_path, shipped_glibcxx_version, &st_shipped);
+    }
+  }
+
+  // Plan the decision against the ld.so.cache libstdc++, with the same rule as la_objsearch
+  struct stat st_system;
+  uint32_t system_glibcxx_version = 0;
+  if ((fd_cached_system >= 0) && ((NULL == shipped_libstdcxx_path) || (0 != fstat(fd_cached_system, &st_system)))) {
+    close(fd_cached_system);
+  } else if ((fd_cached_system >= 0) &&
+             (ec_success == get_memoized_libstdcxx_version(cached_system_path, fd_cached_system, &st_system, &system_glibcxx_version))) {
+    if (system_glibcxx_version < shipped_glibcxx_version) {
+      planned_decision.path = shipped_libstdcxx_path;
+      planned_decision.glibcxx_version = shipped_glibcxx_version;
+      planned_decision.dev = shipped_dev;
+      planned_decision.ino = shipped_ino;
+    } else {
+      planned_decision.path = cached_system_path;
+      planned_decision.glibcxx_version = system_glibcxx_version;
+      planned_decision.dev = st_system.st_dev;
+      planned_decision.ino = st_system.st_ino;
+    }
+    TRACE("Planned libstdc++ %s (%x)\n", planned_decision.path, planned_decision.glibcxx_version);
+  }
+
+  TRACE("Our version is %x?\n", shipped_glibcxx_version);
+}
 
 /**
  * la_version is called exactly once by ld.so before any other action by the loader
@@ -276,101 +564,72 @@ AUDIT_LIBSTDCXX_EXPORT unsigned int la_version(unsigned int version) {
   ASSERT(len_libstdcxx_rel_path == strlen(libstdcxx_rel_path), "String / length constant mismatch");
 
   // Return the ORIGIN (path of the executable)
-  char* ORIGIN = (char*)getauxval(AT_EXECFN);
-  TRACE("aux origin %s\n", ORIGIN);
-
-  // Copy the ORIGIN path in order to strip the executable filename and leave the base path
-  size_t len_ORIGIN = strlen(ORIGIN);
-  char* origin_local = (char*)mmap(NULL, len_ORIGIN, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
-  if (origin_local == MAP_FAILED) {
-    ERROR("Audit library: Failed to allocate memory for libstdc++ path. runtime link errors may occur\n");
+  const char* const execfn = (const char*)getauxval(AT_EXECFN);
+  TRACE("aux origin %s\n", execfn);
+  if (NULL == execfn) {
+    ERROR("Audit library: Path of the executable is unknown. runtime link errors may occur\n");
     return LAV_CURRENT;
   }
-  memcpy(origin_local, ORIGIN, len_ORIGIN);
-
-  // Strip the filename to get the basepath of the executable
-  ORIGIN = dirname(origin_local);
-
-  TRACE("Audit library: ORIGIN at %s\n", ORIGIN);
 
-  // From the aux vectors, we can get the program header, which links to the dynamic section, which has DT_RUNPATH and DT_PATH (if they exist)
-  const char no_path = '\0';
-  const char* dt_runpath = &no_path;
-  const char* dt_rpath = &no_path;
-
-  // Retrieve program headers and their count from auxiliary vectors
-  ElfW(Phdr)* phdr = (ElfW(Phdr)*)getauxval(AT_PHDR);
-  size_t phnum = getauxval(AT_PHNUM);
-  const error_code_t error_paths = get_parent_executable_runpath_rpath(phdr, phnum, &dt_runpath, &dt_rpath);
-  if (ec_success != error_paths) {
-    ERROR("Audit library: Cannot find our libstdc++. runtime link errors may occur\n");
+  // Copy the ORIGIN path in order to strip the executable filename and leave the base path
+  const size_t len_execfn = strlen(execfn);
+  if (len_execfn >= sizeof(executable_origin_storage)) {
+    ERROR("Audit library: Path of the executable is too long. runtime link errors may occur\n");
     return LAV_CURRENT;
   }
-  TRACE("DT_RUNPATH %s\n", dt_runpath);
-  TRACE("DT_RPATH %s\n", dt_rpath);
+  memcpy(executable_origin_storage, execfn, len_execfn + 1);
 
-  // Look in DT_RUNPATH then DT_RPATH for libstdc++ and record its path
-  error_code_t found = ec_fatal_error;
-  int fd_libstdcxx = -1;
-  if (dt_runpath[0] != '\0') {
-    found = find_libstdcxx_from_dt_path(dt_runpath, ORIGIN, &trypath, (void*)&fd_libstdcxx, &shipped_libstdcxx_path, &len_shipped_path_buffer);
-  }
-  if (ec_success != found) {
-    found = find_libstdcxx_from_dt_path(dt_rpath, ORIGIN, &trypath, (void*)&fd_libstdcxx, &shipped_libstdcxx_path, &len_shipped_path_buffer);
-  }
-  if (ec_success != found) {
-    ERROR("Audit library: Cannot find our libstdc++. runtime link errors may occur\n");
-    if (NULL != shipped_libstdcxx_path) {
-      munmap(shipped_libstdcxx_path, len_shipped_path_buffer);
+  // Strip the filename to get the basepath of the executable
+  const char* const ORIGIN = dirname(executable_origin_storage);
+  executable_ORIGIN = ORIGIN;
+
+  // Record the searches of this process if asked to, never for a setuid executable
+  const char* const record_directory = getenv(OBJSEARCH_RECORD_ENV);
+  if ((NULL != record_directory) && (record_directory[0] != '\0') && !getauxval(AT_SECURE)) {
+    char executable_path[PATH_MAX];
+    const ssize_t len_executable_path = readlink("/proc/self/exe", executable_path, sizeof(executable_path) - 1);
+    if (len_executable_path > 0) {
+      executable_path[len_executable_path] = '\0';
+      objsearch_record_open(record_directory, executable_path, ORIGIN);
     }
-    munmap(ORIGIN, len_ORIGIN);
-    return LAV_CURRENT;
   }
 
-  if (shipped_libstdcxx_path) {
-    TRACE("Our shipped libstdc++ at %s\n", shipped_libstdcxx_path);
-  }
+  TRACE("Audit library: ORIGIN at %s\n", ORIGIN);
 
-  // We found libstdc++, record its versions
-  const error_code_t error_elf = get_libstdcxx_version(fd_libstdcxx, shipped_libstdcxx_path, &shipped_glibcxx_version);
-  if (error_elf <= ec_fatal_error) {
-    if (shipped_libstdcxx_path) {
-      ERROR("Audit library: Could not determine shipped libstdc++ version from %s", shipped_libstdcxx_path);
-    } else {
-      ERROR("Audit library: Could not determine shipped libstdc++ version");
+  // A forced libstdc++ makes the search for the shipped one and the policy moot
+  const char* const forced = getenv(FORCE_ENV);
+  if ((NULL != forced) && (forced[0] != '\0') && !getauxval(AT_SECURE)) {
+    if (ec_success == force_libstdcxx(forced)) {
+      return LAV_CURRENT;
     }
-  } else if (error_elf >= ec_non_fatal_error) {
-    ERROR("Audit library: Could not determine shipped libstdc++ version from %s", shipped_libstdcxx_path);
-    ERROR("An architecture (32b vs 64b) occured. An invalid libstdc++.so.6 exists in the DT_RUNPATH/DT_RPATH of this exectuable");
+    ERROR("Audit library: %s=%s is not a libstdc++ of this architecture, ignored\n", FORCE_ENV, forced);
   }
-  if (error_elf != ec_success) {
-    // Later code expects shipped_glibcxx_version to be modified from invalid_glibcxx_version
-    // Be explicit here
-    shipped_glibcxx_version = invalid_glibcxx_version;
-    if (NULL != shipped_libstdcxx_path) {
-      munmap(shipped_libstdcxx_path, len_shipped_path_buffer);
-    }
-    shipped_libstdcxx_path = NULL;
-  }
-  munmap(ORIGIN, len_ORIGIN);
-
-  TRACE("Our version is %x?\n", shipped_glibcxx_version);
 
+  // From the aux vectors, we can get the program header, which links to the dynamic section, which has DT_RUNPATH and DT_PATH (if they exist)
+  // Retrieve program headers and their count from auxiliary vectors
+  executable_phdr = (const ElfW(Phdr)*)getauxval(AT_PHDR);
+  executable_phnum = getauxval(AT_PHNUM);
+  executable_paths_error = get_parent_executable_runpath_rpath(executable_phdr, executable_phnum, &executable_dt_runpath, &executable_dt_rpath);
+  TRACE("DT_RUNPATH %s\n", executable_dt_runpath);
+  TRACE("DT_RPATH %s\n", executable_dt_rpath);
+
+  const char* const lazy = getenv(LAZY_ENV);
+  if ((NULL != lazy) && (lazy[0] != '\0')) {
+    TRACE("Lazy search of the shipped libstdc++\n");
+    shipped_search_pending = 1;
+    return LAV_CURRENT;
+  }
+  find_shipped_libstdcxx();
   return LAV_CURRENT;
 }
 
 /**
- * la_objsearch is called by the loader as it attempts to resolve the library.
+ * Answer of la_objsearch: the path for ld.so to try, or NULL to skip this candidate.
  * The flag denotes what type of path prefix is used
  * If the library being searched for is libstdc++, we examine its version and allow it
  * to be loaded ONLY if the glibcxx version is greater or equal than the shipped version
  */
-AUDIT_LIBSTDCXX_EXPORT char* la_objsearch(const char* name, uintptr_t* cookie, unsigned int flag) {
-  // cookie argument is not used.
-  (void)cookie;
-  // flag argument is not used.
-  (void)flag;
-
+STATIC char* search_libstdcxx(const char* name, uintptr_t* cookie, unsigned int flag) {
   TRACE("la_objsearch(): name = %s; cookie = %p\n", name, cookie);
   TRACE("; flag = %s\n", (flag == LA_SER_ORIG)      ? "LA_SER_ORIG"
                          : (flag == LA_SER_LIBPATH) ? "LA_SER_LIBPATH"
@@ -380,13 +639,6 @@ AUDIT_LIBSTDCXX_EXPORT char* la_objsearch(const char* name, uintptr_t* cookie, u
                          : (flag == LA_SER_SECURE)  ? "LA_SER_SECURE"
                                                     : "???");
 
-  // This condition means the initial check to find the shipped libstdc++ versions failed.
-  // early 'exit' by releasing the path back to ld.so
-  if ((shipped_glibcxx_version == invalid_glibcxx_version) || (shipped_libstdcxx_path == NULL)) {
-    TRACE("Earlier error, exit early\n");
-    return (char*)name;
-  }
-
   size_t len = strlen(name);
 
   // Compare the suffix of the path to see if this search is for libstdc++
@@ -396,16 +648,59 @@ AUDIT_LIBSTDCXX_EXPORT char* la_objsearch(const char* name, uintptr_t* cookie, u
   }
   // At this point, we know we are searching for a libstdc++
 
+  // In lazy mode, this is the first search for libstdc++: find the shipped one now. Either way, the candidates found are
+  // parsed on this first search, while la_version only started their reads
+  if (shipped_search_pending) {
+    shipped_search_pending = 0;
+    find_shipped_libstdcxx();
+  }
+  if (shipped_parse_pending) {
+    shipped_parse_pending = 0;
+    parse_shipped_libstdcxx();
+  }
+
+  // This condition means the initial check to find the shipped libstdc++ versions failed, and no libstdc++ was forced.
+  // early 'exit' by releasing the path back to ld.so
+  if ((NULL == libstdcxx_decision.path) && ((shipped_glibcxx_version == invalid_glibcxx_version) || (shipped_libstdcxx_path == NULL))) {
+    TRACE("Earlier error, exit early\n");
+    return (char*)name;
+  }
+
+  // A libstdc++ has already been chosen. Answer with the same decision, without touching the file system
+  if (NULL != libstdcxx_decision.path) {
+    TRACE("Decision already made: %s\n", libstdcxx_decision.path);
+    return (char*)libstdcxx_decision.path;
+  }
+
+#if AUDIT_LIBSTDCXX_FREESTANDING
+  // ld.so names the object after the candidate it redirects, and the first candidates of a DT_RUNPATH/DT_RPATH entry are its
+  // hwcaps subdirectories, which usually do not exist. They are only elided when ld.so already searched them, as it does when
+  // it loads the libc of a libc linked audit library. Without that libc they are not, so skip them, and the object is named
+  // after a real directory. The libc linked build never sees them and does not pay the stat
+  if ((flag == LA_SER_RUNPATH) && !candidate_directory_exists(name)) {
+    return (char*)NULL;
+  }
+#endif
+
+  // Apply the decision planned from ld.so.cache.
+  // LD_LIBRARY_PATH entries precede ld.so.cache and are still evaluated one by one below. So are those of the DT_RPATH that
+  // ld.so searches before them, for a requester without DT_RUNPATH
+  const int requester_has_runpath = (NULL != cookie) && (0 != (*cookie & OBJECT_COOKIE_RUNPATH));
+  if ((NULL != planned_decision.path) && (flag != LA_SER_LIBPATH) && ((flag != LA_SER_RUNPATH) || requester_has_runpath)) {
+    TRACE("Redirect to planned libstdc++ %s\n", planned_decision.path);
+    shipped_glibcxx_version = planned_decision.glibcxx_version;
+    return latch_libstdcxx_decision(planned_decision.path, planned_decision.glibcxx_version, planned_decision.dev, planned_decision.ino);
+  }
+
   // We only examine NON runpath as the 'system' versions. We already parsed RUNPATH/RPATH for libstdc++
   if (flag == LA_SER_RUNPATH) {
     return (char*)NULL;
   }
 
   // Check if the file exists
-  int fd_system_libstdcxx = open(name, O_RDONLY);
-
-  // The library does not exist at this path (or we encountered another error), release it
-  if (fd_system_libstdcxx < 0) {
+  struct stat st_system;
+  if (0 != fstatat(AT_FDCWD, name, &st_system, 0)) {
+    // The library does not exist at this path (or we encountered another error), release it
     return (char*)name;
   }
 
@@ -419,11 +714,20 @@ AUDIT_LIBSTDCXX_EXPORT char* la_objsearch(const char* name, uintptr_t* cookie, u
 
   // Once we have found a valid libstdc++.so.6, we compare the shipped vs system version
   // We load whichever is higher version.
-  // This search path exists, extract the version of this system libstdc++ library
+  // This search path exists, extract the version of this system libstdc++ library unless it was already parsed
+  // A library that exists but cannot be opened is released to ld.so, and decides nothing
+  int fd_system = -1;
+  if (NULL == libstdcxx_memo_find(st_system.st_dev, st_system.st_ino)) {
+    fd_system = open(name, O_RDONLY | O_CLOEXEC);
+    if (fd_system < 0) {
+      return (char*)name;
+    }
+  }
   uint32_t system_glibcxx_version = 0;
-  const error_code_t error = get_libstdcxx_version(fd_system_libstdcxx, name, &system_glibcxx_version);
+  const error_code_t error = get_memoized_libstdcxx_version(name, fd_system, &st_system, &system_glibcxx_version);
   if (error <= ec_fatal_error) {
     ERROR("Audit library: Error reading system libstdc++ version");
+    system_glibcxx_version = 0;
   } else if (error >= ec_non_fatal_error) {
     // This is not a fatal error, but we should not load this library
     return (char*)NULL;
@@ -435,47 +739,109 @@ AUDIT_LIBSTDCXX_EXPORT char* la_objsearch(const char* name, uintptr_t* cookie, u
   if (system_glibcxx_version < shipped_glibcxx_version) {
     TRACE("System glibcxx %x is less than shipped %x. Skipping\n", system_glibcxx_version, shipped_glibcxx_version);
 
-    return shipped_libstdcxx_path;
+    return latch_libstdcxx_decision(shipped_libstdcxx_path, shipped_glibcxx_version, shipped_dev, shipped_ino);
   }
 
   // This system version is greater than the shipped version. We overwrite the global version variables and allow the
   // ld.so to choose the system library we're currently evaluating.
   shipped_glibcxx_version = system_glibcxx_version;
+  if (len < sizeof(decided_system_path)) {
+    memcpy(decided_system_path, name, len + 1);
+    latch_libstdcxx_decision(decided_system_path, system_glibcxx_version, st_system.st_dev, st_system.st_ino);
+  }
   return (char*)name;
 }
 
 /**
- * Free our path buffer once the library loading has completed.
- * LA_ACT_CONSISTENT happens after all paths have been searched and all libraries loaded
+ * la_objsearch is called by the loader as it attempts to resolve the library.
+ * The answer comes from search_libstdcxx, and is recorded when AUDIT_LIBSTDCXX_RECORD is set
+ */
+AUDIT_LIBSTDCXX_EXPORT char* la_objsearch(const char* name, uintptr_t* cookie, unsigned int flag) {
+  char* const result = search_libstdcxx(name, cookie, flag);
+  if (objsearch_record_enabled()) {
+    objsearch_record_search(*cookie >> OBJECT_COOKIE_ID_SHIFT, name, flag, result);
+  }
+  return result;
+}
+
+/**
+ * Whether the object of the dynamic section `dynamic` has a DT_RUNPATH, which makes ld.so search it after LD_LIBRARY_PATH
+ * and ignore its DT_RPATH
+ */
+STATIC int dynamic_has_runpath(const ElfW(Dyn) * const dynamic) {
+  for (const ElfW(Dyn)* dyn = dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    if (dyn->d_tag == DT_RUNPATH) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * la_objopen is called by the loader when an object is loaded. Its cookie tells the searches it requests whether it has a
+ * DT_RUNPATH. When recording, it also closes the pending probe and records the object with its DT_RUNPATH/DT_RPATH, and the
+ * cookie carries the id its searches are recorded with
+ * @return 0, no symbol binding is audited
+ */
+AUDIT_LIBSTDCXX_EXPORT unsigned int la_objopen(struct link_map* map, Lmid_t lmid, uintptr_t* cookie) {
+  (void)lmid;
+  *cookie = ((NULL != map->l_ld) && dynamic_has_runpath(map->l_ld)) ? OBJECT_COOKIE_RUNPATH : 0;
+  if (!objsearch_record_enabled()) {
+    return 0;
+  }
+
+  objsearch_record_settle(map->l_name);
+
+  // The executable has no name in its link map. ld.so takes its ORIGIN from /proc/self/exe
+  char path[PATH_MAX];
+  const char* object_path = map->l_name;
+  if (object_path[0] == '\0') {
+    const ssize_t len_path = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    path[(len_path > 0) ? len_path : 0] = '\0';
+    object_path = path;
+  }
+  char ORIGIN[PATH_MAX];
+  const char* const slash = strrchr(object_path, '/');
+  const size_t len_ORIGIN = (NULL != slash) ? size_t_min((size_t)(slash - object_path), sizeof(ORIGIN) - 1) : 0;
+  memcpy(ORIGIN, object_path, len_ORIGIN);
+  ORIGIN[len_ORIGIN] = '\0';
+
+  const char no_path = '\0';
+  const char* dt_runpath = &no_path;
+  const char* dt_rpath = &no_path;
+  if (NULL != map->l_ld) {
+    get_dynamic_runpath_rpath(map->l_ld, map->l_addr, &dt_runpath, &dt_rpath);
+  }
+  *cookie |= (uintptr_t)objsearch_record_object(ORIGIN, dt_runpath, dt_rpath, object_path) << OBJECT_COOKIE_ID_SHIFT;
+  return 0;
+}
+
+/**
+ * la_activity is called by the loader when link maps are added or removed.
+ * The resolution state is static and is deliberately kept after LA_ACT_CONSISTENT, for later dlopen of libstdc++ users
  */
 AUDIT_LIBSTDCXX_EXPORT void la_activity(uintptr_t* cookie, unsigned int flag) {
   // Unused arguments
   (void)cookie;
   (void)flag;
-  if ((LA_ACT_CONSISTENT == flag) && (NULL != shipped_libstdcxx_path)) {
-    munmap(shipped_libstdcxx_path, len_shipped_path_buffer);
-    shipped_libstdcxx_path = NULL;
-  }
   TRACE("la_activity(): cookie = %p; flag = %s\n", cookie,
         (flag == LA_ACT_CONSISTENT) ? "LA_ACT_CONSISTENT"
         : (flag == LA_ACT_ADD)      ? "LA_ACT_ADD"
         : (flag == LA_ACT_DELETE)   ? "LA_ACT_DELETE"
                                     : "???");
+  // The first time, startup is over and libc is about to run with the environment: it is no longer ours to write
+  if (flag == LA_ACT_CONSISTENT) {
+    decision_env_release();
+  }
+  // The link maps are consistent again: any pending probe failed, and the recording is written out and closed
+  if ((flag == LA_ACT_CONSISTENT) && objsearch_record_enabled()) {
+    objsearch_record_settle(NULL);
+    objsearch_record_close();
+  }
 }
 
 // Unused audit library functions. Left here as a reference for the future.
 #if 0
-AUDIT_LIBSTDCXX_EXPORT unsigned int la_objopen(struct link_map *map, Lmid_t lmid, uintptr_t *cookie) {
-  printf("la_objopen(): loading \"%s\"; lmid = %s; cookie=%p\n",
-          map->l_name,
-          (lmid == LM_ID_BASE) ?  "LM_ID_BASE" :
-          (lmid == LM_ID_NEWLM) ? "LM_ID_NEWLM" :
-          "???",
-          cookie);
-
-  return LA_FLG_BINDTO | LA_FLG_BINDFROM;
-}
-
 AUDIT_LIBSTDCXX_EXPORT unsigned intla_objclose (uintptr_t *cookie) {
   printf("la_objclose(): %p\n", cookie);
 
@@ -0,0 +1,243 @@
+#ifndef _DECISION_ENV_H_
+#define _DECISION_ENV_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "macros.h"
+#include "error_types.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+/**
+ * Hand the shipped libstdc++ found by the audit library down to the processes the executable starts.
+ * Enabled by the presence of AUDIT_LIBSTDCXX_DECISION in the environment, an empty value is enough:
+ *   AUDIT_LIBSTDCXX_DECISION=1:<key>:<glibcxx version>:<dev>:<ino>:<size>:<mtime s>:<mtime ns>:<path>
+ * all numbers in hexadecimal. The key hashes what the search of the shipped libstdc++ depends on: ORIGIN, DT_RUNPATH,
+ * DT_RPATH and the path of the .note.audit_libstdcxx note. A child with the same key only has to stat the path, and uses it
+ * if it is still the same file (device, inode, size and modification time). Otherwise it searches and parses as usual.
+ * ld.so gives the audit library no way to add to the environment of the executable, whose libc is not running yet. So the
+ * entry of the variable in the initial environment array is pointed at static storage of the audit library, which libc
+ * then adopts, and children inherit
+ */
+#define DECISION_ENV "AUDIT_LIBSTDCXX_DECISION"
+#define DECISION_ENV_FORMAT '1'
+
+typedef struct {
+  uint64_t key;
+  uint32_t glibcxx_version;
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  uint64_t mtime_sec;
+  uint64_t mtime_nsec;
+  // Points into the parsed value
+  const char* path;
+} decision_env_t;
+
+// The definitions are C. test.cpp includes the header for the types only
+#ifndef __cplusplus
+
+// Entry of the initial environment array holding DECISION_ENV, or NULL if the variable is not set
+static char** decision_env_slot = NULL;
+static char decision_env_storage[sizeof(DECISION_ENV) + 2 + (8 * 17) + PATH_MAX];
+
+/**
+ * Find DECISION_ENV in the initial environment array `envp`
+ */
+STATIC void decision_env_capture(char** const envp) {
+  decision_env_slot = NULL;
+  if (NULL == envp) {
+    return;
+  }
+  for (char** entry = envp; NULL != *entry; entry++) {
+    if ((0 == strncmp(*entry, DECISION_ENV, sizeof(DECISION_ENV) - 1)) && ((*entry)[sizeof(DECISION_ENV) - 1] == '=')) {
+      decision_env_slot = entry;
+      return;
+    }
+  }
+}
+
+STATIC uint64_t decision_env_hash(uint64_t hash, const char* const str) {
+  // FNV-1a over the string and its terminator
+  const char* c = str;
+  do {
+    hash = (hash ^ (uint8_t)*c) * 0x100000001b3ull;
+  } while (*c++ != '\0');
+  return hash;
+}
+
+/**
+ * Key of the search of the shipped libstdc++
+ */
+STATIC uint64_t decision_env_key(const char* const ORIGIN, const char* const dt_runpath, const char* const dt_rpath, const char* const note_path) {
+  ASSERT(ORIGIN && dt_runpath && dt_rpath && note_path, "Unexpected NULL arguments\n");
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hash = decision_env_hash(hash, ORIGIN);
+  hash = decision_env_hash(hash, dt_runpath);
+  hash = decision_env_hash(hash, dt_rpath);
+  return decision_env_hash(hash, note_path);
+}
+
+STATIC char* decision_env_append_hex(char* out, const uint64_t number) {
+  int shift = 60;
+  while ((shift > 0) && (0 == ((number >> shift) & 0xF))) {
+    shift -= 4;
+  }
+  for (; shift >= 0; shift -= 4) {
+    *out++ = "0123456789abcdef"[(number >> shift) & 0xF];
+  }
+  *out++ = ':';
+  return out;
+}
+
+STATIC const char* decision_env_parse_hex(const char* in, uint64_t* const number) {
+  uint64_t value = 0;
+  const char* const start = in;
+  for (; *in != ':'; in++) {
+    const char c = *in;
+    const int digit = ((c >= '0') && (c <= '9')) ? (c - '0') : ((c >= 'a') && (c <= 'f')) ? (c - 'a' + 10) : -1;
+    if ((digit < 0) || ((in - start) >= 16)) {
+      return NULL;
+    }
+    value = (value << 4) | (uint64_t)digit;
+  }
+  if (in == start) {
+    return NULL;
+  }
+  *number = value;
+  return in + 1;
+}
+
+/**
+ * Parse the value of DECISION_ENV
+ * @return error_code_t ec_success if it is a decision, ec_non_fatal_error if it is empty or malformed
+ */
+STATIC error_code_t decision_env_parse(const char* const value, decision_env_t* const decision) {
+  ASSERT(value && decision, "Unexpected NULL arguments\n");
+  if ((value[0] != DECISION_ENV_FORMAT) || (value[1] != ':')) {
+    return ec_non_fatal_error;
+  }
+  uint64_t numbers[7];
+  const char* in = value + 2;
+  for (size_t i = 0; i < (sizeof(numbers) / sizeof(numbers[0])); i++) {
+    in = decision_env_parse_hex(in, &numbers[i]);
+    if (NULL == in) {
+      return ec_non_fatal_error;
+    }
+  }
+  if ((in[0] == '\0') || (numbers[1] > UINT32_MAX)) {
+    return ec_non_fatal_error;
+  }
+  decision->key = numbers[0];
+  decision->glibcxx_version = (uint32_t)numbers[1];
+  decision->dev = numbers[2];
+  decision->ino = numbers[3];
+  decision->size = numbers[4];
+  decision->mtime_sec = numbers[5];
+  decision->mtime_nsec = numbers[6];
+  decision->path = in;
+  return ec_success;
+}
+
+/**
+ * Write `NAME=value` of a decision into `out` of `len_out` bytes
+ * @return error_code_t ec_fatal_error if it does not fit
+ */
+STATIC error_code_t decision_env_format(char* const out, const size_t len_out, const decision_env_t* const decision) {
+  ASSERT(out && decision && decision->path, "Unexpected NULL arguments\n");
+  const size_t len_path = strlen(decision->path);
+  if ((sizeof(DECISION_ENV) + 2 + (7 * 17) + len_path + 1) > len_out) {
+    return ec_fatal_error;
+  }
+  char* end = out;
+  memcpy(end, DECISION_ENV "=", sizeof(DECISION_ENV));
+  end += sizeof(DECISION_ENV);
+  *end++ = DECISION_ENV_FORMAT;
+  *end++ = ':';
+  end = decision_env_append_hex(end, decision->key);
+  end = decision_env_append_hex(end, decision->glibcxx_version);
+  end = decision_env_append_hex(end, decision->dev);
+  end = decision_env_append_hex(end, decision->ino);
+  end = decision_env_append_hex(end, decision->size);
+  end = decision_env_append_hex(end, decision->mtime_sec);
+  end = decision_env_append_hex(end, decision->mtime_nsec);
+  memcpy(end, decision->path, len_path + 1);
+  return ec_success;
+}
+
+/**
+ * Take the shipped libstdc++ from the decision inherited in DECISION_ENV, if it was made for the same `key` and its
+ * file is unchanged. Costs one stat. On success the path is copied into `path` (of `len_path` bytes) and `st` holds its stat
+ * @return error_code_t ec_success if the inherited decision applies
+ */
+STATIC error_code_t decision_env_inherit(const uint64_t key, char* const path, const size_t len_path, uint32_t* const glibcxx_version, struct stat* const st) {
+  ASSERT(path && glibcxx_version && st, "Unexpected NULL arguments\n");
+  if (NULL == decision_env_slot) {
+    return ec_non_fatal_error;
+  }
+  decision_env_t decision;
+  if ((ec_success != decision_env_parse(*decision_env_slot + sizeof(DECISION_ENV), &decision)) || (decision.key != key)) {
+    return ec_non_fatal_error;
+  }
+  const size_t len_decision_path = strlen(decision.path);
+  if ((len_decision_path >= len_path) || (0 != stat(decision.path, st))) {
+    return ec_fatal_error;
+  }
+  if (((uint64_t)st->st_dev != decision.dev) || ((uint64_t)st->st_ino != decision.ino) || ((uint64_t)st->st_size != decision.size) ||
+      ((uint64_t)st->st_mtim.tv_sec != decision.mtime_sec) || ((uint64_t)st->st_mtim.tv_nsec != decision.mtime_nsec)) {
+    TRACE("Stale %s for %s\n", DECISION_ENV, decision.path);
+    return ec_fatal_error;
+  }
+  memcpy(path, decision.path, len_decision_path + 1);
+  *glibcxx_version = decision.glibcxx_version;
+  return ec_success;
+}
+
+/**
+ * Forget the entry of the initial environment array. Once libc runs, setenv and unsetenv move, replace and free its
+ * entries, so the slot no longer holds DECISION_ENV. A search after startup neither inherits nor publishes
+ */
+STATIC void decision_env_release(void) {
+  decision_env_slot = NULL;
+}
+
+/**
+ * Publish the shipped libstdc++ at `path`, whose stat is `st`, for the children of the process.
+ * Only before decision_env_release, while the libc of the executable has not touched the environment
+ */
+STATIC void decision_env_publish(const uint64_t key, const char* const path, const uint32_t glibcxx_version, const struct stat* const st) {
+  ASSERT(path && st, "Unexpected NULL arguments\n");
+  if (NULL == decision_env_slot) {
+    return;
+  }
+  const decision_env_t decision = {key,
+                                   glibcxx_version,
+                                   (uint64_t)st->st_dev,
+                                   (uint64_t)st->st_ino,
+                                   (uint64_t)st->st_size,
+                                   (uint64_t)st->st_mtim.tv_sec,
+                                   (uint64_t)st->st_mtim.tv_nsec,
+                                   path};
+  if (ec_success == decision_env_format(decision_env_storage, sizeof(decision_env_storage), &decision)) {
+    *decision_env_slot = decision_env_storage;
+  }
+}
+
+#endif
+
+#endif
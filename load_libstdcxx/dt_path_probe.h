@@ -0,0 +1,361 @@
+#ifndef _DT_PATH_PROBE_H_
+#define _DT_PATH_PROBE_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#include <linux/io_uring.h>
+#define DT_PATH_PROBE_HAVE_IO_URING 1
+#endif
+#endif
+#ifndef DT_PATH_PROBE_HAVE_IO_URING
+#define DT_PATH_PROBE_HAVE_IO_URING 0
+#endif
+
+#include "find_libstdcxx.h"
+#include "macros.h"
+#include "raw_syscall.h"
+#include "error_types.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+#ifndef AUDIT_LIBSTDCXX_CONCURRENT_PROBE
+#define AUDIT_LIBSTDCXX_CONCURRENT_PROBE 0
+#endif
+
+/**
+ * Concurrent probing of the candidates of a DT_RUNPATH or DT_RPATH.
+ * find_libstdcxx_from_dt_path tries one candidate at a time, which costs a round trip per missing entry on a network
+ * file system. Here every candidate is first stat'ed at once, with io_uring or with helper threads, then the ordered
+ * search runs as before but skips the candidates known to be missing. The first match in order still wins.
+ * No malloc: candidates, statx buffers and thread stacks are static.
+ * Only the audit library built with AUDIT_LIBSTDCXX_CONCURRENT_PROBE, and the tests, compile the definitions.
+ */
+#define DT_PATH_PROBE_MAX 16
+#define DT_PATH_PROBE_STORAGE (4 * PATH_MAX)
+#define DT_PATH_PROBE_STACK_SIZE (16 * 1024)
+
+typedef enum {
+  dt_path_probe_none     = 0,
+  dt_path_probe_io_uring = 1,
+  dt_path_probe_threads  = 2,
+  dt_path_probe_any      = 3
+} dt_path_probe_backend_t;
+
+typedef enum { probe_unknown = 0, probe_missing, probe_exists } dt_path_probe_state_t;
+
+typedef struct {
+  // Helper thread id, cleared by the kernel when the thread exits
+  pid_t tid;
+  size_t index;
+} dt_path_probe_task_t;
+
+typedef struct {
+  size_t count;
+  size_t len_storage;
+  size_t offsets[DT_PATH_PROBE_MAX];
+  int state[DT_PATH_PROBE_MAX];
+  // Delay before each probe, a stand-in for a high latency file system in the tests. NULL in the audit library
+  const uint64_t* latency_ns;
+  struct statx stx[DT_PATH_PROBE_MAX];
+  dt_path_probe_task_t tasks[DT_PATH_PROBE_MAX];
+  char storage[DT_PATH_PROBE_STORAGE];
+  // Ordered pass
+  size_t next;
+  error_code_t (*trypath_callback)(const char* const path, void* data);
+  void* callback_data;
+} dt_path_probe_t;
+
+// The definitions are C. test.cpp includes the header for the types only
+#if !defined(__cplusplus) && (AUDIT_LIBSTDCXX_CONCURRENT_PROBE || defined(GOOGLE_TEST))
+
+static dt_path_probe_t dt_path_probe;
+
+STATIC const char* dt_path_probe_path(const dt_path_probe_t* const probe, const size_t index) {
+  return probe->storage + probe->offsets[index];
+}
+
+/**
+ * Callback of find_libstdcxx_from_dt_path that records every candidate, in order, and always fails so all are visited.
+ * Candidates past DT_PATH_PROBE_MAX or past the storage are not recorded, and are tried serially later
+ * @return error_code_t
+ */
+STATIC error_code_t dt_path_probe_collect(const char* const path, void* data) {
+  dt_path_probe_t* const probe = (dt_path_probe_t*)data;
+  const size_t len = strlen(path) + 1;
+  if ((probe->count < DT_PATH_PROBE_MAX) && (len <= (DT_PATH_PROBE_STORAGE - probe->len_storage))) {
+    memcpy(probe->storage + probe->len_storage, path, len);
+    probe->offsets[probe->count] = probe->len_storage;
+    probe->state[probe->count] = probe_unknown;
+    probe->len_storage += len;
+    probe->count++;
+  }
+  return ec_fatal_error;
+}
+
+/**
+ * Callback of find_libstdcxx_from_dt_path for the ordered pass. Candidates probed as missing fail without a syscall,
+ * the others are handed to the real callback
+ * @return error_code_t
+ */
+STATIC error_code_t dt_path_probe_ordered(const char* const path, void* data) {
+  dt_path_probe_t* const probe = (dt_path_probe_t*)data;
+  const size_t index = probe->next++;
+  if ((index < probe->count) && (probe->state[index] == probe_missing) && (0 == strcmp(path, dt_path_probe_path(probe, index)))) {
+    TRACE("Skip missing %s\n", path);
+    return ec_fatal_error;
+  }
+  return probe->trypath_callback(path, probe->callback_data);
+}
+
+#if DT_PATH_PROBE_HAVE_IO_URING
+/**
+ * Stat every candidate with a single io_uring submission. An injected latency is a timeout hard linked before the statx
+ * @return error_code_t ec_success once every candidate has completed, ec_fatal_error if io_uring is not available
+ */
+STATIC error_code_t dt_path_probe_run_io_uring(dt_path_probe_t* const probe) {
+  struct __kernel_timespec delays[DT_PATH_PROBE_MAX];
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  const int ring_fd = (int)syscall(__NR_io_uring_setup, (unsigned)(2 * probe->count), &params);
+  if (ring_fd < 0) {
+    TRACE("io_uring not available\n");
+    return ec_fatal_error;
+  }
+
+  error_code_t error = ec_fatal_error;
+  const size_t len_sq_ring = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  const size_t len_cq_ring = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  const int single_mmap = (0 != (params.features & IORING_FEAT_SINGLE_MMAP));
+  const size_t len_sq_map = (single_mmap && (len_cq_ring > len_sq_ring)) ? len_cq_ring : len_sq_ring;
+  const size_t len_sqes = params.sq_entries * sizeof(struct io_uring_sqe);
+  char* const sq_ring = (char*)mmap(NULL, len_sq_map, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  char* cq_ring = single_mmap ? sq_ring : (char*)MAP_FAILED;
+  if (!single_mmap) {
+    cq_ring = (char*)mmap(NULL, len_cq_ring, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  }
+  struct io_uring_sqe* const sqes =
+    (struct io_uring_sqe*)mmap(NULL, len_sqes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+  if ((sq_ring != MAP_FAILED) && (cq_ring != MAP_FAILED) && (sqes != MAP_FAILED)) {
+    unsigned* const sq_tail = (unsigned*)(sq_ring + params.sq_off.tail);
+    unsigned* const sq_array = (unsigned*)(sq_ring + params.sq_off.array);
+    const unsigned sq_mask = *(unsigned*)(sq_ring + params.sq_off.ring_mask);
+    unsigned* const cq_head = (unsigned*)(cq_ring + params.cq_off.head);
+    const unsigned* const cq_tail = (const unsigned*)(cq_ring + params.cq_off.tail);
+    const unsigned cq_mask = *(unsigned*)(cq_ring + params.cq_off.ring_mask);
+    const struct io_uring_cqe* const cqes = (const struct io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+
+    // The ring is empty, so the sqe slots can be filled in order from the tail
+    unsigned tail = *sq_tail;
+    unsigned submitted = 0;
+    for (size_t i = 0; i < probe->count; i++) {
+      if ((NULL != probe->latency_ns) && (0 != probe->latency_ns[i])) {
+        delays[i].tv_sec = (int64_t)(probe->latency_ns[i] / 1000000000u);
+        delays[i].tv_nsec = (long long)(probe->latency_ns[i] % 1000000000u);
+        struct io_uring_sqe* const sqe = &sqes[tail & sq_mask];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->flags = IOSQE_IO_HARDLINK;
+        sqe->addr = (uint64_t)(uintptr_t)&delays[i];
+        sqe->len = 1;
+        sqe->user_data = UINT64_MAX;
+        sq_array[tail & sq_mask] = tail & sq_mask;
+        tail++;
+        submitted++;
+      }
+      struct io_uring_sqe* const sqe = &sqes[tail & sq_mask];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_STATX;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = (uint64_t)(uintptr_t)dt_path_probe_path(probe, i);
+      sqe->len = STATX_TYPE;
+      sqe->off = (uint64_t)(uintptr_t)&probe->stx[i];
+      sqe->user_data = i;
+      sq_array[tail & sq_mask] = tail & sq_mask;
+      tail++;
+      submitted++;
+    }
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+    // Wait for every completion. The statx buffers and the delays must outlive their requests
+    unsigned completed = 0;
+    long entered = syscall(__NR_io_uring_enter, ring_fd, submitted, submitted, IORING_ENTER_GETEVENTS, NULL, 0);
+    while ((entered >= 0) || (EINTR == errno)) {
+      unsigned head = *cq_head;
+      const unsigned cq_end = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != cq_end; head++) {
+        const struct io_uring_cqe* const cqe = &cqes[head & cq_mask];
+        if (cqe->user_data < probe->count) {
+          probe->state[cqe->user_data] = (cqe->res < 0) ? probe_missing : probe_exists;
+          // An unsupported opcode leaves the candidate to the serial pass
+          if ((-EINVAL == cqe->res) || (-EOPNOTSUPP == cqe->res)) {
+            probe->state[cqe->user_data] = probe_unknown;
+          }
+        }
+        completed++;
+      }
+      __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+      if (completed >= submitted) {
+        error = ec_success;
+        break;
+      }
+      entered = syscall(__NR_io_uring_enter, ring_fd, 0, submitted - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+    }
+  }
+
+  if (sqes != MAP_FAILED) {
+    munmap(sqes, len_sqes);
+  }
+  if (!single_mmap && (cq_ring != MAP_FAILED)) {
+    munmap(cq_ring, len_cq_ring);
+  }
+  if (sq_ring != MAP_FAILED) {
+    munmap(sq_ring, len_sq_map);
+  }
+  close(ring_fd);
+  return error;
+}
+#endif
+
+#if RAW_SYSCALL_AVAILABLE
+static char dt_path_probe_stacks[DT_PATH_PROBE_MAX][DT_PATH_PROBE_STACK_SIZE] __attribute__((aligned(16)));
+
+/**
+ * Body of a helper thread. It shares the thread pointer, and so errno, of its creator: it only makes raw syscalls,
+ * which never write errno, and calls nothing that could touch thread local storage
+ */
+static int dt_path_probe_thread(void* arg) {
+  const dt_path_probe_task_t* const task = (const dt_path_probe_task_t*)arg;
+  dt_path_probe_t* const probe = &dt_path_probe;
+  const size_t i = task->index;
+  if ((NULL != probe->latency_ns) && (0 != probe->latency_ns[i])) {
+    struct timespec delay;
+    delay.tv_sec = (time_t)(probe->latency_ns[i] / 1000000000u);
+    delay.tv_nsec = (long)(probe->latency_ns[i] % 1000000000u);
+    raw_syscall(SYS_clock_nanosleep, CLOCK_MONOTONIC, 0, &delay, NULL, 0, 0);
+  }
+  const long result = raw_syscall(SYS_statx, AT_FDCWD, probe->storage + probe->offsets[i], 0, STATX_TYPE, &probe->stx[i], 0);
+  __atomic_store_n(&probe->state[i], (result == 0) ? probe_exists : probe_missing, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * Stat every candidate from its own helper thread, created with a bare clone on a static stack.
+ * The threads are joined through the futex the kernel clears at their exit.
+ * Only the static dt_path_probe can be probed, as the helper threads refer to it directly
+ * @return error_code_t ec_success once every candidate has completed, ec_fatal_error if no thread could be created masked
+ */
+STATIC error_code_t dt_path_probe_run_threads(dt_path_probe_t* const probe) {
+  ASSERT(probe == &dt_path_probe, "Only the static probe can be run by helper threads\n");
+  const int flags = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM | CLONE_PARENT_SETTID |
+                    CLONE_CHILD_CLEARTID;
+  // A helper starts with the signal mask of its creator. Block every signal while they are created, so no handler of the
+  // process ever runs on a helper, with its thread pointer and small stack, then restore the mask of the caller
+  const uint64_t all_signals = ~(uint64_t)0;
+  uint64_t caller_mask = 0;
+  if (0 != raw_syscall(SYS_rt_sigprocmask, SIG_SETMASK, &all_signals, &caller_mask, sizeof(all_signals), 0, 0)) {
+    return ec_fatal_error;
+  }
+  size_t started = 0;
+  for (size_t i = 0; i < probe->count; i++) {
+    dt_path_probe_task_t* const task = &probe->tasks[i];
+    task->index = i;
+    task->tid = 0;
+    char* const stack_top = dt_path_probe_stacks[i] + DT_PATH_PROBE_STACK_SIZE;
+    if (clone(&dt_path_probe_thread, stack_top, flags, task, &task->tid, NULL, &task->tid) < 0) {
+      // The candidate stays unknown and is tried serially
+      task->tid = 0;
+      continue;
+    }
+    started++;
+  }
+  raw_syscall(SYS_rt_sigprocmask, SIG_SETMASK, &caller_mask, NULL, sizeof(caller_mask), 0, 0);
+  for (size_t i = 0; i < probe->count; i++) {
+    pid_t tid;
+    while (0 != (tid = __atomic_load_n(&probe->tasks[i].tid, __ATOMIC_ACQUIRE))) {
+      raw_syscall(SYS_futex, &probe->tasks[i].tid, FUTEX_WAIT, tid, NULL, NULL, 0);
+    }
+  }
+  return (started > 0) ? ec_success : ec_fatal_error;
+}
+#endif
+
+/**
+ * find_libstdcxx_from_dt_path, with every candidate probed concurrently first.
+ * `backend` selects the allowed mechanisms (io_uring is preferred) and returns the one used, dt_path_probe_none if the
+ * search was serial. `latency_ns`, if not NULL, delays the probe of each candidate (tests only).
+ * The result is the same as find_libstdcxx_from_dt_path: the first candidate in order accepted by the callback
+ * NOTE: on a success, the caller of this function owns the buffer at *p_path and must release it with path_arena_free
+ * @return error_code_t
+ */
+STATIC error_code_t find_libstdcxx_from_dt_path_concurrent(
+  const char* const dt_path,
+  const char* const ORIGIN,
+  error_code_t (*trypath_callback)(const char* const path, void* data),
+  void* callback_data,
+  char** p_path,
+  size_t* p_path_buffer_len,
+  dt_path_probe_backend_t* const backend,
+  const uint64_t* const latency_ns
+) {
+  ASSERT(p_path && p_path_buffer_len && backend, "Unexpected NULL arguments");
+  dt_path_probe_t* const probe = &dt_path_probe;
+  const dt_path_probe_backend_t allowed = *backend;
+  *backend = dt_path_probe_none;
+
+  probe->count = 0;
+  probe->len_storage = 0;
+  probe->latency_ns = latency_ns;
+  char* unused_path = NULL;
+  size_t len_unused_path = 0;
+  find_libstdcxx_from_dt_path(dt_path, ORIGIN, &dt_path_probe_collect, (void*)probe, &unused_path, &len_unused_path);
+
+  // A single candidate has nothing to overlap with
+  if (probe->count > 1) {
+#if DT_PATH_PROBE_HAVE_IO_URING
+    if ((allowed & dt_path_probe_io_uring) && (ec_success == dt_path_probe_run_io_uring(probe))) {
+      *backend = dt_path_probe_io_uring;
+    }
+#endif
+#if RAW_SYSCALL_AVAILABLE
+    if ((*backend == dt_path_probe_none) && (allowed & dt_path_probe_threads) && (ec_success == dt_path_probe_run_threads(probe))) {
+      *backend = dt_path_probe_threads;
+    }
+#endif
+  }
+  TRACE("Probed %lu candidates of %s with backend %d\n", (unsigned long)probe->count, dt_path, (int)*backend);
+
+  probe->next = 0;
+  probe->trypath_callback = trypath_callback;
+  probe->callback_data = callback_data;
+  return find_libstdcxx_from_dt_path(dt_path, ORIGIN, &dt_path_probe_ordered, (void*)probe, p_path, p_path_buffer_len);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,383 @@
+#ifndef _ELF_IMAGE_H_
+#define _ELF_IMAGE_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "error_types.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+// Helpers of a header that not every including file uses
+#ifndef STATIC_INLINE
+#ifndef GOOGLE_TEST
+#define STATIC_INLINE static inline
+#else
+#define STATIC_INLINE
+#endif
+#endif
+
+/**
+ * An ELF file of the native class mapped the way ld.so lays it out: every PT_LOAD segment at `base + p_vaddr`.
+ * The program headers, dynamic section and dynamic string table are then addressed exactly like in a loaded object,
+ * so the functions written for the parent executable of the audit library work on files too.
+ * A writable image is mapped MAP_SHARED and edits land in the file. Only edits in place are possible.
+ */
+typedef struct {
+  ElfW(Addr) base;
+  char* reservation;
+  size_t len_reservation;
+  // The whole file, for the section headers which are not part of any segment
+  const char* file;
+  size_t file_size;
+  const ElfW(Ehdr)* ehdr;
+  const ElfW(Phdr)* phdr;
+  size_t phnum;
+  // NULL for a static executable
+  ElfW(Dyn)* dynamic;
+  char* strtab;
+  size_t len_strtab;
+  int writable;
+} elf_image_t;
+
+#if __ELF_NATIVE_CLASS == 64
+#define ELF_IMAGE_NATIVE_CLASS ELFCLASS64
+#else
+#define ELF_IMAGE_NATIVE_CLASS ELFCLASS32
+#endif
+
+// The definitions are C. test.cpp includes the header for the types only
+#ifndef __cplusplus
+
+/**
+ * Translate an unrelocated address of the image
+ * @return pointer into the mapped segments
+ */
+STATIC_INLINE void* elf_image_ptr(const elf_image_t* const image, const ElfW(Addr) vaddr) {
+  return (void*)(image->base + vaddr);
+}
+
+/**
+ * @return 1 if the `len` bytes at `vaddr` are backed by the file in a PT_LOAD segment
+ */
+STATIC_INLINE int elf_image_contains(const elf_image_t* const image, const ElfW(Addr) vaddr, const size_t len) {
+  for (size_t i = 0; i < image->phnum; i++) {
+    const ElfW(Phdr)* const segment = &image->phdr[i];
+    if ((segment->p_type == PT_LOAD) && (vaddr >= segment->p_vaddr) && (len <= segment->p_filesz) &&
+        ((vaddr - segment->p_vaddr) <= (segment->p_filesz - len))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+STATIC_INLINE void elf_image_unmap(elf_image_t* const image) {
+  if (image->reservation) {
+    munmap(image->reservation, image->len_reservation);
+  }
+  if (image->file) {
+    munmap((void*)image->file, image->file_size);
+  }
+  memset(image, 0, sizeof(*image));
+}
+
+/**
+ * Map the ELF file at `path`. With `writable`, the file is opened read-write and mapped shared
+ * @return error_code_t ec_success, ec_non_fatal_error if the file is not an ELF of the native class, ec_fatal_error on I/O errors
+ */
+STATIC_INLINE error_code_t elf_image_map(const char* const path, const int writable, elf_image_t* const image) {
+  ASSERT(path && image, "Unexpected NULL arguments");
+  memset(image, 0, sizeof(*image));
+  image->writable = writable;
+
+  const int fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  if (fd < 0) {
+    return ec_fatal_error;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) < 0) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return ec_fatal_error;
+  }
+  if ((size_t)st.st_size < sizeof(ElfW(Ehdr))) {
+    close(fd);
+    return ec_non_fatal_error;
+  }
+  image->file_size = (size_t)st.st_size;
+  const char* const file = (const char*)mmap(NULL, image->file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (file == MAP_FAILED) {
+    close(fd);
+    return ec_fatal_error;
+  }
+  image->file = file;
+
+  const ElfW(Ehdr)* const ehdr = (const ElfW(Ehdr)*)file;
+  if ((0 != memcmp(ehdr->e_ident, ELFMAG, SELFMAG)) || (ehdr->e_ident[EI_CLASS] != ELF_IMAGE_NATIVE_CLASS) || (ehdr->e_phentsize != sizeof(ElfW(Phdr))) ||
+      (ehdr->e_phoff >= image->file_size) || (ehdr->e_phnum > ((image->file_size - ehdr->e_phoff) / sizeof(ElfW(Phdr))))) {
+    close(fd);
+    elf_image_unmap(image);
+    return ec_non_fatal_error;
+  }
+  image->ehdr = ehdr;
+  image->phdr = (const ElfW(Phdr)*)(file + ehdr->e_phoff);
+  image->phnum = ehdr->e_phnum;
+
+  // Reserve the address range of the PT_LOAD segments, then map each of them at its place
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  ElfW(Addr) min_vaddr = ~(ElfW(Addr))0;
+  ElfW(Addr) max_vaddr = 0;
+  for (size_t i = 0; i < image->phnum; i++) {
+    if (image->phdr[i].p_type == PT_LOAD) {
+      if (image->phdr[i].p_vaddr < min_vaddr) {
+        min_vaddr = image->phdr[i].p_vaddr;
+      }
+      if ((image->phdr[i].p_vaddr + image->phdr[i].p_memsz) > max_vaddr) {
+        max_vaddr = image->phdr[i].p_vaddr + image->phdr[i].p_memsz;
+      }
+    }
+  }
+  if (min_vaddr >= max_vaddr) {
+    close(fd);
+    elf_image_unmap(image);
+    return ec_non_fatal_error;
+  }
+  min_vaddr &= ~(ElfW(Addr))(page_size - 1);
+  image->len_reservation = (size_t)(max_vaddr - min_vaddr + page_size - 1) & ~(page_size - 1);
+  void* const reservation = mmap(NULL, image->len_reservation, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reservation == MAP_FAILED) {
+    image->len_reservation = 0;
+    close(fd);
+    elf_image_unmap(image);
+    return ec_fatal_error;
+  }
+  image->reservation = (char*)reservation;
+  image->base = (ElfW(Addr))reservation - min_vaddr;
+
+  error_code_t error = ec_success;
+  for (size_t i = 0; (i < image->phnum) && (ec_success == error); i++) {
+    const ElfW(Phdr)* const segment = &image->phdr[i];
+    if ((segment->p_type != PT_LOAD) || (segment->p_filesz == 0)) {
+      continue;
+    }
+    const size_t delta = (size_t)(segment->p_offset & (page_size - 1));
+    if (((segment->p_vaddr & (page_size - 1)) != delta) || (segment->p_offset > image->file_size) ||
+        (segment->p_filesz > (image->file_size - segment->p_offset))) {
+      error = ec_non_fatal_error;
+      break;
+    }
+    void* const mapped = mmap((void*)(image->base + segment->p_vaddr - delta), segment->p_filesz + delta,
+                              writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_FIXED | (writable ? MAP_SHARED : MAP_PRIVATE), fd,
+                              (off_t)(segment->p_offset - delta));
+    if (mapped == MAP_FAILED) {
+      error = ec_fatal_error;
+    }
+  }
+  close(fd);
+  if (ec_success != error) {
+    elf_image_unmap(image);
+    return error;
+  }
+
+  for (size_t i = 0; i < image->phnum; i++) {
+    const ElfW(Phdr)* const segment = &image->phdr[i];
+    if ((segment->p_type != PT_DYNAMIC) || !elf_image_contains(image, segment->p_vaddr, segment->p_filesz)) {
+      continue;
+    }
+    // The dynamic section must be terminated within the segment
+    ElfW(Dyn)* const dynamic = (ElfW(Dyn)*)elf_image_ptr(image, segment->p_vaddr);
+    for (size_t d = 0; d < (segment->p_filesz / sizeof(ElfW(Dyn))); d++) {
+      if (dynamic[d].d_tag == DT_NULL) {
+        image->dynamic = dynamic;
+        break;
+      }
+    }
+  }
+  if (image->dynamic) {
+    ElfW(Addr) strtab = 0;
+    for (ElfW(Dyn)* dyn = image->dynamic; dyn->d_tag != DT_NULL; dyn++) {
+      if (dyn->d_tag == DT_STRTAB) {
+        strtab = dyn->d_un.d_ptr;
+      } else if (dyn->d_tag == DT_STRSZ) {
+        image->len_strtab = dyn->d_un.d_val;
+      }
+    }
+    if ((image->len_strtab > 0) && elf_image_contains(image, strtab, image->len_strtab) &&
+        (((const char*)elf_image_ptr(image, strtab))[image->len_strtab - 1] == '\0')) {
+      image->strtab = (char*)elf_image_ptr(image, strtab);
+    } else {
+      image->dynamic = NULL;
+      image->len_strtab = 0;
+    }
+  }
+  return ec_success;
+}
+
+/**
+ * @return the first entry of the dynamic section with tag `tag`, or NULL
+ */
+STATIC_INLINE ElfW(Dyn) * elf_image_find_dynamic(const elf_image_t* const image, const ElfW(Sxword) tag) {
+  if (NULL == image->dynamic) {
+    return NULL;
+  }
+  for (ElfW(Dyn)* dyn = image->dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    if (dyn->d_tag == tag) {
+      return dyn;
+    }
+  }
+  return NULL;
+}
+
+STATIC_INLINE int elf_image_is_string_tag(const ElfW(Sxword) tag) {
+  return (tag == DT_NEEDED) || (tag == DT_SONAME) || (tag == DT_RPATH) || (tag == DT_RUNPATH) || (tag == DT_AUDIT) || (tag == DT_DEPAUDIT) ||
+         (tag == DT_AUXILIARY) || (tag == DT_FILTER) || (tag == DT_CONFIG);
+}
+
+STATIC_INLINE int string_offset_within(const ElfW(Word) offset, const size_t start, const size_t len) {
+  return (offset >= start) && (offset < (start + len));
+}
+
+/**
+ * Linkers merge the tails of identical strings in .dynstr. Before a string is rewritten in place, check that nothing
+ * but the dynamic entry `owner` refers to any of its bytes: dynamic entries, dynamic symbols and symbol versions.
+ * The dynamic symbols are counted from the section headers, so a file without them is never considered safe
+ * @return 1 if the string of `owner` is referred to by something else, or if that cannot be ruled out
+ */
+STATIC_INLINE int elf_image_string_is_shared(const elf_image_t* const image, const ElfW(Dyn)* const owner) {
+  ASSERT(image->dynamic && owner, "Unexpected NULL arguments");
+  const size_t start = owner->d_un.d_val;
+  if (start >= image->len_strtab) {
+    return 1;
+  }
+  const size_t len = strlen(image->strtab + start) + 1;
+
+  for (const ElfW(Dyn)* dyn = image->dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    if ((dyn != owner) && elf_image_is_string_tag(dyn->d_tag) && string_offset_within((ElfW(Word))dyn->d_un.d_val, start, len)) {
+      return 1;
+    }
+  }
+
+  const ElfW(Ehdr)* const ehdr = image->ehdr;
+  if ((ehdr->e_shnum == 0) || (ehdr->e_shentsize != sizeof(ElfW(Shdr))) || (ehdr->e_shoff >= image->file_size) ||
+      (ehdr->e_shnum > ((image->file_size - ehdr->e_shoff) / sizeof(ElfW(Shdr))))) {
+    return 1;
+  }
+  const ElfW(Shdr)* const shdr = (const ElfW(Shdr)*)(image->file + ehdr->e_shoff);
+  for (size_t i = 0; i < ehdr->e_shnum; i++) {
+    if ((shdr[i].sh_type != SHT_DYNSYM) || (shdr[i].sh_offset > image->file_size) || (shdr[i].sh_size > (image->file_size - shdr[i].sh_offset))) {
+      continue;
+    }
+    const ElfW(Sym)* const syms = (const ElfW(Sym)*)(image->file + shdr[i].sh_offset);
+    for (size_t s = 0; s < (shdr[i].sh_size / sizeof(ElfW(Sym))); s++) {
+      if (string_offset_within(syms[s].st_name, start, len)) {
+        return 1;
+      }
+    }
+  }
+
+  const ElfW(Dyn)* const verneed = elf_image_find_dynamic(image, DT_VERNEED);
+  const ElfW(Dyn)* const verneednum = elf_image_find_dynamic(image, DT_VERNEEDNUM);
+  if (verneed && verneednum) {
+    const char* entry = (const char*)elf_image_ptr(image, verneed->d_un.d_ptr);
+    for (size_t i = 0; i < verneednum->d_un.d_val; i++) {
+      if (!elf_image_contains(image, (ElfW(Addr))(entry - (const char*)image->base), sizeof(ElfW(Verneed)))) {
+        return 1;
+      }
+      const ElfW(Verneed)* const vn = (const ElfW(Verneed)*)entry;
+      if (string_offset_within(vn->vn_file, start, len)) {
+        return 1;
+      }
+      const char* aux = entry + vn->vn_aux;
+      for (size_t a = 0; a < vn->vn_cnt; a++) {
+        if (!elf_image_contains(image, (ElfW(Addr))(aux - (const char*)image->base), sizeof(ElfW(Vernaux)))) {
+          return 1;
+        }
+        const ElfW(Vernaux)* const vna = (const ElfW(Vernaux)*)aux;
+        if (string_offset_within(vna->vna_name, start, len)) {
+          return 1;
+        }
+        aux += vna->vna_next;
+      }
+      entry += vn->vn_next;
+    }
+  }
+
+  const ElfW(Dyn)* const verdef = elf_image_find_dynamic(image, DT_VERDEF);
+  const ElfW(Dyn)* const verdefnum = elf_image_find_dynamic(image, DT_VERDEFNUM);
+  if (verdef && verdefnum) {
+    const char* entry = (const char*)elf_image_ptr(image, verdef->d_un.d_ptr);
+    for (size_t i = 0; i < verdefnum->d_un.d_val; i++) {
+      if (!elf_image_contains(image, (ElfW(Addr))(entry - (const char*)image->base), sizeof(ElfW(Verdef)))) {
+        return 1;
+      }
+      const ElfW(Verdef)* const vd = (const ElfW(Verdef)*)entry;
+      const char* aux = entry + vd->vd_aux;
+      for (size_t a = 0; a < vd->vd_cnt; a++) {
+        if (!elf_image_contains(image, (ElfW(Addr))(aux - (const char*)image->base), sizeof(ElfW(Verdaux)))) {
+          return 1;
+        }
+        const ElfW(Verdaux)* const vda = (const ElfW(Verdaux)*)aux;
+        if (string_offset_within(vda->vda_name, start, len)) {
+          return 1;
+        }
+        aux += vda->vda_next;
+      }
+      entry += vd->vd_next;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Replace the string of the dynamic entry `owner` with the shorter `value`, padding with NUL.
+ * The image must be writable and the string must not be shared (see elf_image_string_is_shared)
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t elf_image_rewrite_string(const elf_image_t* const image, const ElfW(Dyn)* const owner, const char* const value) {
+  ASSERT(image->writable && owner && value, "Unexpected arguments");
+  char* const str = image->strtab + owner->d_un.d_val;
+  const size_t len = strlen(str);
+  const size_t len_value = strlen(value);
+  if (len_value > len) {
+    return ec_fatal_error;
+  }
+  memmove(str, value, len_value);
+  memset(str + len_value, '\0', len - len_value);
+  return ec_success;
+}
+
+/**
+ * Delete the dynamic entry `dyn` by moving the following entries down. The DT_NULL terminator moves with them
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t elf_image_remove_dynamic(const elf_image_t* const image, ElfW(Dyn)* const dyn) {
+  ASSERT(image->writable && dyn, "Unexpected arguments");
+  ElfW(Dyn)* last = dyn;
+  while (last->d_tag != DT_NULL) {
+    last++;
+  }
+  memmove(dyn, dyn + 1, (size_t)(last - dyn) * sizeof(ElfW(Dyn)));
+  return ec_success;
+}
+
+#endif
+
+#endif
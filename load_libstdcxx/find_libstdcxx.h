@@ -0,0 +1,472 @@
+#ifndef _FIND_LIBSTDCXX_H_
+#define _FIND_LIBSTDCXX_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "elf_image.h"
+#include "ld_so_cache.h"
+#include "macros.h"
+#include "error_types.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+// Helpers of a header that not every including file uses
+#ifndef STATIC_INLINE
+#ifndef GOOGLE_TEST
+#define STATIC_INLINE static inline
+#else
+#define STATIC_INLINE
+#endif
+#endif
+
+/**
+ * Search of libstdc++ the way ld.so does it: DT_RUNPATH/DT_RPATH of an ELF image with $ORIGIN substitution, and ld.so.cache.
+ * Shared by the audit library, on its loaded parent executable, and by relink_libstdcxx, on ELF files mapped with elf_image_map.
+ * Nothing here calls malloc.
+ */
+
+// The definitions are C. test.cpp includes the header for the types only
+#ifndef __cplusplus
+
+static const char libstdcxx_rel_path[] = "/libstdc++.so.6";
+static const char libstdcxx_soname[] = "libstdc++.so.6";
+static const char ld_so_cache_path[] = "/etc/ld.so.cache";
+static const size_t len_libstdcxx_rel_path = 15;
+STATIC_INLINE size_t size_t_min(size_t a, size_t b) {
+  return (a < b) ? a : b;
+}
+
+/**
+ * Bump allocator in static storage for building paths without malloc, and without a syscall and a page fault per buffer.
+ * Buffers are released in reverse order of allocation, which reclaims their space. Only pathological lengths fall back to mmap.
+ */
+#define PATH_ARENA_SIZE (4 * PATH_MAX)
+#define PATH_ARENA_ALIGN 8
+
+// A tool that searches from several threads defines it as `static __thread` to give each thread its own arena
+#ifndef PATH_ARENA_STORAGE
+#define PATH_ARENA_STORAGE static
+#endif
+
+PATH_ARENA_STORAGE char path_arena[PATH_ARENA_SIZE];
+PATH_ARENA_STORAGE size_t path_arena_used = 0;
+
+STATIC_INLINE size_t path_arena_aligned_size(const size_t size) {
+  return (size + PATH_ARENA_ALIGN - 1) & ~(size_t)(PATH_ARENA_ALIGN - 1);
+}
+
+/**
+ * @return a buffer of at least `size` bytes, or NULL if out of memory
+ */
+STATIC_INLINE void* path_arena_alloc(const size_t size) {
+  const size_t aligned_size = path_arena_aligned_size(size);
+  if (aligned_size <= (PATH_ARENA_SIZE - path_arena_used)) {
+    void* const ptr = path_arena + path_arena_used;
+    path_arena_used += aligned_size;
+    return ptr;
+  }
+  TRACE("Path arena exhausted, mmap %lu bytes\n", (unsigned long)size);
+  void* const ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+  return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+/**
+ * Release a buffer from path_arena_alloc. `size` must be the size it was allocated with
+ */
+STATIC_INLINE void path_arena_free(void* const ptr, const size_t size) {
+  if (NULL == ptr) {
+    return;
+  }
+  char* const p = (char*)ptr;
+  if ((p < path_arena) || (p >= (path_arena + PATH_ARENA_SIZE))) {
+    munmap(ptr, size);
+    return;
+  }
+  // Only the most recent allocation can be reclaimed. Others are reclaimed once everything above them is released
+  if ((p + path_arena_aligned_size(size)) == (path_arena + path_arena_used)) {
+    path_arena_used = (size_t)(p - path_arena);
+  }
+}
+
+/**
+ * Find the load address of the parent executable by finding PT_PHDR and working backwards
+ */
+STATIC_INLINE ElfW(Addr) get_parent_executable_base_address(const ElfW(Phdr) * const phdr, const size_t phnum) {
+  ElfW(Addr) base_address = 0;
+
+  for (size_t i = 0; i < phnum; i++) {
+    if (phdr[i].p_type == PT_PHDR) {
+      base_address = (ElfW(Addr))phdr - phdr[i].p_vaddr;
+      break;
+    }
+  }
+
+  TRACE("base_address %lu\n", (unsigned long)base_address);
+  return base_address;
+}
+
+/**
+ * Retrieve the dt_runpath or dt_rpath from the dynamic section of an ELF image whose segments are laid out from `base_address`.
+ * That is a loaded object, or a file mapped with elf_image_map.
+ * ld.so relocates the d_ptr entries of a writable dynamic section in place, a file image holds them unrelocated
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t get_dynamic_runpath_rpath(const ElfW(Dyn) * const dynamic, const ElfW(Addr) base_address, const char** const dt_runpath, const char** const dt_rpath) {
+  ASSERT(dynamic && dt_runpath && dt_rpath, "Unexpected NULL arguments\n");
+
+  error_code_t error = ec_fatal_error;
+  const char* strtab = NULL;
+
+  // Parse the dynamic section to find DT_RUNPATH and DT_RPATH
+  for (const ElfW(Dyn)* dyn = dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    if (dyn->d_tag == DT_STRTAB) {
+      const ElfW(Addr) strtab_address = dyn->d_un.d_ptr;
+      strtab = (const char*)((strtab_address < base_address) ? (base_address + strtab_address) : strtab_address);
+    }
+  }
+
+  ASSERT(strtab, "No strtab found in program header\n");
+
+  for (const ElfW(Dyn)* dyn = dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    if (dyn->d_tag == DT_RUNPATH) {
+      *dt_runpath = strtab + dyn->d_un.d_val;
+      error = ec_success;
+      TRACE("DT_RUNPATH: %s\n", strtab + dyn->d_un.d_val);
+    } else if (dyn->d_tag == DT_RPATH) {
+      *dt_rpath = strtab + dyn->d_un.d_val;
+      error = ec_success;
+      TRACE("DT_RPATH: %s\n", strtab + dyn->d_un.d_val);
+    }
+  }
+  return error;
+}
+
+/**
+ * Retrieve the dt_runpath or dt_rpath from the program headers of an object loaded, or mapped as a file image, at `base_address`
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t get_runpath_rpath(const ElfW(Phdr) * const phdr, const size_t phnum, const ElfW(Addr) base_address, const char** const dt_runpath, const char** const dt_rpath) {
+  ASSERT(dt_runpath && dt_rpath, "Unexpected NULL arguments\n");
+
+  // Iterate over program headers to locate PT_DYNAMIC
+  for (size_t i = 0; i < phnum; i++) {
+    if (phdr[i].p_type == PT_DYNAMIC) {
+      return get_dynamic_runpath_rpath((const ElfW(Dyn)*)(base_address + phdr[i].p_vaddr), base_address, dt_runpath, dt_rpath);
+    }
+  }
+  return ec_fatal_error;
+}
+
+/**
+ * Retrieve the dt_runpath or dt_rpath from the parent exectuable's Program Header
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t get_parent_executable_runpath_rpath(const ElfW(Phdr) * const phdr, const size_t phnum, const char** const dt_runpath, const char** const dt_rpath) {
+  ASSERT(dt_runpath && dt_rpath, "Unexpected NULL arguments\n");
+
+  ASSERT(phdr && phnum, "Failed to retrieve program headers from aux vectors\n");
+
+  return get_runpath_rpath(phdr, phnum, get_parent_executable_base_address(phdr, phnum), dt_runpath, dt_rpath);
+}
+
+/**
+ * This function checks whether a path exists and returns the _open_ fd in the void* data.
+ * The caller is responsible for closing the open fd.
+ * A callback is used to facilitate unit testing
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t trypath(const char* const path, void* data) {
+  ASSERT(NULL != data && NULL != path, "Unexpected NULL argument");
+  // Check if the path exists
+  TRACE("Trying path %s\n", path);
+  int fd = open(path, O_RDONLY);
+
+  // File does not exist
+  if (fd < 0) {
+    return ec_fatal_error;
+  }
+
+  // Store the fd in data pointer, to be used by the caller
+  *((int*)data) = fd;
+
+  return ec_success;
+}
+
+/**
+ * Length of the $ORIGIN or ${ORIGIN} that starts the DT_RUNPATH/DT_RPATH entry `entry` of `len_entry` bytes.
+ * Like ld.so, $ORIGIN followed by a character of a name, as in $ORIGINAL, is not substituted
+ * @return the length of the text to replace with ORIGIN, or 0 if the entry does not start with $ORIGIN
+ */
+STATIC_INLINE size_t dt_path_origin_length(const char* const entry, const size_t len_entry) {
+  if ((len_entry >= 9) && (0 == strncmp(entry, "${ORIGIN}", 9))) {
+    return 9;
+  }
+  if ((len_entry < 7) || (0 != strncmp(entry, "$ORIGIN", 7))) {
+    return 0;
+  }
+  const char next = (len_entry > 7) ? entry[7] : '\0';
+  const int is_name_character = ((next >= 'a') && (next <= 'z')) || ((next >= 'A') && (next <= 'Z')) || ((next >= '0') && (next <= '9')) || (next == '_');
+  return is_name_character ? 0 : 7;
+}
+
+/**
+ * From a DT_RUNPATH or DT_RPATH, find the first path that contains the file `name`
+ * DT_RUNPATH / DT_PATH are colon separated list of directories to search for dependencies
+ * ex:  "$ORIGIN:$ORIGIN../lib"
+ * Replace $ORIGIN and ${ORIGIN} as necessary, see dt_path_origin_length
+ * NOTE: on a success, the caller of this function owns the buffer at *p_path and must release it with path_arena_free
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t find_name_from_dt_path(
+  const char* const dt_path,
+  const char* const name,
+  const char* const ORIGIN,
+  error_code_t (*trypath_callback)(const char* const path, void* data),
+  void* callback_data,
+  char** p_path,
+  size_t* p_path_buffer_len
+) {
+  ASSERT(name && p_path && p_path_buffer_len, "Unexpected NULL arguments");
+
+  const size_t dt_path_len = strlen(dt_path);
+  const size_t len_ORIGIN = strlen(ORIGIN);
+  // "/name"
+  const size_t len_rel_path = 1 + strlen(name);
+
+  char* libstdcxx_path = NULL;
+  size_t len_path_buffer = 0;
+  *p_path = NULL;
+  *p_path_buffer_len = 0;
+
+  const char* dt_path_cursor = dt_path;
+
+  TRACE("dt_path %s\n", dt_path);
+  TRACE("dt_path_len %lu\n", (unsigned long)dt_path_len);
+
+  while (dt_path_cursor < (dt_path + dt_path_len)) {
+    const char* end_of_this_section = dt_path_cursor;
+    // Find the termination of this section. (Either the ':' or '\0')
+    // clang-format off
+    for(;
+      (end_of_this_section < (dt_path + dt_path_len)) &&
+      *end_of_this_section != ':' &&
+      *end_of_this_section != '\0'; end_of_this_section++) {
+
+    }
+    // clang-format on
+
+    size_t len_section = (size_t)(end_of_this_section - dt_path_cursor);
+    if (len_section == 0) {
+      dt_path_cursor++;
+      continue;
+    }
+
+    // Construct a path to libstdc++
+    TRACE("This section and on %s\n", dt_path_cursor);
+    TRACE("section len %lu\n", (unsigned long)len_section);
+    const size_t len_origin_token = dt_path_origin_length(dt_path_cursor, len_section);
+    if (len_origin_token > 0) {
+      TRACE("substitute $ORIGIN\n");
+
+      // Allocate space for the follow path
+      // $ORIGIN/section_path/name\0
+      size_t needed_len = len_ORIGIN + (len_section - len_origin_token) + len_rel_path + 1;
+      if (needed_len > len_path_buffer) {
+        path_arena_free(libstdcxx_path, len_path_buffer);
+        libstdcxx_path = (char*)path_arena_alloc(needed_len);
+        if (NULL == libstdcxx_path) {
+          ERROR("Audit library: Failed to allocate memory for libstdc++ path. runtime link errors may occur\n");
+          return ec_fatal_error;
+        }
+        len_path_buffer = needed_len;
+      }
+      // Truncate
+      libstdcxx_path[0] = '\0';
+
+      // Construct the string
+      strncat(libstdcxx_path, ORIGIN, len_path_buffer - 1);
+      libstdcxx_path[len_path_buffer - 1] = '\0';
+      dt_path_cursor += len_origin_token;
+      len_section -= len_origin_token;
+      if (len_section > 0) {
+        strncat(libstdcxx_path, dt_path_cursor, size_t_min(len_section, len_path_buffer - 1 - len_ORIGIN));
+        libstdcxx_path[len_path_buffer - 1] = '\0';
+      }
+      const size_t len_directory = strlen(libstdcxx_path);
+      libstdcxx_path[len_directory] = '/';
+      libstdcxx_path[len_directory + 1] = '\0';
+      strncat(libstdcxx_path, name, len_path_buffer - 1 - len_ORIGIN - len_section - 1);
+      libstdcxx_path[len_path_buffer - 1] = '\0';
+
+    } else {
+      size_t needed_len = len_section + len_rel_path + 1;
+      if (needed_len > len_path_buffer) {
+        path_arena_free(libstdcxx_path, len_path_buffer);
+        libstdcxx_path = (char*)path_arena_alloc(needed_len);
+        if (NULL == libstdcxx_path) {
+          ERROR("Audit library: Failed to allocate memory for libstdc++ path. runtime link errors may occur\n");
+          return ec_fatal_error;
+        }
+        len_path_buffer = needed_len;
+      }
+      libstdcxx_path[0] = '\0';
+      strncat(libstdcxx_path, dt_path_cursor, size_t_min(len_section, len_path_buffer - 1));
+      libstdcxx_path[len_path_buffer - 1] = '\0';
+      libstdcxx_path[len_section] = '/';
+      libstdcxx_path[len_section + 1] = '\0';
+      strncat(libstdcxx_path, name, len_path_buffer - 1 - len_section - 1);
+      libstdcxx_path[len_path_buffer - 1] = '\0';
+    }
+
+    // Check if the path at `shipped_libstdcxx_path` exists
+    TRACE("Trying path %s\n", libstdcxx_path);
+    if (0 == trypath_callback(libstdcxx_path, callback_data)) {
+      // found libstdc++ in RUNPATH/RPATH. Can return indicating success
+
+      // Return the path and length of the buffer
+      *p_path = libstdcxx_path;
+      *p_path_buffer_len = len_path_buffer;
+
+      // The buffer is not released! The caller now owns the buffer
+      return ec_success;
+    }
+
+    dt_path_cursor = end_of_this_section + 1;
+  }
+
+  // Free
+  path_arena_free(libstdcxx_path, len_path_buffer);
+
+  // Did not find `name` in dt_path
+  return ec_fatal_error;
+}
+
+/**
+ * From a DT_RUNPATH or DT_RPATH, find the first path that contains libstdc++.so.6. See find_name_from_dt_path
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t find_libstdcxx_from_dt_path(
+  const char* const dt_path,
+  const char* const ORIGIN,
+  error_code_t (*trypath_callback)(const char* const path, void* data),
+  void* callback_data,
+  char** p_path,
+  size_t* p_path_buffer_len
+) {
+  return find_name_from_dt_path(dt_path, libstdcxx_soname, ORIGIN, trypath_callback, callback_data, p_path, p_path_buffer_len);
+}
+
+/**
+ * Copy the colon separated list `dt_path` (DT_RUNPATH, DT_RPATH or DT_AUDIT) into `out`, without the entries for which
+ * `drop_callback` returns 1. Empty entries are dropped as well
+ * @return the number of entries dropped, or -1 if `out` is too small
+ */
+STATIC_INLINE int dt_path_filter(
+  const char* const dt_path,
+  int (*drop_callback)(const char* const entry, const size_t len_entry, void* data),
+  void* callback_data,
+  char* const out,
+  const size_t len_out
+) {
+  ASSERT(dt_path && drop_callback && out && len_out, "Unexpected NULL arguments");
+  int dropped = 0;
+  size_t len = 0;
+  out[0] = '\0';
+  const char* entry = dt_path;
+  while (*entry != '\0') {
+    const char* const end = strchrnul(entry, ':');
+    const size_t len_entry = (size_t)(end - entry);
+    if ((len_entry == 0) || drop_callback(entry, len_entry, callback_data)) {
+      dropped += (len_entry != 0);
+    } else {
+      const size_t len_separator = (len > 0) ? 1 : 0;
+      if ((len + len_separator + len_entry) >= len_out) {
+        return -1;
+      }
+      if (len_separator) {
+        out[len++] = ':';
+      }
+      memcpy(out + len, entry, len_entry);
+      len += len_entry;
+      out[len] = '\0';
+    }
+    entry = (*end == ':') ? (end + 1) : end;
+  }
+  return dropped;
+}
+
+/**
+ * The offline tools look at an installed tree against the sysroot of a target system ("" for /).
+ * Paths reached through $ORIGIN are in the tree, other absolute paths are on the target system
+ */
+STATIC_INLINE void sysroot_host_path(const char* const sysroot, const char* const path, const char* const ORIGIN, char* const out, const size_t len_out) {
+  ASSERT(sysroot && path && ORIGIN && out && len_out, "Unexpected NULL arguments");
+  const size_t len_ORIGIN = strlen(ORIGIN);
+  const int in_tree = (0 == strncmp(path, ORIGIN, len_ORIGIN)) && ((path[len_ORIGIN] == '/') || (path[len_ORIGIN] == '\0'));
+  if ((path[0] != '/') || in_tree) {
+    snprintf(out, len_out, "%s", path);
+  } else {
+    snprintf(out, len_out, "%s%s", sysroot, path);
+  }
+}
+
+/**
+ * Find the system libstdc++ that ld.so would load from its cache, without malloc.
+ * The path is copied into `path` (of `len_path` bytes) so the cache can be unmapped
+ * @return error_code_t ec_success if ld.so.cache names a libstdc++ for this architecture
+ */
+STATIC_INLINE error_code_t find_system_libstdcxx_from_cache(const char* const cache_path, char* const path, const size_t len_path) {
+  ASSERT(cache_path && path && len_path, "Unexpected NULL arguments");
+  const int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ec_fatal_error;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) < 0) || (st.st_size <= 0)) {
+    close(fd);
+    return ec_fatal_error;
+  }
+  const size_t cache_size = (size_t)st.st_size;
+  const char* const cache = (const char*)mmap(NULL, cache_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (cache == MAP_FAILED) {
+    return ec_fatal_error;
+  }
+
+  const char* cached_path = NULL;
+  error_code_t error = ld_so_cache_lookup(cache, cache_size, libstdcxx_soname, &cached_path);
+  if (ec_success == error) {
+    const size_t len = strlen(cached_path);
+    if (len < len_path) {
+      memcpy(path, cached_path, len + 1);
+    } else {
+      error = ec_fatal_error;
+    }
+  }
+  munmap((void*)cache, cache_size);
+  return error;
+}
+
+#endif
+
+#endif
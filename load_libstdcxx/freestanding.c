@@ -0,0 +1,544 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+ *  The part of libc the audit library uses, for audit_libstdcxx_freestanding which is linked with -nostdlib.
+ *
+ *  ld.so gives an audit library its own link namespace, so linking libc loads, relocates and initializes a second copy
+ *  of it in every audited process. These definitions replace it with raw system calls and a few string routines.
+ *  They keep the libc names and are hidden, so the linker binds the calls of audit.c to them directly.
+ *  Only what the audit library needs is implemented:
+ *    - there is no buffering: fprintf formats into a stack buffer and makes one write
+ *    - errno is a single static variable
+ *    - getenv and getauxval use the environment and the auxiliary vector captured once, by a constructor, from the
+ *      arguments ld.so passes to it
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <link.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "raw_syscall.h"
+
+#if !RAW_SYSCALL_AVAILABLE
+#error "audit_libstdcxx_freestanding only supports x86_64 and aarch64"
+#endif
+
+static int freestanding_errno;
+
+int* __errno_location(void) {
+  return &freestanding_errno;
+}
+
+/**
+ * Convert a raw system call result to the libc convention: -1 and errno on failure
+ */
+static long syscall_result(const long result) {
+  if ((result < 0) && (result > -4096)) {
+    freestanding_errno = (int)-result;
+    return -1;
+  }
+  return result;
+}
+
+long syscall(long number, ...) {
+  va_list args;
+  va_start(args, number);
+  long a[6];
+  for (int i = 0; i < 6; i++) {
+    a[i] = va_arg(args, long);
+  }
+  va_end(args);
+  return syscall_result(raw_syscall6(number, a[0], a[1], a[2], a[3], a[4], a[5]));
+}
+
+// Memory and strings
+
+void* memcpy(void* restrict dest, const void* restrict src, size_t n) {
+  unsigned char* d = (unsigned char*)dest;
+  const unsigned char* s = (const unsigned char*)src;
+  while (n--) {
+    *d++ = *s++;
+  }
+  return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+  unsigned char* d = (unsigned char*)dest;
+  const unsigned char* s = (const unsigned char*)src;
+  if (d < s) {
+    while (n--) {
+      *d++ = *s++;
+    }
+  } else {
+    while (n--) {
+      d[n] = s[n];
+    }
+  }
+  return dest;
+}
+
+void* memset(void* s, int c, size_t n) {
+  unsigned char* p = (unsigned char*)s;
+  while (n--) {
+    *p++ = (unsigned char)c;
+  }
+  return s;
+}
+
+int memcmp(const void* s1, const void* s2, size_t n) {
+  const unsigned char* a = (const unsigned char*)s1;
+  const unsigned char* b = (const unsigned char*)s2;
+  for (size_t i = 0; i < n; i++) {
+    if (a[i] != b[i]) {
+      return a[i] - b[i];
+    }
+  }
+  return 0;
+}
+
+void* memchr(const void* s, int c, size_t n) {
+  const unsigned char* p = (const unsigned char*)s;
+  for (size_t i = 0; i < n; i++) {
+    if (p[i] == (unsigned char)c) {
+      return (void*)(p + i);
+    }
+  }
+  return NULL;
+}
+
+size_t strlen(const char* s) {
+  const char* p = s;
+  while (*p) {
+    p++;
+  }
+  return (size_t)(p - s);
+}
+
+int strcmp(const char* s1, const char* s2) {
+  while (*s1 && (*s1 == *s2)) {
+    s1++;
+    s2++;
+  }
+  return (unsigned char)*s1 - (unsigned char)*s2;
+}
+
+int strncmp(const char* s1, const char* s2, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if ((s1[i] != s2[i]) || (s1[i] == '\0')) {
+      return (unsigned char)s1[i] - (unsigned char)s2[i];
+    }
+  }
+  return 0;
+}
+
+char* strchrnul(const char* s, int c) {
+  while (*s && (*s != (char)c)) {
+    s++;
+  }
+  return (char*)s;
+}
+
+char* strchr(const char* s, int c) {
+  const char* p = strchrnul(s, c);
+  return (*p == (char)c) ? (char*)p : NULL;
+}
+
+char* strrchr(const char* s, int c) {
+  const char* last = NULL;
+  do {
+    if (*s == (char)c) {
+      last = s;
+    }
+  } while (*s++);
+  return (char*)last;
+}
+
+char* strncat(char* restrict dest, const char* restrict src, size_t n) {
+  char* d = dest + strlen(dest);
+  while (n-- && *src) {
+    *d++ = *src++;
+  }
+  *d = '\0';
+  return dest;
+}
+
+/**
+ * POSIX dirname, in place. Trailing slashes are ignored, and a path without a slash is "."
+ */
+char* dirname(char* path) {
+  static char dot[] = ".";
+  if ((NULL == path) || (path[0] == '\0')) {
+    return dot;
+  }
+  size_t len = strlen(path);
+  while ((len > 1) && (path[len - 1] == '/')) {
+    len--;
+  }
+  while ((len > 0) && (path[len - 1] != '/')) {
+    len--;
+  }
+  if (len == 0) {
+    return dot;
+  }
+  while ((len > 1) && (path[len - 1] == '/')) {
+    len--;
+  }
+  path[len] = '\0';
+  return path;
+}
+
+// Files
+
+int open(const char* path, int flags, ...) {
+  mode_t mode = 0;
+  if (flags & (O_CREAT | O_TMPFILE)) {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, mode_t);
+    va_end(args);
+  }
+  return (int)syscall_result(raw_syscall(SYS_openat, AT_FDCWD, path, flags, mode, 0, 0));
+}
+
+int close(int fd) {
+  return (int)syscall_result(raw_syscall(SYS_close, fd, 0, 0, 0, 0, 0));
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+  return syscall_result(raw_syscall(SYS_read, fd, buf, count, 0, 0, 0));
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+  return syscall_result(raw_syscall(SYS_pread64, fd, buf, count, offset, 0, 0));
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+  return syscall_result(raw_syscall(SYS_write, fd, buf, count, 0, 0, 0));
+}
+
+ssize_t readlink(const char* restrict path, char* restrict buf, size_t len) {
+  return syscall_result(raw_syscall(SYS_readlinkat, AT_FDCWD, path, buf, len, 0, 0));
+}
+
+int fstatat(int dirfd, const char* restrict path, struct stat* restrict buf, int flags) {
+  return (int)syscall_result(raw_syscall(SYS_newfstatat, dirfd, path, buf, flags, 0, 0));
+}
+
+int stat(const char* restrict path, struct stat* restrict buf) {
+  return fstatat(AT_FDCWD, path, buf, 0);
+}
+
+int fstat(int fd, struct stat* buf) {
+  return fstatat(fd, "", buf, AT_EMPTY_PATH);
+}
+
+int posix_fadvise(int fd, off_t offset, off_t len, int advice) {
+  // Returns the error number instead of setting errno
+  return (int)-raw_syscall(SYS_fadvise64, fd, offset, len, advice, 0, 0);
+}
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+  return (void*)syscall_result(raw_syscall(SYS_mmap, addr, length, prot, flags, fd, offset));
+}
+
+int munmap(void* addr, size_t length) {
+  return (int)syscall_result(raw_syscall(SYS_munmap, addr, length, 0, 0, 0, 0));
+}
+
+// Process
+
+pid_t getpid(void) {
+  return (pid_t)raw_syscall(SYS_getpid, 0, 0, 0, 0, 0, 0);
+}
+
+int clock_gettime(clockid_t clock, struct timespec* tp) {
+  return (int)syscall_result(raw_syscall(SYS_clock_gettime, clock, tp, 0, 0, 0, 0));
+}
+
+void abort(void) {
+  raw_syscall(SYS_tgkill, getpid(), raw_syscall(SYS_gettid, 0, 0, 0, 0, 0, 0), SIGABRT, 0, 0, 0);
+  for (;;) {
+    raw_syscall(SYS_exit_group, 127, 0, 0, 0, 0, 0);
+  }
+}
+
+static char** freestanding_environ = NULL;
+static const ElfW(auxv_t)* freestanding_auxv = NULL;
+
+/**
+ * ld.so runs the constructors of the audit library with the arguments of the process, before la_version and before the
+ * constructors of audit.c, which run at the default priority. `envp` is the environment array of the initial stack,
+ * and the auxiliary vector follows the NULL that ends it. ld.so may have removed variables from the environment of
+ * a setuid executable by moving the later ones down, which leaves more NULLs before the auxiliary vector. Its first
+ * entry is never AT_NULL
+ */
+__attribute__((constructor(101))) static void capture_environ_and_auxv(int argc, char** argv, char** envp) {
+  (void)argc;
+  (void)argv;
+  if (NULL == envp) {
+    return;
+  }
+  freestanding_environ = envp;
+  char** cursor = envp;
+  while (NULL != *cursor) {
+    cursor++;
+  }
+  while (NULL == *cursor) {
+    cursor++;
+  }
+  freestanding_auxv = (const ElfW(auxv_t)*)cursor;
+}
+
+unsigned long getauxval(unsigned long type) {
+  for (const ElfW(auxv_t)* entry = freestanding_auxv; (NULL != entry) && (entry->a_type != AT_NULL); entry++) {
+    if (entry->a_type == type) {
+      return entry->a_un.a_val;
+    }
+  }
+  freestanding_errno = ENOENT;
+  return 0;
+}
+
+long sysconf(int name) {
+  if (name == _SC_PAGESIZE) {
+    return (long)getauxval(AT_PAGESZ);
+  }
+  freestanding_errno = EINVAL;
+  return -1;
+}
+
+/**
+ * The value of an environment variable, from the environment captured by capture_environ_and_auxv
+ */
+char* getenv(const char* name) {
+  const size_t len_name = strlen(name);
+  for (char** entry = freestanding_environ; (NULL != entry) && (NULL != *entry); entry++) {
+    if ((0 == strncmp(*entry, name, len_name)) && ((*entry)[len_name] == '=')) {
+      return *entry + len_name + 1;
+    }
+  }
+  return NULL;
+}
+
+// Formatted output. Flags '#', '0' and '-', a width, a precision and the length modifiers are supported for d i u x X p s c
+
+typedef struct {
+  char* out;
+  size_t len_out;
+  size_t len;
+} format_buffer_t;
+
+static void format_char(format_buffer_t* const buffer, const char c) {
+  if ((buffer->len + 1) < buffer->len_out) {
+    buffer->out[buffer->len] = c;
+  }
+  buffer->len++;
+}
+
+static void format_padded(format_buffer_t* const buffer, const char* const s, const size_t len, const size_t width, const int left, const char pad) {
+  const size_t padding = (width > len) ? (width - len) : 0;
+  if (!left) {
+    for (size_t i = 0; i < padding; i++) {
+      format_char(buffer, pad);
+    }
+  }
+  for (size_t i = 0; i < len; i++) {
+    format_char(buffer, s[i]);
+  }
+  if (left) {
+    for (size_t i = 0; i < padding; i++) {
+      format_char(buffer, ' ');
+    }
+  }
+}
+
+int vsnprintf(char* restrict out, size_t len_out, const char* restrict format, va_list args) {
+  format_buffer_t buffer = {out, len_out, 0};
+  for (const char* f = format; *f; f++) {
+    if (*f != '%') {
+      format_char(&buffer, *f);
+      continue;
+    }
+    f++;
+    int alternate = 0;
+    int left = 0;
+    char pad = ' ';
+    for (;; f++) {
+      if (*f == '#') {
+        alternate = 1;
+      } else if (*f == '-') {
+        left = 1;
+      } else if (*f == '0') {
+        pad = '0';
+      } else {
+        break;
+      }
+    }
+    size_t width = 0;
+    if (*f == '*') {
+      width = (size_t)va_arg(args, int);
+      f++;
+    }
+    while ((*f >= '0') && (*f <= '9')) {
+      width = (width * 10) + (size_t)(*f++ - '0');
+    }
+    size_t precision = SIZE_MAX;
+    if (*f == '.') {
+      f++;
+      precision = 0;
+      if (*f == '*') {
+        precision = (size_t)va_arg(args, int);
+        f++;
+      }
+      while ((*f >= '0') && (*f <= '9')) {
+        precision = (precision * 10) + (size_t)(*f++ - '0');
+      }
+    }
+    int wide = 0;
+    while ((*f == 'l') || (*f == 'z') || (*f == 'j') || (*f == 't') || (*f == 'h')) {
+      wide |= (*f != 'h');
+      f++;
+    }
+    char digits[24];
+    size_t i = sizeof(digits);
+    switch (*f) {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'p': {
+        const int is_signed = (*f == 'd') || (*f == 'i');
+        const unsigned base = ((*f == 'x') || (*f == 'X') || (*f == 'p')) ? 16 : 10;
+        const char* const symbols = (*f == 'X') ? "0123456789ABCDEF" : "0123456789abcdef";
+        uint64_t value;
+        int negative = 0;
+        if (*f == 'p') {
+          value = (uint64_t)(uintptr_t)va_arg(args, void*);
+          alternate = 1;
+        } else if (is_signed) {
+          const int64_t signed_value = wide ? (int64_t)va_arg(args, long) : (int64_t)va_arg(args, int);
+          negative = (signed_value < 0);
+          value = negative ? (uint64_t)0 - (uint64_t)signed_value : (uint64_t)signed_value;
+        } else {
+          value = wide ? (uint64_t)va_arg(args, unsigned long) : (uint64_t)va_arg(args, unsigned int);
+        }
+        do {
+          digits[--i] = symbols[value % base];
+          value /= base;
+        } while (value);
+        if (alternate && (base == 16)) {
+          digits[--i] = 'x';
+          digits[--i] = '0';
+        }
+        if (negative) {
+          digits[--i] = '-';
+        }
+        format_padded(&buffer, digits + i, sizeof(digits) - i, width, left, pad);
+        break;
+      }
+      case 's': {
+        const char* s = va_arg(args, const char*);
+        if (NULL == s) {
+          s = "(null)";
+        }
+        size_t len = 0;
+        while ((len < precision) && s[len]) {
+          len++;
+        }
+        format_padded(&buffer, s, len, width, left, ' ');
+        break;
+      }
+      case 'c': {
+        const char c = (char)va_arg(args, int);
+        format_padded(&buffer, &c, 1, width, left, ' ');
+        break;
+      }
+      case '%':
+        format_char(&buffer, '%');
+        break;
+      default:
+        // Unsupported conversion, printed as is
+        format_char(&buffer, '%');
+        if (*f == '\0') {
+          f--;
+        } else {
+          format_char(&buffer, *f);
+        }
+        break;
+    }
+  }
+  if (len_out > 0) {
+    out[(buffer.len < len_out) ? buffer.len : (len_out - 1)] = '\0';
+  }
+  return (int)buffer.len;
+}
+
+int snprintf(char* restrict out, size_t len_out, const char* restrict format, ...) {
+  va_list args;
+  va_start(args, format);
+  const int len = vsnprintf(out, len_out, format, args);
+  va_end(args);
+  return len;
+}
+
+// A stream is the file descriptor itself. Only stderr is used
+FILE* stderr = (FILE*)(uintptr_t)STDERR_FILENO;
+
+int fprintf(FILE* restrict stream, const char* restrict format, ...) {
+  char line[1024];
+  va_list args;
+  va_start(args, format);
+  const int len = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  const size_t len_line = ((size_t)len < sizeof(line)) ? (size_t)len : (sizeof(line) - 1);
+  write((int)(uintptr_t)stream, line, len_line);
+  return len;
+}
+
+int fflush(FILE* stream) {
+  (void)stream;
+  return 0;
+}
+
+void perror(const char* s) {
+  fprintf(stderr, "%s: errno %d\n", s, freestanding_errno);
+}
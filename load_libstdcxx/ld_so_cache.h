@@ -0,0 +1,193 @@
+#ifndef _LD_SO_CACHE_H_
+#define _LD_SO_CACHE_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "macros.h"
+#include "error_types.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+/**
+ * Layout of /etc/ld.so.cache as written by ldconfig (glibc sysdeps/generic/dl-cache.h)
+ * Older ldconfig writes the old format followed by the new format. Current ldconfig writes only the new format.
+ * String offsets of the new format entries are relative to the start of the new format header.
+ */
+#define LD_SO_CACHE_MAGIC_OLD "ld.so-1.7.0"
+#define LD_SO_CACHE_MAGIC_NEW "glibc-ld.so.cache"
+#define LD_SO_CACHE_VERSION_NEW "1.1"
+
+typedef struct {
+  int32_t flags;
+  uint32_t key;
+  uint32_t value;
+} ld_so_cache_entry_old_t;
+
+typedef struct {
+  char magic[sizeof(LD_SO_CACHE_MAGIC_OLD) - 1];
+  uint32_t nlibs;
+} ld_so_cache_header_old_t;
+
+typedef struct {
+  int32_t flags;
+  uint32_t key;
+  uint32_t value;
+  uint32_t osversion_unused;
+  uint64_t hwcap;
+} ld_so_cache_entry_new_t;
+
+typedef struct {
+  char magic[sizeof(LD_SO_CACHE_MAGIC_NEW) - 1];
+  char version[sizeof(LD_SO_CACHE_VERSION_NEW) - 1];
+  uint32_t nlibs;
+  uint32_t len_strings;
+  uint8_t flags;
+  uint8_t padding_unused[3];
+  uint32_t extension_offset;
+  uint32_t unused[3];
+} ld_so_cache_header_new_t;
+
+// The entry flags ld.so accepts for this architecture: _DL_CACHE_DEFAULT_ID and _dl_cache_check_flags of glibc
+// (sysdeps/generic/ldconfig.h and the dl-cache.h of each architecture)
+#define LD_SO_CACHE_FLAG_ELF_LIBC6 0x0003
+#define LD_SO_CACHE_FLAG_X8664_LIB64 0x0300
+#define LD_SO_CACHE_FLAG_S390_LIB64 0x0400
+#define LD_SO_CACHE_FLAG_POWERPC_LIB64 0x0500
+#define LD_SO_CACHE_FLAG_X8664_LIBX32 0x0800
+#define LD_SO_CACHE_FLAG_ARM_LIBHF 0x0900
+#define LD_SO_CACHE_FLAG_AARCH64_LIB64 0x0a00
+#define LD_SO_CACHE_FLAG_ARM_LIBSF 0x0b00
+#define LD_SO_CACHE_FLAG_RISCV_FLOAT_ABI_SOFT 0x0f00
+#define LD_SO_CACHE_FLAG_RISCV_FLOAT_ABI_DOUBLE 0x1000
+#if defined(__x86_64__) && defined(__LP64__)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_X8664_LIB64 | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#define LD_SO_CACHE_CHECK_FLAGS(flags) ((flags) == LD_SO_CACHE_DEFAULT_ID)
+#elif defined(__x86_64__)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_X8664_LIBX32 | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#define LD_SO_CACHE_CHECK_FLAGS(flags) ((flags) == LD_SO_CACHE_DEFAULT_ID)
+#elif defined(__aarch64__) && defined(__LP64__)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_AARCH64_LIB64 | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#define LD_SO_CACHE_CHECK_FLAGS(flags) ((flags) == LD_SO_CACHE_DEFAULT_ID)
+#elif defined(__arm__)
+// Hard float entries are marked, soft float ones are marked or, from older ldconfig, plain libc6
+#if defined(__ARM_PCS_VFP)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_ARM_LIBHF | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#else
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_ARM_LIBSF | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#endif
+#define LD_SO_CACHE_CHECK_FLAGS(flags) (((flags) == LD_SO_CACHE_DEFAULT_ID) || ((flags) == LD_SO_CACHE_FLAG_ELF_LIBC6))
+#elif defined(__powerpc64__)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_POWERPC_LIB64 | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#elif defined(__s390x__)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_S390_LIB64 | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#elif defined(__riscv) && (__riscv_xlen == 64) && defined(__riscv_float_abi_double)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_RISCV_FLOAT_ABI_DOUBLE | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#elif defined(__riscv) && (__riscv_xlen == 64) && defined(__riscv_float_abi_soft)
+#define LD_SO_CACHE_DEFAULT_ID (LD_SO_CACHE_FLAG_RISCV_FLOAT_ABI_SOFT | LD_SO_CACHE_FLAG_ELF_LIBC6)
+#elif defined(__i386__)
+#define LD_SO_CACHE_DEFAULT_ID LD_SO_CACHE_FLAG_ELF_LIBC6
+#endif
+// The generic check of glibc also accepts the libc5 era flag 1
+#if defined(LD_SO_CACHE_DEFAULT_ID) && !defined(LD_SO_CACHE_CHECK_FLAGS)
+#define LD_SO_CACHE_CHECK_FLAGS(flags) (((flags) == 1) || ((flags) == LD_SO_CACHE_DEFAULT_ID))
+#endif
+
+// The definitions are C. test.cpp includes the header for the types only
+#ifndef __cplusplus
+
+/**
+ * Return the NUL terminated string at `offset` of the string table, or NULL if it does not terminate inside the image
+ */
+STATIC const char* ld_so_cache_string(const char* const strings, const size_t len_strings, const uint32_t offset) {
+  if (offset >= len_strings) {
+    return NULL;
+  }
+  if (NULL == memchr(strings + offset, '\0', len_strings - offset)) {
+    return NULL;
+  }
+  return strings + offset;
+}
+
+/**
+ * Find the path ld.so would load for the library `name` from an ld.so.cache image
+ * Mirrors glibc's _dl_load_cache_lookup: the first entry (in cache order) whose key matches and whose flags are the
+ * default for this architecture wins. Entries in glibc-hwcaps or legacy hwcap subdirectories are skipped, which is
+ * what ld.so does on a CPU without those features and matches how libstdc++ is packaged.
+ * On success, *p_path points into the cache image. It is valid as long as the image is mapped.
+ * @return error_code_t ec_success if found, ec_non_fatal_error if the name is not cached, ec_fatal_error if the image is invalid
+ */
+STATIC error_code_t ld_so_cache_lookup(const char* const cache, const size_t cache_size, const char* const name, const char** const p_path) {
+  ASSERT(cache && name && p_path, "Unexpected NULL arguments");
+  *p_path = NULL;
+
+#ifndef LD_SO_CACHE_DEFAULT_ID
+  (void)cache_size;
+  TRACE("ld.so.cache flags unknown for this architecture\n");
+  return ec_fatal_error;
+#else
+  // Skip the old format, if present, to find the new format header
+  size_t offset_new = 0;
+  if ((cache_size >= sizeof(ld_so_cache_header_old_t)) && (0 == memcmp(cache, LD_SO_CACHE_MAGIC_OLD, sizeof(LD_SO_CACHE_MAGIC_OLD) - 1))) {
+    const ld_so_cache_header_old_t* const header_old = (const ld_so_cache_header_old_t*)cache;
+    if (header_old->nlibs > (cache_size - sizeof(ld_so_cache_header_old_t)) / sizeof(ld_so_cache_entry_old_t)) {
+      return ec_fatal_error;
+    }
+    offset_new = sizeof(ld_so_cache_header_old_t) + header_old->nlibs * sizeof(ld_so_cache_entry_old_t);
+    // The new format is aligned to its own alignment
+    offset_new = (offset_new + _Alignof(ld_so_cache_entry_new_t) - 1) & ~(_Alignof(ld_so_cache_entry_new_t) - 1);
+  }
+
+  if ((offset_new >= cache_size) || ((cache_size - offset_new) < sizeof(ld_so_cache_header_new_t))) {
+    return ec_fatal_error;
+  }
+  const char* const base = cache + offset_new;
+  const size_t size = cache_size - offset_new;
+  const ld_so_cache_header_new_t* const header = (const ld_so_cache_header_new_t*)base;
+  if ((0 != memcmp(header->magic, LD_SO_CACHE_MAGIC_NEW, sizeof(header->magic))) ||
+      (0 != memcmp(header->version, LD_SO_CACHE_VERSION_NEW, sizeof(header->version)))) {
+    TRACE("Unknown ld.so.cache format\n");
+    return ec_fatal_error;
+  }
+  if (header->nlibs > (size - sizeof(ld_so_cache_header_new_t)) / sizeof(ld_so_cache_entry_new_t)) {
+    return ec_fatal_error;
+  }
+
+  const ld_so_cache_entry_new_t* const entries = (const ld_so_cache_entry_new_t*)(base + sizeof(ld_so_cache_header_new_t));
+  for (uint32_t i = 0; i < header->nlibs; i++) {
+    const ld_so_cache_entry_new_t* const entry = &entries[i];
+    if (!LD_SO_CACHE_CHECK_FLAGS(entry->flags)) {
+      continue;
+    }
+    if (0 != entry->hwcap) {
+      continue;
+    }
+    const char* const key = ld_so_cache_string(base, size, entry->key);
+    if ((NULL == key) || (0 != strcmp(key, name))) {
+      continue;
+    }
+    const char* const value = ld_so_cache_string(base, size, entry->value);
+    if (NULL == value) {
+      return ec_fatal_error;
+    }
+    TRACE("ld.so.cache: %s -> %s\n", name, value);
+    *p_path = value;
+    return ec_success;
+  }
+  return ec_non_fatal_error;
+#endif
+}
+
+#endif
+
+#endif
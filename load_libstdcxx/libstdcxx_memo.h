@@ -0,0 +1,83 @@
+#ifndef _LIBSTDCXX_MEMO_H_
+#define _LIBSTDCXX_MEMO_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "macros.h"
+#include "error_types.h"
+
+#ifndef STATIC
+#ifndef GOOGLE_TEST
+#define STATIC static
+#else
+#define STATIC
+#endif
+#endif
+
+/**
+ * Memo of libstdc++ libraries whose version has already been parsed, keyed by file identity (device, inode)
+ * ld.so can offer the same physical library under several names (/lib64 vs /usr/lib64, symlinks) when many
+ * DSOs carry their own RUNPATH. The memo lets a repeated search be answered with a single fstatat.
+ * The table is fixed size (no malloc). Once full, the oldest entry is overwritten.
+ */
+#define LIBSTDCXX_MEMO_SIZE 16
+
+typedef struct {
+  dev_t dev;
+  ino_t ino;
+  uint32_t glibcxx_version;
+} libstdcxx_memo_entry_t;
+
+/**
+ * A chosen libstdc++: its path, version and file identity
+ */
+typedef struct {
+  const char* path;
+  uint32_t glibcxx_version;
+  dev_t dev;
+  ino_t ino;
+} libstdcxx_decision_t;
+
+// The definitions are C. test.cpp includes the header for the types only
+#ifndef __cplusplus
+
+static libstdcxx_memo_entry_t libstdcxx_memo[LIBSTDCXX_MEMO_SIZE];
+static size_t libstdcxx_memo_inserts = 0;
+
+/**
+ * Find the memo entry of a parsed libstdc++ by its file identity
+ * @return the entry, or NULL if this file has not been parsed yet
+ */
+STATIC const libstdcxx_memo_entry_t* libstdcxx_memo_find(const dev_t dev, const ino_t ino) {
+  const size_t count = ((libstdcxx_memo_inserts < LIBSTDCXX_MEMO_SIZE) ? libstdcxx_memo_inserts : LIBSTDCXX_MEMO_SIZE);
+  for (size_t i = 0; i < count; i++) {
+    if ((libstdcxx_memo[i].dev == dev) && (libstdcxx_memo[i].ino == ino)) {
+      return &libstdcxx_memo[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Record the parsed version of a libstdc++ by its file identity
+ * An existing entry for the same identity is updated in place
+ */
+STATIC void libstdcxx_memo_insert(const dev_t dev, const ino_t ino, const uint32_t glibcxx_version) {
+  libstdcxx_memo_entry_t* entry = (libstdcxx_memo_entry_t*)libstdcxx_memo_find(dev, ino);
+  if (NULL == entry) {
+    entry = &libstdcxx_memo[libstdcxx_memo_inserts % LIBSTDCXX_MEMO_SIZE];
+    libstdcxx_memo_inserts++;
+  }
+  entry->dev = dev;
+  entry->ino = ino;
+  entry->glibcxx_version = glibcxx_version;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef _OBJSEARCH_RECORD_H_
+#define _OBJSEARCH_RECORD_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "error_types.h"
+
+// Helpers of a header that not every including file uses
+#ifndef STATIC_INLINE
+#ifndef GOOGLE_TEST
+#define STATIC_INLINE static inline
+#else
+#define STATIC_INLINE
+#endif
+#endif
+
+/**
+ * Recording of the searches ld.so makes, for the offline analyzer analyze_objsearch.
+ * Enabled by setting AUDIT_LIBSTDCXX_RECORD to a directory: each process writes <directory>/<executable>.<pid>.objsearch
+ * One tab separated event per line:
+ *   exe     <ORIGIN of the audit library> <executable>
+ *   object  <id> <ORIGIN> <DT_RUNPATH> <DT_RPATH> <path>        an object was loaded. Its id is the requester of its searches
+ *   probe   <requester id> <flag> <hit|miss|skip> <ns> <name> <path>
+ * A probe is ld.so trying one path for `name`, after la_objsearch. It is a hit if the object opened next is that path (ld.so
+ * names an object after its own candidate, also when it was redirected), a miss otherwise, and `ns` runs until then.
+ * A skip is a path the audit library rejected without a probe. The audit library's own search of DT_RUNPATH/DT_RPATH
+ * for libstdc++ has the flag `audit` and the requester 0, the executable. It expands $ORIGIN with its own ORIGIN.
+ * Events are buffered in static storage and written at LA_ACT_CONSISTENT, or when the buffer is full. The recording is
+ * closed at each LA_ACT_CONSISTENT and reopened to append the events of a later dlopen, so no descriptor is held meanwhile
+ */
+#define OBJSEARCH_RECORD_ENV "AUDIT_LIBSTDCXX_RECORD"
+#define OBJSEARCH_RECORD_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+  // Open from the first write to the next LA_ACT_CONSISTENT. `fd` is only valid while `is_open`, so the whole struct starts
+  // zeroed, in .bss
+  int is_open;
+  int fd;
+  int enabled;
+  char path[PATH_MAX];
+  size_t len;
+  unsigned next_object_id;
+  // Probe awaiting its outcome
+  int pending;
+  uintptr_t pending_requester;
+  const char* pending_flag;
+  uint64_t pending_start_ns;
+  char pending_name[PATH_MAX];
+  char pending_candidate[PATH_MAX];
+  char pending_path[PATH_MAX];
+  // Name of the current search, from its LA_SER_ORIG call
+  char name[PATH_MAX];
+  char buffer[OBJSEARCH_RECORD_BUFFER_SIZE];
+} objsearch_record_t;
+
+static objsearch_record_t objsearch_record;
+
+STATIC_INLINE uint64_t objsearch_record_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+STATIC_INLINE int objsearch_record_enabled(void) {
+  return objsearch_record.enabled;
+}
+
+/**
+ * Write out what is buffered, reopening the recording if it was closed. Events that cannot be written are dropped
+ */
+STATIC_INLINE void objsearch_record_flush(void) {
+  if (!objsearch_record.is_open && (objsearch_record.len > 0)) {
+    objsearch_record.fd = open(objsearch_record.path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    objsearch_record.is_open = (objsearch_record.fd >= 0);
+  }
+  if (!objsearch_record.is_open) {
+    objsearch_record.len = 0;
+    return;
+  }
+  size_t written = 0;
+  while (written < objsearch_record.len) {
+    const ssize_t result = write(objsearch_record.fd, objsearch_record.buffer + written, objsearch_record.len - written);
+    if (result <= 0) {
+      break;
+    }
+    written += (size_t)result;
+  }
+  objsearch_record.len = 0;
+}
+
+/**
+ * Append a field to the line being built. Tabs and newlines, which would break the format, are replaced by spaces
+ */
+STATIC_INLINE void objsearch_record_append(const char* const field, const char separator) {
+  const size_t len_field = strlen(field);
+  if ((objsearch_record.len + len_field + 1) > OBJSEARCH_RECORD_BUFFER_SIZE) {
+    objsearch_record_flush();
+  }
+  if ((len_field + 1) > OBJSEARCH_RECORD_BUFFER_SIZE) {
+    return;
+  }
+  char* const out = objsearch_record.buffer + objsearch_record.len;
+  for (size_t i = 0; i < len_field; i++) {
+    out[i] = ((field[i] == '\t') || (field[i] == '\n')) ? ' ' : field[i];
+  }
+  out[len_field] = separator;
+  objsearch_record.len += len_field + 1;
+}
+
+STATIC_INLINE void objsearch_record_append_number(const uint64_t number, const char separator) {
+  char digits[24];
+  size_t i = sizeof(digits) - 1;
+  digits[i] = '\0';
+  uint64_t remainder = number;
+  do {
+    digits[--i] = (char)('0' + (remainder % 10));
+    remainder /= 10;
+  } while (remainder && i);
+  objsearch_record_append(digits + i, separator);
+}
+
+/**
+ * Start recording into `directory` for the executable at `executable`, whose DT_RUNPATH/DT_RPATH the audit library expands with `ORIGIN`
+ * @return error_code_t
+ */
+STATIC_INLINE error_code_t objsearch_record_open(const char* const directory, const char* const executable, const char* const ORIGIN) {
+  ASSERT(directory && executable && ORIGIN, "Unexpected NULL arguments\n");
+  const char* const slash = strrchr(executable, '/');
+  const char* const base_name = (NULL != slash) ? (slash + 1) : executable;
+
+  // <directory>/<executable>.<pid>.objsearch
+  char path[PATH_MAX];
+  const size_t len_directory = strlen(directory);
+  const size_t len_base_name = strlen(base_name);
+  if ((len_directory + len_base_name + 48) > sizeof(path)) {
+    return ec_fatal_error;
+  }
+  memcpy(path, directory, len_directory);
+  path[len_directory] = '/';
+  memcpy(path + len_directory + 1, base_name, len_base_name);
+  size_t len_path = len_directory + 1 + len_base_name;
+  path[len_path++] = '.';
+  char digits[24];
+  size_t i = sizeof(digits);
+  unsigned long pid = (unsigned long)getpid();
+  do {
+    digits[--i] = (char)('0' + (pid % 10));
+    pid /= 10;
+  } while (pid);
+  memcpy(path + len_path, digits + i, sizeof(digits) - i);
+  len_path += sizeof(digits) - i;
+  memcpy(path + len_path, ".objsearch", sizeof(".objsearch"));
+
+  objsearch_record.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  objsearch_record.is_open = (objsearch_record.fd >= 0);
+  if (!objsearch_record.is_open) {
+    ERROR("Audit library: Cannot record the searches into %s\n", path);
+    return ec_fatal_error;
+  }
+  memcpy(objsearch_record.path, path, sizeof(path));
+  objsearch_record.enabled = 1;
+  objsearch_record.len = 0;
+  objsearch_record.pending = 0;
+  objsearch_record.name[0] = '\0';
+  objsearch_record_append("exe", '\t');
+  objsearch_record_append(ORIGIN, '\t');
+  objsearch_record_append(executable, '\n');
+  return ec_success;
+}
+
+/**
+ * Write out what is buffered and close the recording. Recording goes on: the next write reopens it
+ */
+STATIC_INLINE void objsearch_record_close(void) {
+  objsearch_record_flush();
+  if (objsearch_record.is_open) {
+    close(objsearch_record.fd);
+    objsearch_record.is_open = 0;
+  }
+}
+
+/**
+ * Record a loaded object
+ * @return the id the searches it requests are recorded with
+ */
+STATIC_INLINE unsigned objsearch_record_object(const char* const ORIGIN, const char* const dt_runpath, const char* const dt_rpath, const char* const path) {
+  const unsigned id = objsearch_record.next_object_id++;
+  objsearch_record_append("object", '\t');
+  objsearch_record_append_number(id, '\t');
+  objsearch_record_append(ORIGIN, '\t');
+  objsearch_record_append(dt_runpath, '\t');
+  objsearch_record_append(dt_rpath, '\t');
+  objsearch_record_append(path, '\n');
+  return id;
+}
+
+STATIC_INLINE void objsearch_record_probe(const uintptr_t requester, const char* const flag, const char* const outcome, const uint64_t ns, const char* const name,
+                                   const char* const path) {
+  objsearch_record_append("probe", '\t');
+  objsearch_record_append_number(requester, '\t');
+  objsearch_record_append(flag, '\t');
+  objsearch_record_append(outcome, '\t');
+  objsearch_record_append_number(ns, '\t');
+  objsearch_record_append(name, '\t');
+  objsearch_record_append(path, '\n');
+}
+
+/**
+ * Close the pending probe, a hit if `opened_path` is the path it tried or the candidate of ld.so it was redirected from
+ */
+STATIC_INLINE void objsearch_record_settle(const char* const opened_path) {
+  if (!objsearch_record.pending) {
+    return;
+  }
+  objsearch_record.pending = 0;
+  const int hit = (NULL != opened_path) &&
+                  ((0 == strcmp(opened_path, objsearch_record.pending_path)) || (0 == strcmp(opened_path, objsearch_record.pending_candidate)));
+  objsearch_record_probe(objsearch_record.pending_requester, objsearch_record.pending_flag, hit ? "hit" : "miss",
+                         objsearch_record_now_ns() - objsearch_record.pending_start_ns, objsearch_record.pending_name, objsearch_record.pending_path);
+}
+
+STATIC_INLINE const char* objsearch_record_flag_name(const unsigned int flag) {
+  return (flag == LA_SER_ORIG)      ? "orig"
+         : (flag == LA_SER_LIBPATH) ? "libpath"
+         : (flag == LA_SER_RUNPATH) ? "runpath"
+         : (flag == LA_SER_CONFIG)  ? "cache"
+         : (flag == LA_SER_DEFAULT) ? "default"
+         : (flag == LA_SER_SECURE)  ? "secure"
+                                    : "unknown";
+}
+
+/**
+ * Record the answer of la_objsearch to one search. `result` is the path ld.so probes next, or NULL if it was rejected
+ */
+STATIC_INLINE void objsearch_record_search(const uintptr_t requester, const char* const name, const unsigned int flag, const char* const result) {
+  objsearch_record_settle(NULL);
+  if (flag == LA_SER_ORIG) {
+    const size_t len_name = strlen(name);
+    if (len_name < sizeof(objsearch_record.name)) {
+      memcpy(objsearch_record.name, name, len_name + 1);
+    }
+    // A name without a slash is searched in the directories, only a path is opened as is
+    if ((NULL == result) || (NULL == strchr(result, '/'))) {
+      return;
+    }
+  }
+  if (NULL == result) {
+    objsearch_record_probe(requester, objsearch_record_flag_name(flag), "skip", 0, objsearch_record.name, name);
+    return;
+  }
+  const size_t len_result = strlen(result);
+  const size_t len_candidate = strlen(name);
+  if ((len_result >= sizeof(objsearch_record.pending_path)) || (len_candidate >= sizeof(objsearch_record.pending_candidate))) {
+    return;
+  }
+  memcpy(objsearch_record.pending_path, result, len_result + 1);
+  memcpy(objsearch_record.pending_candidate, name, len_candidate + 1);
+  memcpy(objsearch_record.pending_name, objsearch_record.name, sizeof(objsearch_record.pending_name));
+  objsearch_record.pending_requester = requester;
+  objsearch_record.pending_flag = objsearch_record_flag_name(flag);
+  objsearch_record.pending = 1;
+  objsearch_record.pending_start_ns = objsearch_record_now_ns();
+}
+
+/**
+ * State of a recorded search of DT_RUNPATH/DT_RPATH by the audit library itself. Wraps the trypath callback
+ */
+typedef struct {
+  error_code_t (*trypath_callback)(const char* const path, void* data);
+  void* callback_data;
+} objsearch_record_trypath_t;
+
+/**
+ * Callback of find_libstdcxx_from_dt_path that records each candidate the wrapped callback tries
+ * @return error_code_t of the wrapped callback
+ */
+STATIC_INLINE error_code_t objsearch_record_trypath(const char* const path, void* data) {
+  const objsearch_record_trypath_t* const wrapped = (const objsearch_record_trypath_t*)data;
+  const uint64_t start_ns = objsearch_record_now_ns();
+  const error_code_t error = wrapped->trypath_callback(path, wrapped->callback_data);
+  const char* const slash = strrchr(path, '/');
+  objsearch_record_probe(0, "audit", (ec_success == error) ? "hit" : "miss", objsearch_record_now_ns() - start_ns, (NULL != slash) ? (slash + 1) : path, path);
+  return error;
+}
+
+#endif
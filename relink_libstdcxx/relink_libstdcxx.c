@@ -0,0 +1,550 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dirent.h>
+#include <ftw.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "find_libstdcxx.h"
+#include "get_libstdcxx_version.h"
+#include "macros.h"
+
+/**
+ *  Applies the decision of the audit library once, at install time, to the executables of an installed tree.
+ *  When the target system is known at deploy time (containers, images), the loader then picks the right libstdc++
+ *  without paying for LD_AUDIT at every exec.
+ *
+ *  Usage: relink_libstdcxx [-n] [-s sysroot] [-r report] <installed tree or executable>...
+ *    -n          Dry run. Only report what would be changed
+ *    -s sysroot  Root of the target system: its /etc/ld.so.cache and library directories give the system libstdc++ (default /)
+ *    -r report   Write the report to this file instead of stdout
+ *
+ *  For every dynamic executable that needs libstdc++.so.6, the shipped libstdc++ is found in DT_RUNPATH/DT_RPATH and the
+ *  system libstdc++ in the sysroot, as la_version and la_objsearch do. The higher GLIBCXX version wins, the system one on a tie.
+ *    - shipped: DT_RUNPATH already finds it first. Only our entry of DT_AUDIT is dropped
+ *    - system:  the entries of DT_RUNPATH (or DT_RPATH) that hold libstdc++.so.6 are dropped, then our entry of DT_AUDIT.
+ *               This is only safe if those directories provide nothing else the executable needs
+ *  The edits keep the layout of the file: strings are shortened and padded with NUL, dynamic entries are deleted by moving
+ *  the next ones down. A string that the linker shares with another one is never rewritten. Anything unsafe leaves the
+ *  executable unchanged, and the audit library keeps deciding at run time. The edits are made to a copy next to the
+ *  executable, which is synced then renamed over it, so the executable is either the old or the new one, never a mix.
+ *
+ *  The report has one line per executable:
+ *    <path> shipped=<path>:<version> system=<path>:<version> choice=<shipped|system> [<dynamic tag>="<old>"->"<new>"]... status=<..>
+ */
+
+#ifndef AUDIT_LIBSTDCXX_LINKER_NAME
+#define AUDIT_LIBSTDCXX_LINKER_NAME "libaudit_libstdcxx.so"
+#endif
+#ifndef AUDIT_LIBSTDCXX_FREESTANDING_LINKER_NAME
+#define AUDIT_LIBSTDCXX_FREESTANDING_LINKER_NAME "libaudit_libstdcxx_freestanding.so"
+#endif
+
+// Directories searched by ld.so after ld.so.cache
+static const char* const default_system_dirs[] = {
+#if defined(__x86_64__)
+  "/lib/x86_64-linux-gnu",
+  "/usr/lib/x86_64-linux-gnu",
+#elif defined(__aarch64__)
+  "/lib/aarch64-linux-gnu",
+  "/usr/lib/aarch64-linux-gnu",
+#elif defined(__i386__)
+  "/lib/i386-linux-gnu",
+  "/usr/lib/i386-linux-gnu",
+#endif
+#if __ELF_NATIVE_CLASS == 64
+  "/lib64",
+  "/usr/lib64",
+#endif
+  "/lib",
+  "/usr/lib",
+};
+
+static const char* sysroot = "";
+static int dry_run = 0;
+static FILE* report = NULL;
+static int num_errors = 0;
+
+/**
+ * Edits decided for one executable. Dynamic entries are kept by index, as the edits are applied to a second, writable mapping
+ */
+typedef struct {
+  char shipped_path[PATH_MAX];
+  uint32_t shipped_glibcxx_version;
+  char system_path[PATH_MAX];
+  uint32_t system_glibcxx_version;
+  int use_system;
+  // DT_RUNPATH or DT_RPATH
+  long index_dt_path;
+  ElfW(Sxword) tag_dt_path;
+  char old_dt_path[PATH_MAX];
+  char new_dt_path[PATH_MAX];
+  long index_audit;
+  char old_audit[PATH_MAX];
+  char new_audit[PATH_MAX];
+  // Why the executable is left unchanged, or NULL
+  const char* reason;
+} relink_plan_t;
+
+typedef struct {
+  const char* ORIGIN;
+  int fd;
+  char host_path[PATH_MAX];
+} shipped_search_t;
+
+static error_code_t try_host_path(const char* const path, void* data) {
+  shipped_search_t* const search = (shipped_search_t*)data;
+  sysroot_host_path(sysroot, path, search->ORIGIN, search->host_path, sizeof(search->host_path));
+  return trypath(search->host_path, &search->fd);
+}
+
+/**
+ * Parse a libstdc++ candidate on the host
+ * @return error_code_t ec_success if it is a libstdc++ of this architecture
+ */
+static error_code_t libstdcxx_version_of(const char* const path, uint32_t* const glibcxx_version) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ec_fatal_error;
+  }
+  return get_libstdcxx_version(fd, path, glibcxx_version);
+}
+
+/**
+ * The system libstdc++ as ld.so finds it without the audit library: ld.so.cache of the sysroot, then the default directories
+ * @return error_code_t ec_success if the sysroot has a libstdc++ for this architecture
+ */
+static error_code_t find_system_libstdcxx(relink_plan_t* const plan) {
+  char cache_path[PATH_MAX];
+  char cached_path[PATH_MAX];
+  snprintf(cache_path, sizeof(cache_path), "%s%s", sysroot, ld_so_cache_path);
+  if (ec_success == find_system_libstdcxx_from_cache(cache_path, cached_path, sizeof(cached_path))) {
+    snprintf(plan->system_path, sizeof(plan->system_path), "%s%s", sysroot, cached_path);
+    if (ec_success == libstdcxx_version_of(plan->system_path, &plan->system_glibcxx_version)) {
+      return ec_success;
+    }
+  }
+  for (size_t i = 0; i < sizeof(default_system_dirs) / sizeof(default_system_dirs[0]); i++) {
+    snprintf(plan->system_path, sizeof(plan->system_path), "%s%s%s", sysroot, default_system_dirs[i], libstdcxx_rel_path);
+    if (ec_success == libstdcxx_version_of(plan->system_path, &plan->system_glibcxx_version)) {
+      return ec_success;
+    }
+  }
+  plan->system_path[0] = '\0';
+  return ec_non_fatal_error;
+}
+
+typedef struct {
+  const elf_image_t* image;
+  const char* ORIGIN;
+  int inherited;
+  const char* unsafe;
+} dt_path_prune_t;
+
+/**
+ * @return 1 if the directory holds a shared object other than libstdc++. DT_RPATH also applies to the dependencies
+ */
+static int directory_has_other_shared_objects(const char* const directory) {
+  DIR* const dir = opendir(directory);
+  if (NULL == dir) {
+    return 0;
+  }
+  int found = 0;
+  for (struct dirent* entry = readdir(dir); (NULL != entry) && !found; entry = readdir(dir)) {
+    found = (NULL != strstr(entry->d_name, ".so")) && (0 != strncmp(entry->d_name, "libstdc++.so", 12));
+  }
+  closedir(dir);
+  return found;
+}
+
+/**
+ * dt_path_filter callback. Drop the entries that hold a libstdc++.so.6, and record why dropping one is not safe
+ */
+static int drop_libstdcxx_directory(const char* const entry, const size_t len_entry, void* data) {
+  dt_path_prune_t* const prune = (dt_path_prune_t*)data;
+  char directory[PATH_MAX];
+  const size_t len_origin_token = dt_path_origin_length(entry, len_entry);
+  if (len_origin_token > 0) {
+    snprintf(directory, sizeof(directory), "%s%.*s", prune->ORIGIN, (int)(len_entry - len_origin_token), entry + len_origin_token);
+  } else {
+    snprintf(directory, sizeof(directory), "%.*s", (int)len_entry, entry);
+  }
+  char host_directory[PATH_MAX];
+  sysroot_host_path(sysroot, directory, prune->ORIGIN, host_directory, sizeof(host_directory));
+
+  char candidate[PATH_MAX];
+  if ((snprintf(candidate, sizeof(candidate), "%s%s", host_directory, libstdcxx_rel_path) >= (int)sizeof(candidate)) || (0 != access(candidate, F_OK))) {
+    return 0;
+  }
+
+  // The executable must not need anything else from this directory
+  for (const ElfW(Dyn)* dyn = prune->image->dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    if ((dyn->d_tag != DT_NEEDED) || (dyn->d_un.d_val >= prune->image->len_strtab)) {
+      continue;
+    }
+    const char* const needed = prune->image->strtab + dyn->d_un.d_val;
+    if (0 == strcmp(needed, libstdcxx_soname)) {
+      continue;
+    }
+    if ((snprintf(candidate, sizeof(candidate), "%s/%s", host_directory, needed) < (int)sizeof(candidate)) && (0 == access(candidate, F_OK))) {
+      prune->unsafe = "a directory with libstdc++ also provides other dependencies";
+    }
+  }
+  if (prune->inherited && directory_has_other_shared_objects(host_directory)) {
+    prune->unsafe = "DT_RPATH also serves the dependencies and a directory with libstdc++ holds other shared objects";
+  }
+  return 1;
+}
+
+/**
+ * @return 1 if `name`, of `len_name` bytes, is the file name of a build of the audit library, regular or freestanding
+ */
+static int is_audit_libstdcxx_name(const char* const name, const size_t len_name) {
+  static const char* const linker_names[] = {AUDIT_LIBSTDCXX_LINKER_NAME, AUDIT_LIBSTDCXX_FREESTANDING_LINKER_NAME};
+  for (size_t i = 0; i < (sizeof(linker_names) / sizeof(linker_names[0])); i++) {
+    const size_t len_linker_name = strlen(linker_names[i]);
+    if ((len_name >= len_linker_name) && (0 == strncmp(name, linker_names[i], len_linker_name))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * dt_path_filter callback. Drop the entries of DT_AUDIT that name our audit library
+ */
+static int drop_audit_libstdcxx(const char* const entry, const size_t len_entry, void* data) {
+  (void)data;
+  const char* basename_entry = entry;
+  for (size_t i = 0; i < len_entry; i++) {
+    if (entry[i] == '/') {
+      basename_entry = entry + i + 1;
+    }
+  }
+  const size_t len_basename = len_entry - (size_t)(basename_entry - entry);
+  return is_audit_libstdcxx_name(basename_entry, len_basename);
+}
+
+/**
+ * @return 1 if the executable needs libstdc++.so.6 itself
+ */
+static int needs_libstdcxx(const elf_image_t* const image) {
+  for (const ElfW(Dyn)* dyn = image->dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    if ((dyn->d_tag == DT_NEEDED) && (dyn->d_un.d_val < image->len_strtab) && (0 == strcmp(image->strtab + dyn->d_un.d_val, libstdcxx_soname))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Make the same decision as the audit library for the executable at `path`, and plan the edits that let ld.so make it alone
+ * @return error_code_t ec_success if the executable is concerned (the plan may still leave it unchanged), ec_non_fatal_error if not
+ */
+static error_code_t plan_relink(const char* const path, const elf_image_t* const image, relink_plan_t* const plan) {
+  memset(plan, 0, sizeof(*plan));
+  plan->index_dt_path = -1;
+  plan->index_audit = -1;
+
+  int has_interp = 0;
+  for (size_t i = 0; i < image->phnum; i++) {
+    has_interp |= (image->phdr[i].p_type == PT_INTERP);
+  }
+  if (!has_interp || (NULL == image->dynamic) || !needs_libstdcxx(image)) {
+    return ec_non_fatal_error;
+  }
+
+  const char no_path = '\0';
+  const char* dt_runpath = &no_path;
+  const char* dt_rpath = &no_path;
+  get_runpath_rpath(image->phdr, image->phnum, image->base, &dt_runpath, &dt_rpath);
+
+  char real_path[PATH_MAX];
+  if (NULL == realpath(path, real_path)) {
+    plan->reason = "cannot resolve the path of the executable";
+    return ec_success;
+  }
+  const char* const ORIGIN = dirname(real_path);
+
+  // The shipped libstdc++, in DT_RUNPATH then DT_RPATH like la_version
+  shipped_search_t search;
+  search.ORIGIN = ORIGIN;
+  search.fd = -1;
+  char* found_path = NULL;
+  size_t len_found_path_buffer = 0;
+  error_code_t found = ec_fatal_error;
+  if (dt_runpath[0] != '\0') {
+    found = find_libstdcxx_from_dt_path(dt_runpath, ORIGIN, &try_host_path, &search, &found_path, &len_found_path_buffer);
+  }
+  if (ec_success != found) {
+    found = find_libstdcxx_from_dt_path(dt_rpath, ORIGIN, &try_host_path, &search, &found_path, &len_found_path_buffer);
+  }
+  path_arena_free(found_path, len_found_path_buffer);
+  if (ec_success != found) {
+    plan->reason = "no shipped libstdc++ in DT_RUNPATH/DT_RPATH";
+    return ec_success;
+  }
+  snprintf(plan->shipped_path, sizeof(plan->shipped_path), "%s", search.host_path);
+  if (ec_success != get_libstdcxx_version(search.fd, plan->shipped_path, &plan->shipped_glibcxx_version)) {
+    plan->reason = "cannot read the version of the shipped libstdc++";
+    return ec_success;
+  }
+
+  // Same rule as la_objsearch: the system libstdc++ wins unless it is older
+  plan->use_system = (ec_success == find_system_libstdcxx(plan)) && (plan->system_glibcxx_version >= plan->shipped_glibcxx_version);
+
+  if (plan->use_system) {
+    // DT_RPATH is ignored when there is a DT_RUNPATH
+    plan->tag_dt_path = (dt_runpath[0] != '\0') ? DT_RUNPATH : DT_RPATH;
+    const ElfW(Dyn)* const dyn = elf_image_find_dynamic(image, plan->tag_dt_path);
+    plan->index_dt_path = dyn - image->dynamic;
+    snprintf(plan->old_dt_path, sizeof(plan->old_dt_path), "%s", image->strtab + dyn->d_un.d_val);
+
+    dt_path_prune_t prune = {image, ORIGIN, plan->tag_dt_path == DT_RPATH, NULL};
+    const int dropped = dt_path_filter(plan->old_dt_path, &drop_libstdcxx_directory, &prune, plan->new_dt_path, sizeof(plan->new_dt_path));
+    if (dropped == 0) {
+      plan->index_dt_path = -1;
+    } else if (dropped < 0) {
+      plan->reason = "DT_RUNPATH/DT_RPATH is too long";
+    } else if (prune.unsafe) {
+      plan->reason = prune.unsafe;
+    } else if ((plan->new_dt_path[0] == '\0') && (plan->tag_dt_path == DT_RUNPATH) && (dt_rpath[0] != '\0')) {
+      plan->reason = "removing DT_RUNPATH would enable DT_RPATH";
+    } else if ((plan->new_dt_path[0] != '\0') && elf_image_string_is_shared(image, dyn)) {
+      plan->reason = "the DT_RUNPATH/DT_RPATH string is shared";
+    }
+  }
+
+  const ElfW(Dyn)* const audit = elf_image_find_dynamic(image, DT_AUDIT);
+  if ((NULL == plan->reason) && (NULL != audit) && (audit->d_un.d_val < image->len_strtab)) {
+    snprintf(plan->old_audit, sizeof(plan->old_audit), "%s", image->strtab + audit->d_un.d_val);
+    const int dropped = dt_path_filter(plan->old_audit, &drop_audit_libstdcxx, NULL, plan->new_audit, sizeof(plan->new_audit));
+    if (dropped < 0) {
+      plan->reason = "DT_AUDIT is too long";
+    } else if (dropped > 0) {
+      plan->index_audit = audit - image->dynamic;
+      if ((plan->new_audit[0] != '\0') && elf_image_string_is_shared(image, audit)) {
+        plan->reason = "the DT_AUDIT string is shared";
+      }
+    }
+  }
+  if (NULL != plan->reason) {
+    plan->index_dt_path = -1;
+    plan->index_audit = -1;
+  }
+  return ec_success;
+}
+
+/**
+ * Copy the file at `path`, whose stat is `st`, to a new file next to it with the same owner and mode
+ * @return the file descriptor of the copy, whose path is written to `copy_path`, or -1
+ */
+static int copy_beside(const char* const path, const struct stat* const st, char* const copy_path, const size_t len_copy_path) {
+  if (snprintf(copy_path, len_copy_path, "%s.relink.XXXXXX", path) >= (int)len_copy_path) {
+    return -1;
+  }
+  const int fd_copy = mkostemp(copy_path, O_CLOEXEC);
+  if (fd_copy < 0) {
+    return -1;
+  }
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  int copied = (fd >= 0);
+  char buffer[1 << 16];
+  for (ssize_t len = copied ? read(fd, buffer, sizeof(buffer)) : 0; copied && (len != 0); len = read(fd, buffer, sizeof(buffer))) {
+    copied = (len > 0) && (write(fd_copy, buffer, (size_t)len) == len);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  // Only root may give the copy away. chown clears the set-user-ID and set-group-ID bits, so the mode comes last
+  if (0 != fchown(fd_copy, st->st_uid, st->st_gid)) {
+    copied = copied && (st->st_uid == geteuid());
+  }
+  if (!copied || (0 != fchmod(fd_copy, st->st_mode & 07777))) {
+    close(fd_copy);
+    unlink(copy_path);
+    return -1;
+  }
+  return fd_copy;
+}
+
+/**
+ * Apply the plan to a writable mapping of a copy of the executable, then replace the executable with the copy
+ * @return error_code_t
+ */
+static error_code_t apply_relink(const char* const path, const struct stat* const st, const relink_plan_t* const plan) {
+  char copy_path[PATH_MAX];
+  const int fd_copy = copy_beside(path, st, copy_path, sizeof(copy_path));
+  if (fd_copy < 0) {
+    return ec_fatal_error;
+  }
+  elf_image_t image;
+  const error_code_t error = elf_image_map(copy_path, 1, &image);
+  if ((ec_success != error) || (NULL == image.dynamic)) {
+    elf_image_unmap(&image);
+    close(fd_copy);
+    unlink(copy_path);
+    return ec_fatal_error;
+  }
+  // Entries are deleted from the highest index down, so the lower index stays valid
+  const long first = (plan->index_dt_path > plan->index_audit) ? plan->index_dt_path : plan->index_audit;
+  const long second = (plan->index_dt_path > plan->index_audit) ? plan->index_audit : plan->index_dt_path;
+  const long indexes[2] = {first, second};
+  for (size_t i = 0; i < 2; i++) {
+    if (indexes[i] < 0) {
+      continue;
+    }
+    ElfW(Dyn)* const dyn = image.dynamic + indexes[i];
+    const char* const value = (indexes[i] == plan->index_audit) ? plan->new_audit : plan->new_dt_path;
+    if (value[0] == '\0') {
+      elf_image_remove_dynamic(&image, dyn);
+    } else {
+      elf_image_rewrite_string(&image, dyn, value);
+    }
+  }
+  elf_image_unmap(&image);
+
+  // The copy is on disk before it takes the name of the executable, and the rename is on disk before we report it
+  const int synced = (0 == fsync(fd_copy));
+  close(fd_copy);
+  if (!synced || (0 != rename(copy_path, path))) {
+    unlink(copy_path);
+    return ec_fatal_error;
+  }
+  char directory[PATH_MAX];
+  snprintf(directory, sizeof(directory), "%s", path);
+  const int fd_directory = open(dirname(directory), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd_directory >= 0) {
+    fsync(fd_directory);
+    close(fd_directory);
+  }
+  return ec_success;
+}
+
+static void report_plan(const char* const path, const relink_plan_t* const plan, const char* const status) {
+  fprintf(report, "%s", path);
+  if (plan->shipped_path[0] != '\0') {
+    fprintf(report, " shipped=%s:%08x", plan->shipped_path, plan->shipped_glibcxx_version);
+  }
+  if (plan->system_path[0] != '\0') {
+    fprintf(report, " system=%s:%08x", plan->system_path, plan->system_glibcxx_version);
+  }
+  fprintf(report, " choice=%s", plan->use_system ? "system" : "shipped");
+  if (plan->index_dt_path >= 0) {
+    fprintf(report, " %s=\"%s\"->\"%s\"", (plan->tag_dt_path == DT_RUNPATH) ? "DT_RUNPATH" : "DT_RPATH", plan->old_dt_path, plan->new_dt_path);
+  }
+  if (plan->index_audit >= 0) {
+    fprintf(report, " DT_AUDIT=\"%s\"->\"%s\"", plan->old_audit, plan->new_audit);
+  }
+  if (NULL != plan->reason) {
+    fprintf(report, " status=unchanged (%s)\n", plan->reason);
+  } else {
+    fprintf(report, " status=%s\n", status);
+  }
+}
+
+static int relink_file(const char* const path, const struct stat* const st, const int type, struct FTW* const ftw) {
+  (void)ftw;
+  // Only regular files with an execute bit can be executables
+  if ((type != FTW_F) || !S_ISREG(st->st_mode) || !(st->st_mode & (S_IXUSR | S_IXGRP | S_IXOTH))) {
+    return 0;
+  }
+  elf_image_t image;
+  error_code_t error = elf_image_map(path, 0, &image);
+  if (ec_success != error) {
+    if (error <= ec_fatal_error) {
+      ERROR("Cannot read %s\n", path);
+      num_errors++;
+    }
+    return 0;
+  }
+  relink_plan_t plan;
+  error = plan_relink(path, &image, &plan);
+  elf_image_unmap(&image);
+  if (ec_success != error) {
+    return 0;
+  }
+
+  const int has_edits = (plan.index_dt_path >= 0) || (plan.index_audit >= 0);
+  const char* status = has_edits ? (dry_run ? "would relink" : "relinked") : "nothing to do";
+  if (has_edits && !dry_run && (ec_success != apply_relink(path, st, &plan))) {
+    ERROR("Cannot rewrite %s\n", path);
+    num_errors++;
+    status = "failed";
+  }
+  report_plan(path, &plan, status);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  const char* report_path = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "ns:r:")) != -1) {
+    switch (opt) {
+      case 'n':
+        dry_run = 1;
+        break;
+      case 's':
+        sysroot = optarg;
+        break;
+      case 'r':
+        report_path = optarg;
+        break;
+      default:
+        ASSERT(0, "Usage: %s [-n] [-s sysroot] [-r report] <installed tree or executable>...\n", argv[0]);
+    }
+  }
+  ASSERT(optind < argc, "Usage: %s [-n] [-s sysroot] [-r report] <installed tree or executable>...\n", argv[0]);
+
+  // The sysroot is a prefix of absolute paths: "/" is no prefix at all
+  static char sysroot_storage[PATH_MAX];
+  snprintf(sysroot_storage, sizeof(sysroot_storage), "%s", sysroot);
+  for (size_t len = strlen(sysroot_storage); (len > 0) && (sysroot_storage[len - 1] == '/'); len--) {
+    sysroot_storage[len - 1] = '\0';
+  }
+  sysroot = sysroot_storage;
+
+  report = stdout;
+  if (report_path) {
+    report = fopen(report_path, "w");
+    ASSERT(report, "Cannot write %s\n", report_path);
+  }
+
+  for (int i = optind; i < argc; i++) {
+    if (0 != nftw(argv[i], &relink_file, 16, FTW_PHYS)) {
+      ERROR("Cannot walk %s\n", argv[i]);
+      num_errors++;
+    }
+  }
+
+  if (report != stdout) {
+    ASSERT(fclose(report) == 0, "Cannot write %s\n", report_path);
+  }
+  return (num_errors > 0) ? 1 : 0;
+}
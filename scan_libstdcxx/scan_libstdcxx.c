@@ -0,0 +1,691 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <ftw.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Every worker thread searches with its own path arena
+#define PATH_ARENA_STORAGE static __thread
+
+#include "find_libstdcxx.h"
+#include "get_libstdcxx_version.h"
+#include "macros.h"
+
+/**
+ *  Inventory of the libstdc++ every ELF file of an installed tree ends up with, on one or more target systems,
+ *  without running anything. A fast, offline replacement for running `ldd` on each file of a large tree.
+ *
+ *  Usage: scan_libstdcxx [-s sysroot]... [-L ld_library_path] [-j threads] [-r report] <installed tree or file>...
+ *    -s sysroot          Root of a target system. May be repeated, one result per target (default /)
+ *    -L ld_library_path  LD_LIBRARY_PATH to simulate, as paths of the target system
+ *    -j threads          Number of worker threads (default: number of CPUs)
+ *    -r report           Write the report to this file instead of stdout
+ *
+ *  Every ELF file of the native class is mapped (see elf_image.h) and its dependencies are loaded breadth first like
+ *  ld.so does, until one of them needs libstdc++.so.6. Each dependency is searched in the order of ld.so:
+ *  DT_RPATH of the requester and its loaders (without DT_RUNPATH), LD_LIBRARY_PATH, DT_RUNPATH, ld.so.cache, default directories.
+ *  An executable whose DT_AUDIT names the audit library, which exists in the tree, gets the policy of the audit library:
+ *  the shipped libstdc++ of its DT_RUNPATH/DT_RPATH against the first libstdc++ found outside of them, the higher GLIBCXX wins.
+ *
+ *  The report has one line per ELF file, with one field group per target, in the order of the file walk:
+ *    <path> <exe|dso> target=<sysroot> libstdcxx=<path>:<version>|none|unresolved requested_by=<soname> policy=<ld.so|audit:shipped|audit:system>
+ */
+
+#ifndef AUDIT_LIBSTDCXX_LINKER_NAME
+#define AUDIT_LIBSTDCXX_LINKER_NAME "libaudit_libstdcxx.so"
+#endif
+#ifndef AUDIT_LIBSTDCXX_FREESTANDING_LINKER_NAME
+#define AUDIT_LIBSTDCXX_FREESTANDING_LINKER_NAME "libaudit_libstdcxx_freestanding.so"
+#endif
+
+#define MAX_TARGETS 16
+#define MAX_OBJECTS 512
+#define VERSION_MEMO_SIZE 64
+#define REPORT_LINE_SIZE 2048
+
+// Directories searched by ld.so after ld.so.cache
+static const char* const default_system_dirs[] = {
+#if defined(__x86_64__)
+  "/lib/x86_64-linux-gnu",
+  "/usr/lib/x86_64-linux-gnu",
+#elif defined(__aarch64__)
+  "/lib/aarch64-linux-gnu",
+  "/usr/lib/aarch64-linux-gnu",
+#elif defined(__i386__)
+  "/lib/i386-linux-gnu",
+  "/usr/lib/i386-linux-gnu",
+#endif
+#if __ELF_NATIVE_CLASS == 64
+  "/lib64",
+  "/usr/lib64",
+#endif
+  "/lib",
+  "/usr/lib",
+};
+
+/**
+ * A target system, with its ld.so.cache mapped once for all threads
+ */
+typedef struct {
+  char sysroot[PATH_MAX];
+  const char* cache;
+  size_t cache_size;
+} target_t;
+
+static target_t targets[MAX_TARGETS];
+static size_t num_targets = 0;
+static const char* ld_library_path = "";
+static ElfW(Half) host_machine = EM_NONE;
+
+// The files to scan and their report lines. Workers take the next file with an atomic increment
+static char** files = NULL;
+static size_t num_files = 0;
+static size_t capacity_files = 0;
+static size_t next_file = 0;
+static char** report_lines = NULL;
+
+/**
+ * GLIBCXX versions of the libstdc++ files already parsed, shared by the workers. Most of the tree resolves to the same few
+ */
+typedef struct {
+  dev_t dev;
+  ino_t ino;
+  uint32_t glibcxx_version;
+  error_code_t error;
+} version_memo_entry_t;
+
+static version_memo_entry_t version_memo[VERSION_MEMO_SIZE];
+static size_t version_memo_inserts = 0;
+static pthread_mutex_t version_memo_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @return error_code_t of get_libstdcxx_version for the libstdc++ at `path`
+ */
+static error_code_t memoized_libstdcxx_version(const char* const path, uint32_t* const glibcxx_version) {
+  struct stat st;
+  if (0 != stat(path, &st)) {
+    return ec_fatal_error;
+  }
+  pthread_mutex_lock(&version_memo_mutex);
+  const size_t num_entries = (version_memo_inserts < VERSION_MEMO_SIZE) ? version_memo_inserts : VERSION_MEMO_SIZE;
+  for (size_t i = 0; i < num_entries; i++) {
+    if ((version_memo[i].dev == st.st_dev) && (version_memo[i].ino == st.st_ino)) {
+      const error_code_t error = version_memo[i].error;
+      *glibcxx_version = version_memo[i].glibcxx_version;
+      pthread_mutex_unlock(&version_memo_mutex);
+      return error;
+    }
+  }
+  pthread_mutex_unlock(&version_memo_mutex);
+
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ec_fatal_error;
+  }
+  const error_code_t error = get_libstdcxx_version(fd, path, glibcxx_version);
+
+  pthread_mutex_lock(&version_memo_mutex);
+  version_memo_entry_t* const entry = &version_memo[version_memo_inserts % VERSION_MEMO_SIZE];
+  entry->dev = st.st_dev;
+  entry->ino = st.st_ino;
+  entry->glibcxx_version = *glibcxx_version;
+  entry->error = error;
+  version_memo_inserts++;
+  pthread_mutex_unlock(&version_memo_mutex);
+  return error;
+}
+
+/**
+ * ld.so skips candidates that are not ELF files of its class and machine
+ * @return 1 if the file at `path` could be loaded
+ */
+static int is_loadable(const char* const path) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+  ElfW(Ehdr) ehdr;
+  const ssize_t len = pread(fd, &ehdr, sizeof(ehdr), 0);
+  close(fd);
+  return (len == (ssize_t)sizeof(ehdr)) && (0 == memcmp(ehdr.e_ident, ELFMAG, SELFMAG)) && (ehdr.e_ident[EI_CLASS] == ELF_IMAGE_NATIVE_CLASS) &&
+         (ehdr.e_machine == host_machine);
+}
+
+/**
+ * An object of the simulated link map
+ */
+typedef struct {
+  elf_image_t image;
+  char host_path[PATH_MAX];
+  // Host directory of the object, for $ORIGIN
+  char ORIGIN[PATH_MAX];
+  const char* dt_runpath;
+  const char* dt_rpath;
+  // Name the object was requested as
+  const char* name;
+  int parent;
+} object_t;
+
+// Search order of ld.so. The audit library sees the DT_RPATH and DT_RUNPATH phases as LA_SER_RUNPATH
+typedef enum { phase_rpath, phase_libpath, phase_runpath, phase_cache, phase_default, phase_none } search_phase_t;
+
+/**
+ * Decides whether a loadable candidate is taken. This is where the audit policy rejects candidates
+ */
+typedef int (*accept_callback_t)(const char* const host_path, void* data);
+
+typedef struct {
+  const target_t* target;
+  const char* name;
+  const char* ORIGIN;
+  accept_callback_t accept;
+  void* accept_data;
+  char host_path[PATH_MAX];
+} dt_search_t;
+
+/**
+ * find_name_from_dt_path callback. Tries the candidate <directory>/<name> on the target
+ */
+static error_code_t try_name(const char* const path, void* data) {
+  dt_search_t* const search = (dt_search_t*)data;
+  sysroot_host_path(search->target->sysroot, path, search->ORIGIN, search->host_path, sizeof(search->host_path));
+  if (!is_loadable(search->host_path)) {
+    return ec_fatal_error;
+  }
+  return ((NULL == search->accept) || search->accept(search->host_path, search->accept_data)) ? ec_success : ec_fatal_error;
+}
+
+static int search_dt_path(dt_search_t* const search, const char* const dt_path) {
+  if ((NULL == dt_path) || (dt_path[0] == '\0')) {
+    return 0;
+  }
+  char* found_path = NULL;
+  size_t len_found_path_buffer = 0;
+  const error_code_t found = find_name_from_dt_path(dt_path, search->name, search->ORIGIN, &try_name, search, &found_path, &len_found_path_buffer);
+  path_arena_free(found_path, len_found_path_buffer);
+  return ec_success == found;
+}
+
+static int try_system_path(dt_search_t* const search, const char* const path) {
+  snprintf(search->host_path, sizeof(search->host_path), "%s%s", search->target->sysroot, path);
+  return is_loadable(search->host_path) && ((NULL == search->accept) || search->accept(search->host_path, search->accept_data));
+}
+
+/**
+ * Search `name` for the object `requester` in the order of ld.so. With `skip_dt_paths`, the DT_RPATH and DT_RUNPATH
+ * candidates are rejected, as the audit library does for libstdc++
+ * @return the phase of the hit, whose host path is in search->host_path, or phase_none
+ */
+static search_phase_t search_needed(const object_t* const objects, const int requester, const int skip_dt_paths, dt_search_t* const search) {
+  const object_t* const object = &objects[requester];
+  // A name with a slash is opened as is, after $ORIGIN or ${ORIGIN} is replaced by the directory of the requester
+  if (NULL != strchr(search->name, '/')) {
+    char path[PATH_MAX];
+    const size_t len_origin_token = dt_path_origin_length(search->name, strlen(search->name));
+    if (snprintf(path, sizeof(path), "%s%s", (len_origin_token > 0) ? object->ORIGIN : "", search->name + len_origin_token) >= (int)sizeof(path)) {
+      return phase_none;
+    }
+    sysroot_host_path(search->target->sysroot, path, object->ORIGIN, search->host_path, sizeof(search->host_path));
+    return is_loadable(search->host_path) ? phase_default : phase_none;
+  }
+
+  // DT_RPATH of the requester, then of its loaders, unless the requester has a DT_RUNPATH. Objects with a DT_RUNPATH contribute none
+  if (!skip_dt_paths && (object->dt_runpath[0] == '\0')) {
+    for (int loader = requester; loader >= 0; loader = objects[loader].parent) {
+      if (objects[loader].dt_runpath[0] != '\0') {
+        continue;
+      }
+      search->ORIGIN = objects[loader].ORIGIN;
+      if (search_dt_path(search, objects[loader].dt_rpath)) {
+        return phase_rpath;
+      }
+    }
+  }
+
+  // $ORIGIN in LD_LIBRARY_PATH is the directory of the executable
+  search->ORIGIN = objects[0].ORIGIN;
+  if (search_dt_path(search, ld_library_path)) {
+    return phase_libpath;
+  }
+
+  search->ORIGIN = object->ORIGIN;
+  if (!skip_dt_paths && search_dt_path(search, object->dt_runpath)) {
+    return phase_runpath;
+  }
+
+  const char* cached_path = NULL;
+  if (search->target->cache && (ec_success == ld_so_cache_lookup(search->target->cache, search->target->cache_size, search->name, &cached_path)) &&
+      try_system_path(search, cached_path)) {
+    return phase_cache;
+  }
+
+  for (size_t i = 0; i < sizeof(default_system_dirs) / sizeof(default_system_dirs[0]); i++) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", default_system_dirs[i], search->name);
+    if (try_system_path(search, path)) {
+      return phase_default;
+    }
+  }
+  return phase_none;
+}
+
+/**
+ * la_objsearch ignores a libstdc++ whose version cannot be read because of its architecture
+ */
+static int accept_libstdcxx(const char* const host_path, void* data) {
+  (void)data;
+  uint32_t glibcxx_version = 0;
+  return ec_non_fatal_error != memoized_libstdcxx_version(host_path, &glibcxx_version);
+}
+
+/**
+ * @return 1 if `name`, of `len_name` bytes, is the file name of a build of the audit library, regular or freestanding
+ */
+static int is_audit_libstdcxx_name(const char* const name, const size_t len_name) {
+  static const char* const linker_names[] = {AUDIT_LIBSTDCXX_LINKER_NAME, AUDIT_LIBSTDCXX_FREESTANDING_LINKER_NAME};
+  for (size_t i = 0; i < (sizeof(linker_names) / sizeof(linker_names[0])); i++) {
+    const size_t len_linker_name = strlen(linker_names[i]);
+    if ((len_name >= len_linker_name) && (0 == strncmp(name, linker_names[i], len_linker_name))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+typedef struct {
+  int audited;
+  const char* target_ORIGIN;
+  const target_t* target;
+} audit_probe_t;
+
+/**
+ * dt_path_filter callback. Records whether DT_AUDIT names the audit library and whether ld.so will find it
+ */
+static int probe_audit_entry(const char* const entry, const size_t len_entry, void* data) {
+  audit_probe_t* const probe = (audit_probe_t*)data;
+  const char* basename_entry = entry;
+  for (size_t i = 0; i < len_entry; i++) {
+    if (entry[i] == '/') {
+      basename_entry = entry + i + 1;
+    }
+  }
+  const size_t len_basename = len_entry - (size_t)(basename_entry - entry);
+  if (!is_audit_libstdcxx_name(basename_entry, len_basename)) {
+    return 0;
+  }
+  char path[PATH_MAX];
+  const size_t len_origin_token = dt_path_origin_length(entry, len_entry);
+  if (len_origin_token > 0) {
+    snprintf(path, sizeof(path), "%s%.*s", probe->target_ORIGIN, (int)(len_entry - len_origin_token), entry + len_origin_token);
+  } else {
+    snprintf(path, sizeof(path), "%.*s", (int)len_entry, entry);
+  }
+  char host_path[PATH_MAX];
+  sysroot_host_path(probe->target->sysroot, path, probe->target_ORIGIN, host_path, sizeof(host_path));
+  probe->audited |= is_loadable(host_path);
+  return 0;
+}
+
+/**
+ * Outcome of the simulation of one file on one target
+ */
+typedef struct {
+  char libstdcxx[PATH_MAX];
+  uint32_t glibcxx_version;
+  // Copied, the objects of the link map are unmapped after the simulation
+  char requested_by[NAME_MAX + 1];
+  const char* policy;
+  int needed;
+} scan_result_t;
+
+/**
+ * Resolve libstdc++.so.6 for the object `requester`, with the policy of the audit library if the executable uses it
+ */
+static void resolve_libstdcxx(const object_t* const objects, const int requester, const target_t* const target, scan_result_t* const result) {
+  dt_search_t search;
+  memset(&search, 0, sizeof(search));
+  search.target = target;
+  search.name = libstdcxx_soname;
+  result->needed = 1;
+  snprintf(result->requested_by, sizeof(result->requested_by), "%s", (requester == 0) ? "self" : objects[requester].name);
+  result->policy = "ld.so";
+
+  const object_t* const executable = &objects[0];
+  audit_probe_t probe = {0, executable->ORIGIN, target};
+  const ElfW(Dyn)* const audit = elf_image_find_dynamic(&executable->image, DT_AUDIT);
+  if (audit && (audit->d_un.d_val < executable->image.len_strtab)) {
+    char unused[PATH_MAX];
+    dt_path_filter(executable->image.strtab + audit->d_un.d_val, &probe_audit_entry, &probe, unused, sizeof(unused));
+  }
+
+  // la_version: the shipped libstdc++ is the first in DT_RUNPATH, then DT_RPATH of the executable
+  uint32_t shipped_glibcxx_version = 0;
+  char shipped_path[PATH_MAX] = "";
+  if (probe.audited) {
+    search.ORIGIN = executable->ORIGIN;
+    if ((search_dt_path(&search, executable->dt_runpath) || search_dt_path(&search, executable->dt_rpath)) &&
+        (ec_success == memoized_libstdcxx_version(search.host_path, &shipped_glibcxx_version))) {
+      snprintf(shipped_path, sizeof(shipped_path), "%s", search.host_path);
+    }
+  }
+
+  if (shipped_path[0] == '\0') {
+    // Without the audit library, or when it does not find the shipped libstdc++, ld.so decides alone
+    if (phase_none == search_needed(objects, requester, 0, &search)) {
+      snprintf(result->libstdcxx, sizeof(result->libstdcxx), "unresolved");
+      return;
+    }
+    snprintf(result->libstdcxx, sizeof(result->libstdcxx), "%s", search.host_path);
+    memoized_libstdcxx_version(search.host_path, &result->glibcxx_version);
+    return;
+  }
+
+  // la_objsearch: the first libstdc++ outside of DT_RUNPATH/DT_RPATH is compared with the shipped one
+  search.accept = &accept_libstdcxx;
+  uint32_t system_glibcxx_version = 0;
+  if ((phase_none == search_needed(objects, requester, 1, &search)) ||
+      (memoized_libstdcxx_version(search.host_path, &system_glibcxx_version) <= ec_fatal_error) ||
+      (system_glibcxx_version < shipped_glibcxx_version)) {
+    snprintf(result->libstdcxx, sizeof(result->libstdcxx), "%s", shipped_path);
+    result->glibcxx_version = shipped_glibcxx_version;
+    result->policy = "audit:shipped";
+  } else {
+    snprintf(result->libstdcxx, sizeof(result->libstdcxx), "%s", search.host_path);
+    result->glibcxx_version = system_glibcxx_version;
+    result->policy = "audit:system";
+  }
+}
+
+/**
+ * Add an object to the simulated link map
+ * @return error_code_t ec_success if it is a dynamic ELF file of the native class
+ */
+static error_code_t load_object(object_t* const object, const char* const host_path, const char* const name, const int parent) {
+  if (ec_success != elf_image_map(host_path, 0, &object->image)) {
+    return ec_fatal_error;
+  }
+  if (NULL == object->image.dynamic) {
+    elf_image_unmap(&object->image);
+    return ec_non_fatal_error;
+  }
+  static const char no_path = '\0';
+  object->dt_runpath = &no_path;
+  object->dt_rpath = &no_path;
+  get_runpath_rpath(object->image.phdr, object->image.phnum, object->image.base, &object->dt_runpath, &object->dt_rpath);
+  snprintf(object->host_path, sizeof(object->host_path), "%s", host_path);
+  char real_path[PATH_MAX];
+  if (NULL == realpath(host_path, real_path)) {
+    snprintf(real_path, sizeof(real_path), "%s", host_path);
+  }
+  snprintf(object->ORIGIN, sizeof(object->ORIGIN), "%s", dirname(real_path));
+  object->name = name;
+  object->parent = parent;
+  return ec_success;
+}
+
+/**
+ * @return 1 if an object of the link map was requested as, or has the soname, `name`, or is the file at `host_path`
+ */
+static int is_loaded(const object_t* const objects, const size_t num_objects, const char* const name, const char* const host_path) {
+  for (size_t i = 0; i < num_objects; i++) {
+    if (name && objects[i].name && (0 == strcmp(objects[i].name, name))) {
+      return 1;
+    }
+    const ElfW(Dyn)* const soname = elf_image_find_dynamic(&objects[i].image, DT_SONAME);
+    if (name && soname && (soname->d_un.d_val < objects[i].image.len_strtab) && (0 == strcmp(objects[i].image.strtab + soname->d_un.d_val, name))) {
+      return 1;
+    }
+    if (host_path && (0 == strcmp(objects[i].host_path, host_path))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Load the dependencies of the file breadth first, like ld.so, until one of them needs libstdc++
+ */
+static void scan_target(object_t* const objects, const char* const path, const target_t* const target, scan_result_t* const result) {
+  memset(result, 0, sizeof(*result));
+  snprintf(result->libstdcxx, sizeof(result->libstdcxx), "none");
+  snprintf(result->requested_by, sizeof(result->requested_by), "none");
+  result->policy = "ld.so";
+  if (ec_success != load_object(&objects[0], path, NULL, -1)) {
+    return;
+  }
+  size_t num_objects = 1;
+  for (size_t i = 0; (i < num_objects) && !result->needed; i++) {
+    const elf_image_t* const image = &objects[i].image;
+    for (const ElfW(Dyn)* dyn = image->dynamic; (dyn->d_tag != DT_NULL) && !result->needed; dyn++) {
+      if ((dyn->d_tag != DT_NEEDED) || (dyn->d_un.d_val >= image->len_strtab)) {
+        continue;
+      }
+      const char* const name = image->strtab + dyn->d_un.d_val;
+      if (0 == strcmp(name, libstdcxx_soname)) {
+        resolve_libstdcxx(objects, (int)i, target, result);
+        break;
+      }
+      if ((num_objects >= MAX_OBJECTS) || is_loaded(objects, num_objects, name, NULL)) {
+        continue;
+      }
+      dt_search_t search;
+      memset(&search, 0, sizeof(search));
+      search.target = target;
+      search.name = name;
+      if ((phase_none != search_needed(objects, (int)i, 0, &search)) && !is_loaded(objects, num_objects, NULL, search.host_path) &&
+          (ec_success == load_object(&objects[num_objects], search.host_path, name, (int)i))) {
+        num_objects++;
+      }
+    }
+  }
+  for (size_t i = 0; i < num_objects; i++) {
+    elf_image_unmap(&objects[i].image);
+  }
+}
+
+/**
+ * Simulate one file on every target
+ * @return the report line, or NULL if the file is not a dynamic ELF file of the native class
+ */
+static char* scan_file(object_t* const objects, const char* const path) {
+  if (!is_loadable(path)) {
+    return NULL;
+  }
+  elf_image_t image;
+  if (ec_success != elf_image_map(path, 0, &image)) {
+    return NULL;
+  }
+  int has_interp = 0;
+  for (size_t i = 0; i < image.phnum; i++) {
+    has_interp |= (image.phdr[i].p_type == PT_INTERP);
+  }
+  const int is_dynamic = (NULL != image.dynamic);
+  elf_image_unmap(&image);
+  if (!is_dynamic) {
+    return NULL;
+  }
+
+  char line[REPORT_LINE_SIZE * MAX_TARGETS];
+  size_t len = (size_t)snprintf(line, sizeof(line), "%s %s", path, has_interp ? "exe" : "dso");
+  for (size_t t = 0; (t < num_targets) && (len < sizeof(line)); t++) {
+    scan_result_t result;
+    scan_target(objects, path, &targets[t], &result);
+    if (result.glibcxx_version) {
+      len += (size_t)snprintf(line + len, sizeof(line) - len, " target=%s libstdcxx=%s:%08x requested_by=%s policy=%s",
+                              (targets[t].sysroot[0] != '\0') ? targets[t].sysroot : "/", result.libstdcxx, result.glibcxx_version,
+                              result.requested_by, result.policy);
+    } else {
+      len += (size_t)snprintf(line + len, sizeof(line) - len, " target=%s libstdcxx=%s requested_by=%s policy=%s",
+                              (targets[t].sysroot[0] != '\0') ? targets[t].sysroot : "/", result.libstdcxx, result.requested_by, result.policy);
+    }
+  }
+  return strdup(line);
+}
+
+static void* scan_worker(void* arg) {
+  (void)arg;
+  object_t* const objects = (object_t*)calloc(MAX_OBJECTS, sizeof(object_t));
+  ASSERT(objects, "Out of memory\n");
+  for (size_t i = __atomic_fetch_add(&next_file, 1, __ATOMIC_RELAXED); i < num_files; i = __atomic_fetch_add(&next_file, 1, __ATOMIC_RELAXED)) {
+    report_lines[i] = scan_file(objects, files[i]);
+  }
+  free(objects);
+  return NULL;
+}
+
+static int collect_file(const char* const path, const struct stat* const st, const int type, struct FTW* const ftw) {
+  (void)ftw;
+  if ((type != FTW_F) || !S_ISREG(st->st_mode) || ((size_t)st->st_size < sizeof(ElfW(Ehdr)))) {
+    return 0;
+  }
+  if (num_files == capacity_files) {
+    capacity_files = capacity_files ? (2 * capacity_files) : 4096;
+    files = (char**)realloc(files, capacity_files * sizeof(char*));
+    ASSERT(files, "Out of memory\n");
+  }
+  files[num_files] = strdup(path);
+  ASSERT(files[num_files], "Out of memory\n");
+  num_files++;
+  return 0;
+}
+
+static void add_target(const char* const sysroot) {
+  ASSERT(num_targets < MAX_TARGETS, "Too many -s targets\n");
+  target_t* const target = &targets[num_targets++];
+  // The sysroot is a prefix of absolute paths: "/" is no prefix at all
+  snprintf(target->sysroot, sizeof(target->sysroot), "%s", sysroot);
+  for (size_t len = strlen(target->sysroot); (len > 0) && (target->sysroot[len - 1] == '/'); len--) {
+    target->sysroot[len - 1] = '\0';
+  }
+  char cache_path[PATH_MAX];
+  target->cache = NULL;
+  const int fd = (snprintf(cache_path, sizeof(cache_path), "%s%s", target->sysroot, ld_so_cache_path) < (int)sizeof(cache_path))
+                   ? open(cache_path, O_RDONLY | O_CLOEXEC)
+                   : -1;
+  struct stat st;
+  if ((fd >= 0) && (0 == fstat(fd, &st)) && (st.st_size > 0)) {
+    const char* const cache = (const char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (cache != MAP_FAILED) {
+      target->cache = cache;
+      target->cache_size = (size_t)st.st_size;
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const char* report_path = NULL;
+  long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:L:j:r:")) != -1) {
+    switch (opt) {
+      case 's':
+        add_target(optarg);
+        break;
+      case 'L':
+        ld_library_path = optarg;
+        break;
+      case 'j':
+        num_threads = strtol(optarg, NULL, 10);
+        break;
+      case 'r':
+        report_path = optarg;
+        break;
+      default:
+        ASSERT(0, "Usage: %s [-s sysroot]... [-L ld_library_path] [-j threads] [-r report] <installed tree or file>...\n", argv[0]);
+    }
+  }
+  ASSERT(optind < argc, "Usage: %s [-s sysroot]... [-L ld_library_path] [-j threads] [-r report] <installed tree or file>...\n", argv[0]);
+  ASSERT(num_threads > 0, "Number of threads must be positive\n");
+  if (num_targets == 0) {
+    add_target("/");
+  }
+
+  // ld.so only loads objects of its own machine
+  const int fd_self = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+  ElfW(Ehdr) ehdr_self;
+  ASSERT((fd_self >= 0) && (pread(fd_self, &ehdr_self, sizeof(ehdr_self), 0) == (ssize_t)sizeof(ehdr_self)), "Cannot read /proc/self/exe\n");
+  close(fd_self);
+  host_machine = ehdr_self.e_machine;
+
+  FILE* report = stdout;
+  if (report_path) {
+    report = fopen(report_path, "w");
+    ASSERT(report, "Cannot write %s\n", report_path);
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int num_errors = 0;
+  for (int i = optind; i < argc; i++) {
+    if (0 != nftw(argv[i], &collect_file, 64, FTW_PHYS)) {
+      ERROR("Cannot walk %s\n", argv[i]);
+      num_errors++;
+    }
+  }
+
+  report_lines = (char**)calloc(num_files ? num_files : 1, sizeof(char*));
+  ASSERT(report_lines, "Out of memory\n");
+  pthread_t* const threads = (pthread_t*)calloc((size_t)num_threads, sizeof(pthread_t));
+  ASSERT(threads, "Out of memory\n");
+  for (long t = 0; t < num_threads; t++) {
+    ASSERT(0 == pthread_create(&threads[t], NULL, &scan_worker, NULL), "Cannot create a worker thread\n");
+  }
+  for (long t = 0; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  free(threads);
+
+  size_t num_elf = 0;
+  for (size_t i = 0; i < num_files; i++) {
+    if (report_lines[i]) {
+      fprintf(report, "%s\n", report_lines[i]);
+      num_elf++;
+      free(report_lines[i]);
+    }
+    free(files[i]);
+  }
+  free(report_lines);
+  free(files);
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  const long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+  fprintf(stderr, "Scanned %lu files, %lu dynamic ELF files, %lu targets, %ld threads in %ld ms\n", (unsigned long)num_files, (unsigned long)num_elf,
+          (unsigned long)num_targets, num_threads, elapsed_ms);
+
+  if (report != stdout) {
+    ASSERT(fclose(report) == 0, "Cannot write %s\n", report_path);
+  }
+  return (num_errors > 0) ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2025 Altera
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"),to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// A C tool that loads a library that needs libstdc++ after startup, then prints the libstdc++ of its link map.
+// With the argument `dlmopen`, it then loads the library again in a new link-map namespace, and prints the libstdc++ there too
+// With the argument `unsetenv`, it first unsets AUDIT_LIBSTDCXX_TEST_UNSET, and afterwards prints the AUDIT_LIBSTDCXX_ variables
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dlfcn.h>
+#include <limits.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Print the libstdc++ of the link map of `handle`
+ * @return 0, or 1 if `handle` is NULL
+ */
+static int print_libstdcxx(void* const handle) {
+  struct link_map* map = NULL;
+  if ((NULL == handle) || (0 != dlinfo(handle, RTLD_DI_LINKMAP, &map))) {
+    fprintf(stderr, "%s\n", dlerror());
+    return 1;
+  }
+  while (NULL != map->l_prev) {
+    map = map->l_prev;
+  }
+  for (; NULL != map; map = map->l_next) {
+    if (NULL != strstr(map->l_name, "libstdc++")) {
+      char path[PATH_MAX];
+      printf("%s\n", (NULL != realpath(map->l_name, path)) ? path : map->l_name);
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  const int late_unsetenv = (argc > 1) && (0 == strcmp(argv[1], "unsetenv"));
+  if (late_unsetenv) {
+    unsetenv("AUDIT_LIBSTDCXX_TEST_UNSET");
+  }
+  if (0 != print_libstdcxx(dlopen(DLOPEN_PAYLOAD_LIBRARY, RTLD_NOW))) {
+    return 1;
+  }
+  if (late_unsetenv) {
+    for (char** entry = environ; NULL != *entry; entry++) {
+      if (0 == strncmp(*entry, "AUDIT_LIBSTDCXX_", sizeof("AUDIT_LIBSTDCXX_") - 1)) {
+        printf("%s\n", *entry);
+      }
+    }
+  }
+  if ((argc > 1) && (0 == strcmp(argv[1], "dlmopen"))) {
+    return print_libstdcxx(dlmopen(LM_ID_NEWLM, DLOPEN_PAYLOAD_LIBRARY, RTLD_NOW));
+  }
+  return 0;
+}
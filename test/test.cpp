@@ -17,27 +17,109 @@ OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
 ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 OTHER DEALINGS IN THE SOFTWARE.
 */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
 #endif
+#include <dirent.h>
 #include <dlfcn.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <link.h>
+#include <signal.h>
+#include <sys/auxv.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 extern "C" {
 #include <link.h>
 #include "error_types.h"
+// The types of the code under test. Its headers only define functions when compiled as C
+#include "decision_env.h"
+#include "dt_path_probe.h"
+#include "elf_image.h"
+#include "ld_so_cache.h"
+#include "libstdcxx_fingerprints.h"
+#include "libstdcxx_memo.h"
+#include "libstdcxx_note.h"
+const libstdcxx_memo_entry_t* libstdcxx_memo_find(const dev_t dev, const ino_t ino);
+void libstdcxx_memo_insert(const dev_t dev, const ino_t ino, const uint32_t glibcxx_version);
+void* path_arena_alloc(const size_t size);
+void path_arena_free(void* const ptr, const size_t size);
+error_code_t ld_so_cache_lookup(const char* const cache, const size_t cache_size, const char* const name, const char** const p_path);
+error_code_t find_system_libstdcxx_from_cache(const char* const cache_path, char* const path, const size_t len_path);
+error_code_t elf_note_find(const char* const notes, const size_t len_notes, const char* const name, const uint32_t type, const char** const p_desc,
+                           size_t* const p_len_desc);
+error_code_t libstdcxx_note_parse(const char* const desc, const size_t len_desc, const libstdcxx_note_desc_t** const p_note, const char** const p_path);
+error_code_t find_libstdcxx_from_note(const ElfW(Phdr) * const phdr, const size_t phnum, const char* const dt_runpath, const char* const dt_rpath,
+                                      const char* const ORIGIN, char* const path, const size_t len_path, uint32_t* const glibcxx_version, struct stat* const st);
 uint32_t version_string_to_int(const char* const str);
 error_code_t get_parent_executable_runpath_rpath(const ElfW(Phdr) * const phdr, const size_t phnum, const char** const dt_runpath, const char** const dt_rpath);
+error_code_t get_runpath_rpath(const ElfW(Phdr) * const phdr, const size_t phnum, const ElfW(Addr) base_address, const char** const dt_runpath,
+                               const char** const dt_rpath);
+error_code_t elf_image_map(const char* const path, const int writable, elf_image_t* const image);
+void elf_image_unmap(elf_image_t* const image);
+ElfW(Dyn) * elf_image_find_dynamic(const elf_image_t* const image, const ElfW(Sxword) tag);
+int elf_image_string_is_shared(const elf_image_t* const image, const ElfW(Dyn)* const owner);
+error_code_t elf_image_rewrite_string(const elf_image_t* const image, const ElfW(Dyn)* const owner, const char* const value);
+error_code_t elf_image_remove_dynamic(const elf_image_t* const image, ElfW(Dyn)* const dyn);
+size_t dt_path_origin_length(const char* const entry, const size_t len_entry);
+void sysroot_host_path(const char* const sysroot, const char* const path, const char* const ORIGIN, char* const out, const size_t len_out);
+int dt_path_filter(const char* const dt_path, int (*drop_callback)(const char* const entry, const size_t len_entry, void* data), void* callback_data,
+                   char* const out, const size_t len_out);
 error_code_t get_libstdcxx_version(const int fd, const char* const filename, uint32_t* const glibcxx_version);
+error_code_t get_libstdcxx_version_from_verdef(const int fd, const char* const filename, uint32_t* const glibcxx_version);
+error_code_t get_elf_build_id(const char* const mapped, const size_t file_size, uint8_t* const build_id, const size_t len_build_id_max,
+                              uint32_t* const p_len_build_id);
+error_code_t libstdcxx_fingerprint_lookup(const libstdcxx_fingerprint_t* const table, const size_t count, const uint8_t* const build_id,
+                                          const uint32_t len_build_id, uint32_t* const glibcxx_version);
+error_code_t get_libstdcxx_version_from_fingerprint(const int fd, const libstdcxx_fingerprint_t* const table, const size_t count,
+                                                    uint32_t* const glibcxx_version);
 error_code_t find_libstdcxx_from_dt_path(const char* const dt_path, const char* const ORIGIN, error_code_t (*trypath_callback)(const char* const path, void* data),
                                 void* callback_data, char** p_path, size_t* p_path_buffer_len);
+error_code_t find_name_from_dt_path(const char* const dt_path, const char* const name, const char* const ORIGIN,
+                                    error_code_t (*trypath_callback)(const char* const path, void* data), void* callback_data, char** p_path,
+                                    size_t* p_path_buffer_len);
+error_code_t objsearch_record_open(const char* const directory, const char* const executable, const char* const ORIGIN);
+void objsearch_record_close(void);
+unsigned objsearch_record_object(const char* const ORIGIN, const char* const dt_runpath, const char* const dt_rpath, const char* const path);
+void objsearch_record_search(const uintptr_t requester, const char* const name, const unsigned int flag, const char* const result);
+void objsearch_record_settle(const char* const opened_path);
+error_code_t force_libstdcxx(const char* const path);
+char* search_libstdcxx(const char* name, uintptr_t* cookie, unsigned int flag);
+extern uint32_t shipped_glibcxx_version;
+extern char* shipped_libstdcxx_path;
+extern dev_t shipped_dev;
+extern ino_t shipped_ino;
+extern libstdcxx_decision_t libstdcxx_decision;
+extern libstdcxx_decision_t planned_decision;
+void decision_env_capture(char** const envp);
+uint64_t decision_env_key(const char* const ORIGIN, const char* const dt_runpath, const char* const dt_rpath, const char* const note_path);
+error_code_t decision_env_parse(const char* const value, decision_env_t* const decision);
+error_code_t decision_env_format(char* const out, const size_t len_out, const decision_env_t* const decision);
+error_code_t decision_env_inherit(const uint64_t key, char* const path, const size_t len_path, uint32_t* const glibcxx_version, struct stat* const st);
+void decision_env_release(void);
+void decision_env_publish(const uint64_t key, const char* const path, const uint32_t glibcxx_version, const struct stat* const st);
+error_code_t find_libstdcxx_from_dt_path_concurrent(const char* const dt_path, const char* const ORIGIN,
+                                                    error_code_t (*trypath_callback)(const char* const path, void* data), void* callback_data, char** p_path,
+                                                    size_t* p_path_buffer_len, dt_path_probe_backend_t* const backend, const uint64_t* const latency_ns);
 }
 
 TEST(VerStr2Int, empty) {
@@ -113,9 +195,7 @@ TEST(ParseDTPath, empty) {
   EXPECT_EQ(data.paths.size(), 0);
   EXPECT_EQ(path, nullptr);
   EXPECT_EQ(path_buffer_len, 0);
-  if (path) {
-    munmap(path, path_buffer_len);
-  }
+  path_arena_free(path, path_buffer_len);
 }
 
 TEST(ParseDTPath, only_semicolon) {
@@ -126,9 +206,7 @@ TEST(ParseDTPath, only_semicolon) {
   EXPECT_EQ(data.paths.size(), 0);
   EXPECT_EQ(path, nullptr);
   EXPECT_EQ(path_buffer_len, 0);
-  if (path) {
-    munmap(path, path_buffer_len);
-  }
+  path_arena_free(path, path_buffer_len);
 }
 
 TEST(ParseDTPath, ORIGIN) {
@@ -140,9 +218,7 @@ TEST(ParseDTPath, ORIGIN) {
   EXPECT_EQ(data.paths.at(0), "orangin/libstdc++.so.6");
   EXPECT_EQ(std::string(path), "orangin/libstdc++.so.6");
   EXPECT_EQ(path_buffer_len, data.get_max_path_len() + 1);
-  if (path) {
-    munmap(path, path_buffer_len);
-  }
+  path_arena_free(path, path_buffer_len);
 }
 
 TEST(ParseDTPath, ORIGIN_2) {
@@ -155,9 +231,7 @@ TEST(ParseDTPath, ORIGIN_2) {
   EXPECT_EQ(data.paths.at(1), "orangin/../libstdc++.so.6");
   EXPECT_EQ(std::string(path), "orangin/../libstdc++.so.6");
   EXPECT_EQ(path_buffer_len, data.get_max_path_len() + 1);
-  if (path) {
-    munmap(path, path_buffer_len);
-  }
+  path_arena_free(path, path_buffer_len);
 }
 
 TEST(ParseDTPath, ORIGIN_2_1) {
@@ -169,10 +243,1525 @@ TEST(ParseDTPath, ORIGIN_2_1) {
   EXPECT_EQ(data.paths.at(0), "orangin/libstdc++.so.6");
   EXPECT_EQ(std::string(path), "orangin/libstdc++.so.6");
   EXPECT_EQ(path_buffer_len, data.get_max_path_len() + 1);
-  if (path) {
-    munmap(path, path_buffer_len);
+  path_arena_free(path, path_buffer_len);
+}
+
+TEST(ParseDTPath, other_name) {
+  char* path;
+  size_t path_buffer_len;
+  callback_data_t data("/opt/lib/libgcc_s.so.1");
+  EXPECT_EQ(find_name_from_dt_path("$ORIGIN/lib:/opt/lib", "libgcc_s.so.1", "orangin", &cpptrypath_callback, &data, &path, &path_buffer_len), ec_success);
+  ASSERT_EQ(data.paths.size(), 2);
+  EXPECT_EQ(data.paths.at(0), "orangin/lib/libgcc_s.so.1");
+  EXPECT_EQ(std::string(path), "/opt/lib/libgcc_s.so.1");
+  EXPECT_EQ(path_buffer_len, data.get_max_path_len() + 1);
+  path_arena_free(path, path_buffer_len);
+}
+
+TEST(ParseDTPath, ORIGIN_braces) {
+  char* path;
+  size_t path_buffer_len;
+  callback_data_t data("");
+  // ${ORIGIN} is substituted like $ORIGIN. $ORIGINAL is not $ORIGIN, and is tried as is
+  EXPECT_EQ(find_libstdcxx_from_dt_path("${ORIGIN}/lib:${ORIGIN}:$ORIGINAL/lib:$ORIGIN_lib", "orangin", &cpptrypath_callback, &data, &path, &path_buffer_len),
+            ec_fatal_error);
+  ASSERT_EQ(data.paths.size(), 4);
+  EXPECT_EQ(data.paths.at(0), "orangin/lib/libstdc++.so.6");
+  EXPECT_EQ(data.paths.at(1), "orangin/libstdc++.so.6");
+  EXPECT_EQ(data.paths.at(2), "$ORIGINAL/lib/libstdc++.so.6");
+  EXPECT_EQ(data.paths.at(3), "$ORIGIN_lib/libstdc++.so.6");
+
+  EXPECT_EQ(dt_path_origin_length("$ORIGIN", 7), 7u);
+  EXPECT_EQ(dt_path_origin_length("$ORIGIN/../lib", 14), 7u);
+  EXPECT_EQ(dt_path_origin_length("${ORIGIN}/lib", 13), 9u);
+  EXPECT_EQ(dt_path_origin_length("$ORIGINAL", 9), 0u);
+  // Only the first `len_entry` bytes are the entry
+  EXPECT_EQ(dt_path_origin_length("$ORIGINAL", 7), 7u);
+  EXPECT_EQ(dt_path_origin_length("${ORIGIN", 8), 0u);
+  EXPECT_EQ(dt_path_origin_length("/opt/$ORIGIN", 12), 0u);
+}
+
+TEST(LibstdcxxMemo, insert_find) {
+  EXPECT_EQ(libstdcxx_memo_find(1000, 1), nullptr);
+  libstdcxx_memo_insert(1000, 1, 0x0003041e);
+  const libstdcxx_memo_entry_t* entry = libstdcxx_memo_find(1000, 1);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->glibcxx_version, 0x0003041e);
+  // Same inode on another device is a different file
+  EXPECT_EQ(libstdcxx_memo_find(1001, 1), nullptr);
+}
+
+TEST(LibstdcxxMemo, update_in_place) {
+  libstdcxx_memo_insert(2000, 7, 0x00030419);
+  libstdcxx_memo_insert(2000, 7, 0x0003041f);
+  const libstdcxx_memo_entry_t* entry = libstdcxx_memo_find(2000, 7);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->glibcxx_version, 0x0003041f);
+}
+
+TEST(LibstdcxxMemo, overwritten_slot_forgets_evicted) {
+  // Fill the memo, so its oldest slot holds (4000, 0)
+  for (ino_t ino = 0; ino < LIBSTDCXX_MEMO_SIZE; ino++) {
+    libstdcxx_memo_insert(4000, ino, 0x00030400 + static_cast<uint32_t>(ino));
+  }
+  const libstdcxx_memo_entry_t* const slot = libstdcxx_memo_find(4000, 0);
+  ASSERT_NE(slot, nullptr);
+  // The next insert reuses that slot
+  libstdcxx_memo_insert(4001, 0, 0x0003041e);
+  EXPECT_EQ(libstdcxx_memo_find(4000, 0), nullptr);
+  EXPECT_EQ(libstdcxx_memo_find(4001, 0), slot);
+  EXPECT_EQ(slot->dev, 4001u);
+  EXPECT_EQ(slot->ino, 0u);
+  EXPECT_EQ(slot->glibcxx_version, 0x0003041e);
+}
+
+TEST(LibstdcxxMemo, oldest_is_evicted) {
+  // The memo holds 16 entries
+  for (ino_t ino = 0; ino < 17; ino++) {
+    libstdcxx_memo_insert(3000, ino, static_cast<uint32_t>(ino));
+  }
+  EXPECT_EQ(libstdcxx_memo_find(3000, 0), nullptr);
+  for (ino_t ino = 1; ino < 17; ino++) {
+    const libstdcxx_memo_entry_t* entry = libstdcxx_memo_find(3000, ino);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->glibcxx_version, static_cast<uint32_t>(ino));
+  }
+}
+
+// The flags ldconfig writes for the entries of this architecture
+#if defined(__x86_64__) && defined(__LP64__)
+static const int32_t native_cache_flags = 0x0303;
+#elif defined(__x86_64__)
+static const int32_t native_cache_flags = 0x0803;
+#elif defined(__aarch64__)
+static const int32_t native_cache_flags = 0x0a03;
+#elif defined(__arm__) && defined(__ARM_PCS_VFP)
+static const int32_t native_cache_flags = 0x0903;
+#elif defined(__arm__)
+static const int32_t native_cache_flags = 0x0b03;
+#elif defined(__powerpc64__)
+static const int32_t native_cache_flags = 0x0503;
+#elif defined(__s390x__)
+static const int32_t native_cache_flags = 0x0403;
+#else
+static const int32_t native_cache_flags = 0x0003;
+#endif
+
+// The layout of ld.so.cache is fixed by glibc
+static_assert(sizeof(ld_so_cache_header_new_t) == 48, "ld.so.cache header");
+static_assert(sizeof(ld_so_cache_entry_new_t) == 24, "ld.so.cache entry");
+
+// Builds an ld.so.cache image the way ldconfig lays it out
+struct ld_so_cache_builder {
+  struct entry {
+    int32_t flags;
+    std::string key;
+    std::string value;
+    uint64_t hwcap;
+  };
+  std::vector<entry> entries;
+
+  template <typename T>
+  static void append(std::vector<char>& image, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    image.insert(image.end(), bytes, bytes + sizeof(T));
+  }
+
+  std::vector<char> build(bool old_format_prefix = false) const {
+    std::vector<char> image;
+    if (old_format_prefix) {
+      // Old format with no entries, then padding to the 8 byte alignment of the new format
+      const char magic_old[] = "ld.so-1.7.0";
+      image.insert(image.end(), magic_old, magic_old + 11);
+      append(image, uint32_t(0));
+      image.resize((image.size() + 7) & ~size_t(7), '\0');
+    }
+    const size_t base = image.size();
+    const size_t header_size = 48;
+    const size_t entry_size = 24;
+    std::string strings;
+    std::vector<std::pair<uint32_t, uint32_t>> offsets;
+    for (const auto& e : entries) {
+      const uint32_t key = uint32_t(header_size + entries.size() * entry_size + strings.size());
+      strings += e.key + '\0';
+      const uint32_t value = uint32_t(header_size + entries.size() * entry_size + strings.size());
+      strings += e.value + '\0';
+      offsets.emplace_back(key, value);
+    }
+    const char magic_new[] = "glibc-ld.so.cache1.1";
+    image.insert(image.end(), magic_new, magic_new + 20);
+    append(image, uint32_t(entries.size()));
+    append(image, uint32_t(strings.size()));
+    image.resize(base + header_size, '\0');
+    for (size_t i = 0; i < entries.size(); i++) {
+      append(image, entries[i].flags);
+      append(image, offsets[i].first);
+      append(image, offsets[i].second);
+      append(image, uint32_t(0));
+      append(image, entries[i].hwcap);
+    }
+    image.insert(image.end(), strings.begin(), strings.end());
+    return image;
+  }
+};
+
+TEST(LdSoCache, found) {
+  ld_so_cache_builder builder;
+  builder.entries = {{native_cache_flags, "libz.so.1", "/usr/lib/libz.so.1", 0},
+                     {native_cache_flags, "libstdc++.so.6", "/usr/lib/libstdc++.so.6", 0}};
+  const std::vector<char> image = builder.build();
+  const char* path = nullptr;
+  ASSERT_EQ(ld_so_cache_lookup(image.data(), image.size(), "libstdc++.so.6", &path), ec_success);
+  EXPECT_EQ(std::string(path), "/usr/lib/libstdc++.so.6");
+}
+
+TEST(LdSoCache, skips_other_arch_and_hwcaps) {
+  ld_so_cache_builder builder;
+  builder.entries = {{0x0303 == native_cache_flags ? 0x0003 : 0x0303, "libstdc++.so.6", "/usr/lib32/libstdc++.so.6", 0},
+                     {native_cache_flags, "libstdc++.so.6", "/usr/lib/glibc-hwcaps/x86-64-v3/libstdc++.so.6", 1ull << 62},
+                     {native_cache_flags, "libstdc++.so.6", "/usr/lib64/libstdc++.so.6", 0},
+                     {native_cache_flags, "libstdc++.so.6", "/usr/lib/libstdc++.so.6", 0}};
+  const std::vector<char> image = builder.build();
+  const char* path = nullptr;
+  ASSERT_EQ(ld_so_cache_lookup(image.data(), image.size(), "libstdc++.so.6", &path), ec_success);
+  EXPECT_EQ(std::string(path), "/usr/lib64/libstdc++.so.6");
+}
+
+TEST(LdSoCache, not_cached) {
+  ld_so_cache_builder builder;
+  builder.entries = {{native_cache_flags, "libz.so.1", "/usr/lib/libz.so.1", 0}};
+  const std::vector<char> image = builder.build();
+  const char* path = nullptr;
+  EXPECT_EQ(ld_so_cache_lookup(image.data(), image.size(), "libstdc++.so.6", &path), ec_non_fatal_error);
+  EXPECT_EQ(path, nullptr);
+}
+
+TEST(LdSoCache, old_format_prefix) {
+  ld_so_cache_builder builder;
+  builder.entries = {{native_cache_flags, "libstdc++.so.6", "/lib/libstdc++.so.6", 0}};
+  const std::vector<char> image = builder.build(true);
+  const char* path = nullptr;
+  ASSERT_EQ(ld_so_cache_lookup(image.data(), image.size(), "libstdc++.so.6", &path), ec_success);
+  EXPECT_EQ(std::string(path), "/lib/libstdc++.so.6");
+}
+
+TEST(LdSoCache, invalid) {
+  ld_so_cache_builder builder;
+  builder.entries = {{native_cache_flags, "libstdc++.so.6", "/usr/lib/libstdc++.so.6", 0}};
+  std::vector<char> image = builder.build();
+  const char* path = nullptr;
+  // Truncated in the middle of the entries
+  EXPECT_EQ(ld_so_cache_lookup(image.data(), 60, "libstdc++.so.6", &path), ec_fatal_error);
+  // Unterminated string table
+  image.pop_back();
+  EXPECT_EQ(ld_so_cache_lookup(image.data(), image.size(), "libstdc++.so.6", &path), ec_fatal_error);
+  // Unknown magic
+  image[0] = 'x';
+  EXPECT_EQ(ld_so_cache_lookup(image.data(), image.size(), "libstdc++.so.6", &path), ec_fatal_error);
+}
+
+TEST(LdSoCache, from_file) {
+  ld_so_cache_builder builder;
+  builder.entries = {{native_cache_flags, "libstdc++.so.6", "/opt/lib/libstdc++.so.6", 0}};
+  const std::vector<char> image = builder.build();
+  char cache_path[] = "/tmp/ld.so.cache.XXXXXX";
+  const int fd = mkstemp(cache_path);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, image.data(), image.size()), static_cast<ssize_t>(image.size()));
+  close(fd);
+
+  char path[64];
+  EXPECT_EQ(find_system_libstdcxx_from_cache(cache_path, path, sizeof(path)), ec_success);
+  EXPECT_EQ(std::string(path), "/opt/lib/libstdc++.so.6");
+  // Does not fit the destination buffer
+  char short_path[8];
+  EXPECT_EQ(find_system_libstdcxx_from_cache(cache_path, short_path, sizeof(short_path)), ec_fatal_error);
+  unlink(cache_path);
+
+  EXPECT_EQ(find_system_libstdcxx_from_cache("/nonexistent/ld.so.cache", path, sizeof(path)), ec_fatal_error);
+}
+
+TEST(PathArena, lifo_reuse) {
+  char* a = static_cast<char*>(path_arena_alloc(100));
+  ASSERT_NE(a, nullptr);
+  char* b = static_cast<char*>(path_arena_alloc(10));
+  ASSERT_NE(b, nullptr);
+  EXPECT_GE(b, a + 100);
+  path_arena_free(b, 10);
+  // Releasing the top allocation makes its space available again
+  char* c = static_cast<char*>(path_arena_alloc(20));
+  EXPECT_EQ(c, b);
+  path_arena_free(c, 20);
+  path_arena_free(a, 100);
+  EXPECT_EQ(path_arena_alloc(1), a);
+  path_arena_free(a, 1);
+}
+
+TEST(PathArena, mmap_fallback) {
+  const size_t huge = 1024 * 1024;
+  char* p = static_cast<char*>(path_arena_alloc(huge));
+  ASSERT_NE(p, nullptr);
+  p[0] = 'a';
+  p[huge - 1] = 'z';
+  path_arena_free(p, huge);
+  // The arena is untouched by the fallback
+  char* small = static_cast<char*>(path_arena_alloc(8));
+  ASSERT_NE(small, nullptr);
+  path_arena_free(small, 8);
+}
+
+TEST(ParseDTPath, long_section_uses_fallback) {
+  char* path;
+  size_t path_buffer_len;
+  const std::string long_dir(5 * 4096, 'd');
+  const std::string expected = "orangin/" + long_dir + "/libstdc++.so.6";
+  callback_data_t data(expected);
+  EXPECT_EQ(find_libstdcxx_from_dt_path(("$ORIGIN:$ORIGIN/" + long_dir).c_str(), "orangin", &cpptrypath_callback, &data, &path, &path_buffer_len), ec_success);
+  ASSERT_EQ(data.paths.size(), 2);
+  EXPECT_EQ(std::string(path), expected);
+  EXPECT_EQ(path_buffer_len, data.get_max_path_len() + 1);
+  path_arena_free(path, path_buffer_len);
+}
+
+// Builds the contents of a PT_NOTE segment: an unrelated GNU note followed by a .note.audit_libstdcxx note
+struct libstdcxx_note_builder {
+  uint32_t glibcxx_version = 0x00030420;
+  uint64_t file_size = 0;
+  std::string path = "libstdc++.so.6";
+  // Of the shipped libstdc++. Empty if it has none
+  std::vector<uint8_t> build_id;
+
+  static void append_note(std::vector<char>& notes, const std::string& name, const uint32_t type, const std::vector<char>& desc) {
+    const ElfW(Nhdr) nhdr = {static_cast<ElfW(Word)>(name.size() + 1), static_cast<ElfW(Word)>(desc.size()), type};
+    notes.insert(notes.end(), reinterpret_cast<const char*>(&nhdr), reinterpret_cast<const char*>(&nhdr) + sizeof(nhdr));
+    notes.insert(notes.end(), name.c_str(), name.c_str() + name.size() + 1);
+    notes.resize((notes.size() + 3) & ~static_cast<size_t>(3), '\0');
+    notes.insert(notes.end(), desc.begin(), desc.end());
+    notes.resize((notes.size() + 3) & ~static_cast<size_t>(3), '\0');
+  }
+
+  std::vector<char> build() const {
+    std::vector<char> notes;
+    append_note(notes, "GNU", NT_GNU_BUILD_ID, std::vector<char>(20, 'b'));
+    libstdcxx_note_desc_t desc = {};
+    desc.glibcxx_version = glibcxx_version;
+    desc.file_size_low = static_cast<uint32_t>(file_size);
+    desc.file_size_high = static_cast<uint32_t>(file_size >> 32);
+    desc.len_build_id = static_cast<uint32_t>(build_id.size());
+    std::copy(build_id.begin(), build_id.end(), desc.build_id);
+    std::vector<char> desc_bytes(reinterpret_cast<const char*>(&desc), reinterpret_cast<const char*>(&desc) + sizeof(desc));
+    desc_bytes.insert(desc_bytes.end(), path.c_str(), path.c_str() + path.size() + 1);
+    append_note(notes, "AuditLibstdcxx", 1, desc_bytes);
+    return notes;
+  }
+};
+
+TEST(LibstdcxxNote, find_and_parse) {
+  const std::vector<char> notes = libstdcxx_note_builder().build();
+  const char* desc = nullptr;
+  size_t len_desc = 0;
+  ASSERT_EQ(elf_note_find(notes.data(), notes.size(), "AuditLibstdcxx", 1, &desc, &len_desc), ec_success);
+  const libstdcxx_note_desc_t* note = nullptr;
+  const char* path = nullptr;
+  ASSERT_EQ(libstdcxx_note_parse(desc, len_desc, &note, &path), ec_success);
+  EXPECT_EQ(note->glibcxx_version, 0x00030420);
+  EXPECT_EQ(std::string(path), "libstdc++.so.6");
+
+  EXPECT_EQ(elf_note_find(notes.data(), notes.size(), "AuditLibstdcxx", 2, &desc, &len_desc), ec_non_fatal_error);
+  // Truncated note
+  EXPECT_EQ(elf_note_find(notes.data(), notes.size() - 8, "AuditLibstdcxx", 1, &desc, &len_desc), ec_fatal_error);
+  // Path without terminator
+  EXPECT_EQ(libstdcxx_note_parse(desc, sizeof(libstdcxx_note_desc_t) + 4, &note, &path), ec_fatal_error);
+}
+
+TEST(LibstdcxxNote, from_program_headers) {
+  char dir[] = "/tmp/libstdcxx_note.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string lib = std::string(dir) + "/libstdc++.so.6";
+  const std::string contents(1234, 'x');
+  const int fd = open(lib.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, contents.data(), contents.size()), static_cast<ssize_t>(contents.size()));
+  close(fd);
+
+  libstdcxx_note_builder builder;
+  builder.file_size = contents.size();
+  const std::vector<char> notes = builder.build();
+
+  // The program headers are "loaded" at address 0 of this fake executable
+  ElfW(Phdr) phdr[2] = {};
+  phdr[0].p_type = PT_PHDR;
+  phdr[1].p_type = PT_NOTE;
+  phdr[1].p_vaddr = reinterpret_cast<ElfW(Addr)>(notes.data()) - reinterpret_cast<ElfW(Addr)>(phdr);
+  phdr[1].p_filesz = notes.size();
+
+  char path[PATH_MAX];
+  uint32_t version = 0;
+  struct stat st;
+  // The soname is looked up in DT_RUNPATH, then DT_RPATH
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "/nonexistent:$ORIGIN", "", dir, path, sizeof(path), &version, &st), ec_success);
+  EXPECT_EQ(std::string(path), lib);
+  EXPECT_EQ(version, 0x00030420);
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "", dir, "/", path, sizeof(path), &version, &st), ec_success);
+  EXPECT_EQ(std::string(path), lib);
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "/nonexistent", "", dir, path, sizeof(path), &version, &st), ec_fatal_error);
+
+  // An absolute path is used as is
+  builder.path = lib;
+  const std::vector<char> absolute_notes = builder.build();
+  phdr[1].p_vaddr = reinterpret_cast<ElfW(Addr)>(absolute_notes.data()) - reinterpret_cast<ElfW(Addr)>(phdr);
+  phdr[1].p_filesz = absolute_notes.size();
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "", "", "/", path, sizeof(path), &version, &st), ec_success);
+  EXPECT_EQ(std::string(path), lib);
+
+  // A libstdc++ of a different size makes the note stale
+  builder.file_size = contents.size() + 1;
+  const std::vector<char> stale_notes = builder.build();
+  phdr[1].p_vaddr = reinterpret_cast<ElfW(Addr)>(stale_notes.data()) - reinterpret_cast<ElfW(Addr)>(phdr);
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "", "", "/", path, sizeof(path), &version, &st), ec_fatal_error);
+
+  // So does a missing libstdc++
+  phdr[1].p_vaddr = reinterpret_cast<ElfW(Addr)>(absolute_notes.data()) - reinterpret_cast<ElfW(Addr)>(phdr);
+  unlink(lib.c_str());
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "", "", "/", path, sizeof(path), &version, &st), ec_fatal_error);
+  rmdir(dir);
+
+  // A bare name other than the soname is neither looked up nor opened
+  builder.path = "libstdc++.so.6.0.30";
+  const std::vector<char> bare_notes = builder.build();
+  phdr[1].p_vaddr = reinterpret_cast<ElfW(Addr)>(bare_notes.data()) - reinterpret_cast<ElfW(Addr)>(phdr);
+  phdr[1].p_filesz = bare_notes.size();
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "$ORIGIN", "", dir, path, sizeof(path), &version, &st), ec_fatal_error);
+
+  // No note at all
+  phdr[1].p_type = PT_NULL;
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "", "", "/", path, sizeof(path), &version, &st), ec_non_fatal_error);
+}
+
+std::string getLibstdcppPath();
+
+TEST(LibstdcxxNote, relative_path_and_build_id) {
+  // A copy of the libstdc++ of the tests, which has a build-id, in lib/ next to the "executable"
+  char dir[] = "/tmp/libstdcxx_note.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string lib_dir = std::string(dir) + "/lib";
+  ASSERT_EQ(mkdir(lib_dir.c_str(), 0755), 0);
+  const std::string lib = lib_dir + "/libstdc++.so.6";
+  {
+    std::ifstream in(getLibstdcppPath(), std::ios::binary);
+    std::ofstream out(lib, std::ios::binary);
+    out << in.rdbuf();
+  }
+  struct stat st_lib;
+  ASSERT_EQ(stat(lib.c_str(), &st_lib), 0);
+  const int fd = open(lib.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  const char* const mapped = static_cast<const char*>(mmap(nullptr, static_cast<size_t>(st_lib.st_size), PROT_READ, MAP_PRIVATE, fd, 0));
+  close(fd);
+  ASSERT_NE(mapped, MAP_FAILED);
+  uint8_t build_id[LIBSTDCXX_NOTE_MAX_BUILD_ID];
+  uint32_t len_build_id = 0;
+  const error_code_t error_build_id = get_elf_build_id(mapped, static_cast<size_t>(st_lib.st_size), build_id, sizeof(build_id), &len_build_id);
+  munmap(const_cast<char*>(mapped), static_cast<size_t>(st_lib.st_size));
+  if (ec_success != error_build_id) {
+    unlink(lib.c_str());
+    rmdir(lib_dir.c_str());
+    rmdir(dir);
+    GTEST_SKIP() << "The libstdc++ of the tests has no build-id";
+  }
+
+  libstdcxx_note_builder builder;
+  builder.file_size = static_cast<uint64_t>(st_lib.st_size);
+  builder.path = "lib/libstdc++.so.6";
+  builder.build_id.assign(build_id, build_id + len_build_id);
+  const std::vector<char> notes = builder.build();
+  ElfW(Phdr) phdr[2] = {};
+  phdr[0].p_type = PT_PHDR;
+  phdr[1].p_type = PT_NOTE;
+  phdr[1].p_vaddr = reinterpret_cast<ElfW(Addr)>(notes.data()) - reinterpret_cast<ElfW(Addr)>(phdr);
+  phdr[1].p_filesz = notes.size();
+
+  // A relative path is relative to ORIGIN, DT_RUNPATH and DT_RPATH do not matter
+  char path[PATH_MAX];
+  uint32_t version = 0;
+  struct stat st;
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "/nonexistent", "", dir, path, sizeof(path), &version, &st), ec_success);
+  EXPECT_EQ(std::string(path), lib);
+  EXPECT_EQ(st.st_ino, st_lib.st_ino);
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "", "", lib_dir.c_str(), path, sizeof(path), &version, &st), ec_fatal_error);
+
+  // A libstdc++ of the same size with another build-id makes the note stale
+  builder.build_id[0] ^= 0xff;
+  const std::vector<char> rebuilt_notes = builder.build();
+  phdr[1].p_vaddr = reinterpret_cast<ElfW(Addr)>(rebuilt_notes.data()) - reinterpret_cast<ElfW(Addr)>(phdr);
+  phdr[1].p_filesz = rebuilt_notes.size();
+  EXPECT_EQ(find_libstdcxx_from_note(phdr, 2, "", "", dir, path, sizeof(path), &version, &st), ec_fatal_error);
+
+  unlink(lib.c_str());
+  rmdir(lib_dir.c_str());
+  rmdir(dir);
+}
+
+TEST(ElfImage, runpath_matches_loaded) {
+  const char no_path = '\0';
+  const char* loaded_runpath = &no_path;
+  const char* loaded_rpath = &no_path;
+  ASSERT_EQ(get_parent_executable_runpath_rpath((const ElfW(Phdr)*)getauxval(AT_PHDR), getauxval(AT_PHNUM), &loaded_runpath, &loaded_rpath), ec_success);
+
+  // The unrelocated file image gives the same strings as the loaded executable
+  elf_image_t image;
+  ASSERT_EQ(elf_image_map("/proc/self/exe", 0, &image), ec_success);
+  ASSERT_NE(image.dynamic, nullptr);
+  const char* file_runpath = &no_path;
+  const char* file_rpath = &no_path;
+  ASSERT_EQ(get_runpath_rpath(image.phdr, image.phnum, image.base, &file_runpath, &file_rpath), ec_success);
+  EXPECT_EQ(std::string(file_runpath), std::string(loaded_runpath));
+  EXPECT_EQ(std::string(file_rpath), std::string(loaded_rpath));
+  elf_image_unmap(&image);
+
+  // Not an ELF file, not a file
+  EXPECT_EQ(elf_image_map("/proc/self/cmdline", 0, &image), ec_non_fatal_error);
+  EXPECT_EQ(elf_image_map("/", 0, &image), ec_fatal_error);
+}
+
+TEST(ElfImage, edit_in_place) {
+  char path[] = "/tmp/elf_image.XXXXXX";
+  const int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  const int fd_self = open("/proc/self/exe", O_RDONLY);
+  ASSERT_GE(fd_self, 0);
+  char buffer[65536];
+  for (ssize_t len = read(fd_self, buffer, sizeof(buffer)); len > 0; len = read(fd_self, buffer, sizeof(buffer))) {
+    ASSERT_EQ(write(fd, buffer, static_cast<size_t>(len)), len);
+  }
+  close(fd_self);
+  close(fd);
+
+  elf_image_t image;
+  ASSERT_EQ(elf_image_map(path, 1, &image), ec_success);
+  ElfW(Dyn)* dyn = elf_image_find_dynamic(&image, DT_RUNPATH);
+  const ElfW(Sxword) tag = dyn ? DT_RUNPATH : DT_RPATH;
+  dyn = dyn ? dyn : elf_image_find_dynamic(&image, DT_RPATH);
+  ASSERT_NE(dyn, nullptr);
+  ASSERT_EQ(elf_image_string_is_shared(&image, dyn), 0);
+  EXPECT_EQ(elf_image_rewrite_string(&image, dyn, "/a"), ec_success);
+  EXPECT_EQ(elf_image_rewrite_string(&image, dyn, std::string(PATH_MAX, 'x').c_str()), ec_fatal_error);
+  elf_image_unmap(&image);
+
+  // The edit landed in the file
+  ASSERT_EQ(elf_image_map(path, 0, &image), ec_success);
+  dyn = elf_image_find_dynamic(&image, tag);
+  ASSERT_NE(dyn, nullptr);
+  EXPECT_EQ(std::string(image.strtab + dyn->d_un.d_val), "/a");
+  elf_image_unmap(&image);
+
+  ASSERT_EQ(elf_image_map(path, 1, &image), ec_success);
+  EXPECT_EQ(elf_image_remove_dynamic(&image, elf_image_find_dynamic(&image, tag)), ec_success);
+  elf_image_unmap(&image);
+  ASSERT_EQ(elf_image_map(path, 0, &image), ec_success);
+  EXPECT_EQ(elf_image_find_dynamic(&image, tag), nullptr);
+  EXPECT_NE(elf_image_find_dynamic(&image, DT_NEEDED), nullptr);
+  elf_image_unmap(&image);
+  unlink(path);
+}
+
+#ifdef RELINK_LIBSTDCXX
+/**
+ * @return the string of the dynamic entry `tag` of `image`, or an empty string if it has none
+ */
+static std::string dynamic_string(const elf_image_t& image, const ElfW(Sxword) tag) {
+  const ElfW(Dyn)* const dyn = elf_image_find_dynamic(&image, tag);
+  return (nullptr != dyn) ? std::string(image.strtab + dyn->d_un.d_val) : std::string();
+}
+
+TEST(RelinkLibstdcxx, relinks_a_copy) {
+  // The same decision as the audit library: the libstdc++ of ld.so.cache, unless the shipped one is newer
+  const std::string shipped = std::string(SHIPPED_LIBSTDCXX_DIR) + "/libstdc++.so.6";
+  char cached[PATH_MAX];
+  ASSERT_EQ(find_system_libstdcxx_from_cache("/etc/ld.so.cache", cached, sizeof(cached)), ec_success);
+  uint32_t versions[2] = {0, 0};
+  const char* const candidates[2] = {shipped.c_str(), cached};
+  for (size_t i = 0; i < 2; i++) {
+    const int fd = open(candidates[i], O_RDONLY);
+    ASSERT_GE(fd, 0) << candidates[i];
+    ASSERT_EQ(get_libstdcxx_version(fd, candidates[i], &versions[i]), ec_success);
+  }
+  const bool use_system = (versions[1] >= versions[0]);
+
+  char dir[] = "/tmp/relink_libstdcxx.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string executable = std::string(dir) + "/app";
+  {
+    std::ifstream in(RELINK_PAYLOAD, std::ios::binary);
+    std::ofstream out(executable, std::ios::binary);
+    out << in.rdbuf();
+  }
+  ASSERT_EQ(chmod(executable.c_str(), 0751), 0);
+  struct stat st_before;
+  ASSERT_EQ(stat(executable.c_str(), &st_before), 0);
+
+  const std::string report = std::string(dir) + "/report";
+  const std::string command = std::string(RELINK_LIBSTDCXX) + " -r " + report + " " + executable;
+  ASSERT_EQ(system(command.c_str()), 0);
+  std::ifstream report_file(report);
+  std::string line;
+  ASSERT_TRUE(static_cast<bool>(std::getline(report_file, line)));
+  EXPECT_NE(line.find(use_system ? " choice=system" : " choice=shipped"), std::string::npos) << line;
+  EXPECT_NE(line.find(" status=relinked"), std::string::npos) << line;
+
+  // The executable was replaced by an edited copy with the same mode, and no copy is left behind
+  struct stat st_after;
+  ASSERT_EQ(stat(executable.c_str(), &st_after), 0);
+  EXPECT_NE(st_after.st_ino, st_before.st_ino);
+  EXPECT_EQ(st_after.st_mode, st_before.st_mode);
+  EXPECT_EQ(st_after.st_size, st_before.st_size);
+  std::vector<std::string> entries;
+  DIR* const directory = opendir(dir);
+  for (const struct dirent* entry = readdir(directory); nullptr != entry; entry = readdir(directory)) {
+    if (entry->d_name[0] != '.') {
+      entries.push_back(entry->d_name);
+    }
+  }
+  closedir(directory);
+  std::sort(entries.begin(), entries.end());
+  EXPECT_EQ(entries, std::vector<std::string>({"app", "report"}));
+
+  // Only our audit library is dropped from DT_AUDIT. DT_RUNPATH, which only holds the shipped libstdc++, goes if the system one wins
+  elf_image_t image;
+  ASSERT_EQ(elf_image_map(executable.c_str(), 0, &image), ec_success);
+  EXPECT_EQ(dynamic_string(image, DT_AUDIT), "libother_audit.so");
+  EXPECT_EQ(dynamic_string(image, DT_RUNPATH), use_system ? std::string() : std::string(SHIPPED_LIBSTDCXX_DIR));
+  EXPECT_EQ(dynamic_string(image, DT_RPATH), "");
+  size_t needed_libstdcxx = 0;
+  for (const ElfW(Dyn)* dyn = image.dynamic; dyn->d_tag != DT_NULL; dyn++) {
+    needed_libstdcxx += (dyn->d_tag == DT_NEEDED) && (std::string(image.strtab + dyn->d_un.d_val) == "libstdc++.so.6");
+  }
+  EXPECT_EQ(needed_libstdcxx, 1u);
+  elf_image_unmap(&image);
+
+  unlink(executable.c_str());
+  unlink(report.c_str());
+  rmdir(dir);
+}
+
+TEST(RelinkLibstdcxx, origin_in_braces) {
+  const std::string shipped = std::string(SHIPPED_LIBSTDCXX_DIR) + "/libstdc++.so.6";
+  char cached[PATH_MAX];
+  ASSERT_EQ(find_system_libstdcxx_from_cache("/etc/ld.so.cache", cached, sizeof(cached)), ec_success);
+  uint32_t versions[2] = {0, 0};
+  const char* const candidates[2] = {shipped.c_str(), cached};
+  for (size_t i = 0; i < 2; i++) {
+    const int fd = open(candidates[i], O_RDONLY);
+    ASSERT_GE(fd, 0) << candidates[i];
+    ASSERT_EQ(get_libstdcxx_version(fd, candidates[i], &versions[i]), ec_success);
+  }
+  const bool use_system = (versions[1] >= versions[0]);
+
+  // A copy of the payload whose DT_RUNPATH is ${ORIGIN}/lib, next to a lib/ with a copy of the shipped libstdc++
+  char dir[] = "/tmp/relink_libstdcxx.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string lib = std::string(dir) + "/lib";
+  ASSERT_EQ(mkdir(lib.c_str(), 0755), 0);
+  const std::string executable = std::string(dir) + "/app";
+  const std::string copies[2][2] = {{RELINK_PAYLOAD, executable}, {shipped, lib + "/libstdc++.so.6"}};
+  for (const auto& copy : copies) {
+    std::ifstream in(copy[0], std::ios::binary);
+    std::ofstream out(copy[1], std::ios::binary);
+    out << in.rdbuf();
+  }
+  ASSERT_EQ(chmod(executable.c_str(), 0751), 0);
+  elf_image_t image;
+  ASSERT_EQ(elf_image_map(executable.c_str(), 1, &image), ec_success);
+  ASSERT_EQ(elf_image_rewrite_string(&image, elf_image_find_dynamic(&image, DT_RUNPATH), "${ORIGIN}/lib"), ec_success);
+  elf_image_unmap(&image);
+
+  // ${ORIGIN} is expanded like $ORIGIN: the directory holds the shipped libstdc++, and goes if the system one wins
+  const std::string report = std::string(dir) + "/report";
+  const std::string command = std::string(RELINK_LIBSTDCXX) + " -r " + report + " " + executable;
+  ASSERT_EQ(system(command.c_str()), 0);
+  std::ifstream report_file(report);
+  std::string line;
+  ASSERT_TRUE(static_cast<bool>(std::getline(report_file, line)));
+  EXPECT_NE(line.find(use_system ? " choice=system" : " choice=shipped"), std::string::npos) << line;
+  ASSERT_EQ(elf_image_map(executable.c_str(), 0, &image), ec_success);
+  EXPECT_EQ(dynamic_string(image, DT_RUNPATH), use_system ? std::string() : std::string("${ORIGIN}/lib"));
+  elf_image_unmap(&image);
+
+  unlink(copies[1][1].c_str());
+  rmdir(lib.c_str());
+  unlink(executable.c_str());
+  unlink(report.c_str());
+  rmdir(dir);
+}
+#endif
+
+#ifdef SCAN_LIBSTDCXX
+/**
+ * Run `command` through the shell
+ * @return its stdout
+ */
+static std::string command_output(const std::string& command) {
+  std::string output;
+  FILE* const pipe = popen(command.c_str(), "r");
+  EXPECT_NE(pipe, nullptr) << command;
+  char buffer[4096];
+  for (size_t len = fread(buffer, 1, sizeof(buffer), pipe); len > 0; len = fread(buffer, 1, sizeof(buffer), pipe)) {
+    output.append(buffer, len);
+  }
+  EXPECT_EQ(pclose(pipe), 0) << command;
+  return output;
+}
+
+TEST(ScanLibstdcxx, agrees_with_the_loader) {
+  // A tree with an executable whose DT_RUNPATH holds a libstdc++, and a directory to put on LD_LIBRARY_PATH
+  char dir[] = "/tmp/scan_libstdcxx.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string bin = std::string(dir) + "/bin";
+  const std::string library_path = std::string(dir) + "/lib";
+  ASSERT_EQ(mkdir(bin.c_str(), 0755), 0);
+  ASSERT_EQ(mkdir(library_path.c_str(), 0755), 0);
+  const std::string executable = bin + "/app";
+  const std::string copy = library_path + "/libstdc++.so.6";
+  for (const auto& [from, to] : {std::make_pair(std::string(RELINK_PAYLOAD), executable), std::make_pair(std::string(SHIPPED_LIBSTDCXX_DIR) + "/libstdc++.so.6", copy)}) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary);
+    out << in.rdbuf();
+  }
+  ASSERT_EQ(chmod(executable.c_str(), 0755), 0);
+
+  for (const bool with_library_path : {false, true}) {
+    // The choice of ld.so, from its trace of the loaded objects. It reports the audit libraries of DT_AUDIT it cannot find on stderr
+    const std::string environment = with_library_path ? ("LD_LIBRARY_PATH=" + library_path + " ") : std::string();
+    const std::string trace = command_output(environment + "LD_TRACE_LOADED_OBJECTS=1 " + executable + " 2>/dev/null");
+    const size_t arrow = trace.find("libstdc++.so.6 => ");
+    ASSERT_NE(arrow, std::string::npos) << trace;
+    const size_t start = arrow + strlen("libstdc++.so.6 => ");
+    const std::string loaded = trace.substr(start, trace.find(' ', start) - start);
+
+    // The audit library named in DT_AUDIT is not in the tree, so the scanner applies the policy of ld.so alone
+    const std::string options = with_library_path ? (" -L " + library_path) : std::string();
+    const std::string report = command_output(std::string(SCAN_LIBSTDCXX) + " -j 2" + options + " " + dir + " 2>/dev/null");
+    EXPECT_NE(report.find(executable + " exe target=/ libstdcxx=" + loaded + ":"), std::string::npos) << loaded << "\n" << report;
+    EXPECT_NE(report.find(" requested_by=self policy=ld.so"), std::string::npos) << report;
+    EXPECT_EQ(loaded, with_library_path ? copy : (std::string(SHIPPED_LIBSTDCXX_DIR) + "/libstdc++.so.6"));
+  }
+
+  // ${ORIGIN} in DT_RUNPATH is expanded by both, to the same copy
+  elf_image_t image;
+  ASSERT_EQ(elf_image_map(executable.c_str(), 1, &image), ec_success);
+  ASSERT_EQ(elf_image_rewrite_string(&image, elf_image_find_dynamic(&image, DT_RUNPATH), "${ORIGIN}/../lib"), ec_success);
+  elf_image_unmap(&image);
+  const std::string trace = command_output("LD_TRACE_LOADED_OBJECTS=1 " + executable + " 2>/dev/null");
+  EXPECT_NE(trace.find("libstdc++.so.6 => " + bin + "/../lib/libstdc++.so.6 "), std::string::npos) << trace;
+  const std::string report = command_output(std::string(SCAN_LIBSTDCXX) + " -j 2 " + dir + " 2>/dev/null");
+  EXPECT_NE(report.find(executable + " exe target=/ libstdcxx=" + bin + "/../lib/libstdc++.so.6:"), std::string::npos) << report;
+
+  unlink(executable.c_str());
+  unlink(copy.c_str());
+  rmdir(bin.c_str());
+  rmdir(library_path.c_str());
+  rmdir(dir);
+}
+#endif
+
+extern "C" int drop_b(const char* const entry, const size_t len_entry, void* data) {
+  (*static_cast<int*>(data))++;
+  return (len_entry == 1) && (entry[0] == 'b');
+}
+
+TEST(DTPathFilter, drops_entries) {
+  char out[16];
+  int calls = 0;
+  EXPECT_EQ(dt_path_filter("a:b:c", &drop_b, &calls, out, sizeof(out)), 1);
+  EXPECT_EQ(std::string(out), "a:c");
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(dt_path_filter("b::b", &drop_b, &calls, out, sizeof(out)), 2);
+  EXPECT_EQ(std::string(out), "");
+  EXPECT_EQ(dt_path_filter("$ORIGIN/../lib", &drop_b, &calls, out, sizeof(out)), 0);
+  EXPECT_EQ(std::string(out), "$ORIGIN/../lib");
+  EXPECT_EQ(dt_path_filter("$ORIGIN/../lib:a", &drop_b, &calls, out, sizeof(out)), -1);
+}
+
+TEST(SysrootHostPath, origin_is_in_the_tree) {
+  char out[PATH_MAX];
+  sysroot_host_path("/sysroot", "/opt/app/bin/../lib/libstdc++.so.6", "/opt/app/bin", out, sizeof(out));
+  EXPECT_EQ(std::string(out), "/opt/app/bin/../lib/libstdc++.so.6");
+  sysroot_host_path("/sysroot", "/usr/lib64/libstdc++.so.6", "/opt/app/bin", out, sizeof(out));
+  EXPECT_EQ(std::string(out), "/sysroot/usr/lib64/libstdc++.so.6");
+  sysroot_host_path("", "/usr/lib64/libstdc++.so.6", "/opt/app/bin", out, sizeof(out));
+  EXPECT_EQ(std::string(out), "/usr/lib64/libstdc++.so.6");
+  sysroot_host_path("/sysroot", "lib/libstdc++.so.6", "/opt/app/bin", out, sizeof(out));
+  EXPECT_EQ(std::string(out), "lib/libstdc++.so.6");
+  // A sibling that only shares the prefix of ORIGIN is on the target system
+  sysroot_host_path("/sysroot", "/opt/app/binutils/lib/libstdc++.so.6", "/opt/app/bin", out, sizeof(out));
+  EXPECT_EQ(std::string(out), "/sysroot/opt/app/binutils/lib/libstdc++.so.6");
+  sysroot_host_path("/sysroot", "/opt/app/bin", "/opt/app/bin", out, sizeof(out));
+  EXPECT_EQ(std::string(out), "/opt/app/bin");
+}
+
+extern "C" error_code_t stat_and_record(const char* const path, void* data) {
+  static_cast<std::vector<std::string>*>(data)->push_back(path);
+  struct stat st;
+  return (0 == stat(path, &st)) ? ec_success : ec_fatal_error;
+}
+
+// Latency injecting stand-in of a network file system: every candidate of a 6 entry DT_RUNPATH is delayed, the earlier
+// ones the most, and libstdc++ exists in the 3rd and 5th directories. The 3rd must win even though the 5th answers first
+static void probe_with_latency(const dt_path_probe_backend_t allowed) {
+  char root[] = "/tmp/dt_path_probe.XXXXXX";
+  ASSERT_NE(mkdtemp(root), nullptr);
+  const std::string dirs = "abcdef";
+  for (const char dir : dirs) {
+    const std::string path = std::string(root) + "/" + dir;
+    ASSERT_EQ(mkdir(path.c_str(), 0755), 0);
+    if ((dir == 'c') || (dir == 'e')) {
+      const int fd = open((path + "/libstdc++.so.6").c_str(), O_CREAT | O_WRONLY, 0644);
+      ASSERT_GE(fd, 0);
+      close(fd);
+    }
+  }
+  const uint64_t ms = 1000000;
+  const uint64_t latency_ns[] = {100 * ms, 80 * ms, 60 * ms, 40 * ms, 20 * ms, 20 * ms};
+  const char* const dt_path = "$ORIGIN/a:$ORIGIN/b:$ORIGIN/c:$ORIGIN/d:$ORIGIN/e:$ORIGIN/f";
+
+  std::vector<std::string> serial_calls;
+  char* serial_path = nullptr;
+  size_t len_serial_path = 0;
+  ASSERT_EQ(find_libstdcxx_from_dt_path(dt_path, root, &stat_and_record, &serial_calls, &serial_path, &len_serial_path), ec_success);
+  const std::string expected = serial_path;
+  path_arena_free(serial_path, len_serial_path);
+  EXPECT_EQ(expected, std::string(root) + "/c/libstdc++.so.6");
+
+  std::vector<std::string> calls;
+  char* path = nullptr;
+  size_t len_path = 0;
+  dt_path_probe_backend_t backend = allowed;
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(find_libstdcxx_from_dt_path_concurrent(dt_path, root, &stat_and_record, &calls, &path, &len_path, &backend, latency_ns), ec_success);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const std::string found = path;
+  path_arena_free(path, len_path);
+
+  for (const char dir : dirs) {
+    const std::string path = std::string(root) + "/" + dir;
+    unlink((path + "/libstdc++.so.6").c_str());
+    rmdir(path.c_str());
+  }
+  rmdir(root);
+
+  if (backend == dt_path_probe_none) {
+    GTEST_SKIP() << "Concurrent probing is not available";
+  }
+  EXPECT_EQ(backend, allowed);
+  EXPECT_EQ(found, expected);
+  // The missing candidates before the winner are not tried again
+  EXPECT_EQ(calls, std::vector<std::string>{expected});
+  // The probes overlap: the slowest one bounds the search, not the sum of all of them
+  EXPECT_GE(elapsed, std::chrono::milliseconds(100));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(300));
+}
+
+TEST(DTPathProbe, io_uring_first_match_in_order) {
+  probe_with_latency(dt_path_probe_io_uring);
+}
+
+TEST(DTPathProbe, threads_first_match_in_order) {
+  probe_with_latency(dt_path_probe_threads);
+}
+
+TEST(DTPathProbe, threads_start_masked) {
+  char root[] = "/tmp/dt_path_probe.XXXXXX";
+  ASSERT_NE(mkdtemp(root), nullptr);
+  const uint64_t latency_ns[] = {200000000, 200000000};
+
+  // The caller blocks SIGUSR1 only
+  sigset_t caller_mask;
+  sigemptyset(&caller_mask);
+  sigaddset(&caller_mask, SIGUSR1);
+  sigset_t saved_mask;
+  ASSERT_EQ(pthread_sigmask(SIG_SETMASK, &caller_mask, &saved_mask), 0);
+
+  // While the helpers sleep, read the blocked signals of every other thread of the process
+  const pid_t caller = static_cast<pid_t>(syscall(SYS_gettid));
+  std::vector<std::string> helper_masks;
+  std::thread watcher([&]() {
+    const pid_t self = static_cast<pid_t>(syscall(SYS_gettid));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(150);
+    while (helper_masks.empty() && (std::chrono::steady_clock::now() < deadline)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      DIR* const tasks = opendir("/proc/self/task");
+      for (const struct dirent* entry = readdir(tasks); nullptr != entry; entry = readdir(tasks)) {
+        const pid_t tid = static_cast<pid_t>(atoi(entry->d_name));
+        if ((tid == 0) || (tid == self) || (tid == caller) || (tid == getpid())) {
+          continue;
+        }
+        std::ifstream status(std::string("/proc/self/task/") + entry->d_name + "/status");
+        for (std::string line; std::getline(status, line);) {
+          if (line.rfind("SigBlk:", 0) == 0) {
+            helper_masks.push_back(line.substr(line.find_first_not_of(" \t", 7)));
+          }
+        }
+      }
+      closedir(tasks);
+    }
+  });
+  std::vector<std::string> calls;
+  char* path = nullptr;
+  size_t len_path = 0;
+  dt_path_probe_backend_t backend = dt_path_probe_threads;
+  EXPECT_EQ(find_libstdcxx_from_dt_path_concurrent("$ORIGIN/a:$ORIGIN/b", root, &stat_and_record, &calls, &path, &len_path, &backend, latency_ns),
+            ec_fatal_error);
+  watcher.join();
+
+  // The mask of the caller is back as it was
+  sigset_t after_mask;
+  ASSERT_EQ(pthread_sigmask(SIG_SETMASK, &saved_mask, &after_mask), 0);
+  EXPECT_TRUE(sigismember(&after_mask, SIGUSR1));
+  EXPECT_FALSE(sigismember(&after_mask, SIGUSR2));
+  rmdir(root);
+
+  if (backend == dt_path_probe_none) {
+    GTEST_SKIP() << "Concurrent probing is not available";
+  }
+  // Every signal the kernel lets a thread block, all but SIGKILL and SIGSTOP
+  ASSERT_FALSE(helper_masks.empty());
+  for (const std::string& mask : helper_masks) {
+    EXPECT_EQ(mask, "fffffffffffbfeff");
+  }
+}
+
+extern "C" error_code_t regular_file_and_record(const char* const path, void* data) {
+  static_cast<std::vector<std::string>*>(data)->push_back(path);
+  struct stat st;
+  return ((0 == stat(path, &st)) && S_ISREG(st.st_mode)) ? ec_success : ec_fatal_error;
+}
+
+// Every backend, for layouts where the winner is first, last, absent or hidden behind a directory of the same name, and
+// latencies that complete the candidates in order and in reverse: the result must be the sequential one, and the
+// callback must see the sequential calls less the candidates probed as missing
+TEST(DTPathProbe, matches_sequential) {
+  const uint64_t ms = 1000000;
+  const std::vector<std::string> layouts = {"f....", "....f", ".....", ".d.f.", "dd..f", "f.f.f"};
+  const std::vector<std::vector<uint64_t>> latencies = {{5 * ms, 4 * ms, 3 * ms, 2 * ms, 1 * ms}, {1 * ms, 2 * ms, 3 * ms, 4 * ms, 5 * ms}};
+  const char* const dt_path = "$ORIGIN/0:$ORIGIN/1:$ORIGIN/2:$ORIGIN/3:$ORIGIN/4";
+  for (const dt_path_probe_backend_t allowed : {dt_path_probe_io_uring, dt_path_probe_threads}) {
+    for (const std::string& layout : layouts) {
+      char root[] = "/tmp/dt_path_probe.XXXXXX";
+      ASSERT_NE(mkdtemp(root), nullptr);
+      std::vector<std::string> libraries;
+      for (size_t i = 0; i < layout.size(); i++) {
+        const std::string dir = std::string(root) + "/" + std::to_string(i);
+        ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+        libraries.push_back(dir + "/libstdc++.so.6");
+        if (layout[i] == 'f') {
+          const int fd = open(libraries.back().c_str(), O_CREAT | O_WRONLY, 0644);
+          ASSERT_GE(fd, 0);
+          close(fd);
+        } else if (layout[i] == 'd') {
+          ASSERT_EQ(mkdir(libraries.back().c_str(), 0755), 0);
+        }
+      }
+
+      std::vector<std::string> serial_calls;
+      char* serial_path = nullptr;
+      size_t len_serial_path = 0;
+      const error_code_t serial_error =
+        find_libstdcxx_from_dt_path(dt_path, root, &regular_file_and_record, &serial_calls, &serial_path, &len_serial_path);
+      const std::string expected = (ec_success == serial_error) ? serial_path : "";
+      if (ec_success == serial_error) {
+        path_arena_free(serial_path, len_serial_path);
+      }
+      std::vector<std::string> expected_calls;
+      for (const std::string& call : serial_calls) {
+        if (layout[call[strlen(root) + 1] - '0'] != '.') {
+          expected_calls.push_back(call);
+        }
+      }
+
+      for (const std::vector<uint64_t>& latency_ns : latencies) {
+        std::vector<std::string> calls;
+        char* path = nullptr;
+        size_t len_path = 0;
+        dt_path_probe_backend_t backend = allowed;
+        const error_code_t error =
+          find_libstdcxx_from_dt_path_concurrent(dt_path, root, &regular_file_and_record, &calls, &path, &len_path, &backend, latency_ns.data());
+        const std::string found = (ec_success == error) ? path : "";
+        if (ec_success == error) {
+          path_arena_free(path, len_path);
+        }
+        EXPECT_EQ(error, serial_error) << layout;
+        EXPECT_EQ(found, expected) << layout;
+        if (backend != dt_path_probe_none) {
+          EXPECT_EQ(backend, allowed);
+          EXPECT_EQ(calls, expected_calls) << layout;
+        } else {
+          EXPECT_EQ(calls, serial_calls) << layout;
+        }
+      }
+
+      for (const std::string& library : libraries) {
+        unlink(library.c_str());
+        rmdir(library.c_str());
+        rmdir(library.substr(0, library.rfind('/')).c_str());
+      }
+      rmdir(root);
+    }
+  }
+}
+
+TEST(DTPathProbe, serial_without_backend) {
+  callback_data_t data("/b/libstdc++.so.6");
+  char* path = nullptr;
+  size_t len_path = 0;
+  dt_path_probe_backend_t backend = dt_path_probe_none;
+  EXPECT_EQ(find_libstdcxx_from_dt_path_concurrent("/a:/b:/c", "", &cpptrypath_callback, &data, &path, &len_path, &backend, nullptr), ec_success);
+  EXPECT_EQ(backend, dt_path_probe_none);
+  EXPECT_EQ(std::string(path), "/b/libstdc++.so.6");
+  EXPECT_EQ(data.paths.size(), 2);
+  path_arena_free(path, len_path);
+}
+
+TEST(ObjsearchRecord, probe_outcomes) {
+  char dir[] = "/tmp/objsearch_record.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  ASSERT_EQ(objsearch_record_open(dir, "/opt/app/bin/app", "./bin"), ec_success);
+  EXPECT_EQ(objsearch_record_object("/opt/app/bin", "$ORIGIN/../stale:$ORIGIN/../lib", "", "/opt/app/bin/app"), 0u);
+  // Not a probe: ld.so searches the directories for a bare name
+  objsearch_record_search(0, "libfoo.so", LA_SER_ORIG, "libfoo.so");
+  objsearch_record_search(0, "/opt/app/bin/../stale/libfoo.so", LA_SER_RUNPATH, "/opt/app/bin/../stale/libfoo.so");
+  objsearch_record_search(0, "/opt/app/bin/../lib/libfoo.so", LA_SER_RUNPATH, "/opt/app/bin/../lib/libfoo.so");
+  objsearch_record_settle("/opt/app/bin/../lib/libfoo.so");
+  EXPECT_EQ(objsearch_record_object("/opt/app/bin/../lib", "", "", "/opt/app/bin/../lib/libfoo.so"), 1u);
+  // Rejected, then redirected: ld.so names the object after its own candidate
+  objsearch_record_search(1, "libstdc++.so.6", LA_SER_ORIG, "libstdc++.so.6");
+  objsearch_record_search(1, "/opt/app/lib/libstdc++.so.6", LA_SER_RUNPATH, nullptr);
+  objsearch_record_search(1, "/usr/lib/libstdc++.so.6", LA_SER_CONFIG, "/opt/app/lib/libstdc++.so.6");
+  objsearch_record_settle("/usr/lib/libstdc++.so.6");
+  objsearch_record_close();
+  // A later dlopen appends to the closed recording
+  EXPECT_EQ(objsearch_record_object("/opt/app/plugins", "", "", "/opt/app/plugins/libplugin.so"), 2u);
+  objsearch_record_close();
+
+  const std::string recording = std::string(dir) + "/app." + std::to_string(getpid()) + ".objsearch";
+  std::ifstream file(recording);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);) {
+    // Drop the time of probes
+    if (line.rfind("probe\t", 0) == 0) {
+      const size_t ns = line.find('\t', line.find('\t', line.find('\t', 6) + 1) + 1);
+      line.erase(ns, line.find('\t', ns + 1) - ns);
+    }
+    lines.push_back(line);
+  }
+  unlink(recording.c_str());
+  rmdir(dir);
+  ASSERT_EQ(lines.size(), 8u);
+  EXPECT_EQ(lines[0], "exe\t./bin\t/opt/app/bin/app");
+  EXPECT_EQ(lines[1], "object\t0\t/opt/app/bin\t$ORIGIN/../stale:$ORIGIN/../lib\t\t/opt/app/bin/app");
+  EXPECT_EQ(lines[2], "probe\t0\trunpath\tmiss\tlibfoo.so\t/opt/app/bin/../stale/libfoo.so");
+  EXPECT_EQ(lines[3], "probe\t0\trunpath\thit\tlibfoo.so\t/opt/app/bin/../lib/libfoo.so");
+  EXPECT_EQ(lines[4], "object\t1\t/opt/app/bin/../lib\t\t\t/opt/app/bin/../lib/libfoo.so");
+  EXPECT_EQ(lines[5], "probe\t1\trunpath\tskip\tlibstdc++.so.6\t/opt/app/lib/libstdc++.so.6");
+  EXPECT_EQ(lines[6], "probe\t1\tcache\thit\tlibstdc++.so.6\t/opt/app/lib/libstdc++.so.6");
+  EXPECT_EQ(lines[7], "object\t2\t/opt/app/plugins\t\t\t/opt/app/plugins/libplugin.so");
+}
+
+#ifdef ANALYZE_OBJSEARCH
+TEST(AnalyzeObjsearch, prune_and_reorder) {
+  // An executable whose DT_RUNPATH has an entry that holds nothing, then libfoo.so, then the shipped libstdc++
+  char dir[] = "/tmp/analyze_objsearch.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string root = dir;
+  for (const char* const sub : {"/empty", "/lib", "/shipped"}) {
+    ASSERT_EQ(mkdir((root + sub).c_str(), 0755), 0);
+  }
+  for (const char* const library : {"/lib/libfoo.so", "/shipped/libstdc++.so.6"}) {
+    std::ofstream(root + library) << "";
+  }
+
+  // Two runs. libstdc++ misses LD_LIBRARY_PATH, then libstdc++ and libfoo.so each miss every entry before their own.
+  // An object with an id past the number of objects, as in a corrupt recording, is ignored
+  const std::string runpath = "$ORIGIN/empty:$ORIGIN/lib:$ORIGIN/shipped";
+  for (const char* const run : {"1", "2"}) {
+    std::ofstream recording(root + "/app." + run + ".objsearch");
+    recording << "exe\t" << root << "\t" << root << "/app\n";
+    recording << "object\t0\t" << root << "\t" << runpath << "\t\t" << root << "/app\n";
+    recording << "probe\t0\tlibpath\tmiss\t1000\tlibstdc++.so.6\t/nonexistent/libstdc++.so.6\n";
+    recording << "probe\t0\trunpath\tmiss\t1000\tlibstdc++.so.6\t" << root << "/empty/libstdc++.so.6\n";
+    recording << "probe\t0\trunpath\tmiss\t1000\tlibstdc++.so.6\t" << root << "/lib/libstdc++.so.6\n";
+    recording << "probe\t0\trunpath\thit\t1000\tlibstdc++.so.6\t" << root << "/shipped/libstdc++.so.6\n";
+    recording << "object\t1\t" << root << "/shipped\t\t\t" << root << "/shipped/libstdc++.so.6\n";
+    recording << "probe\t0\trunpath\tmiss\t1000\tlibfoo.so\t" << root << "/empty/libfoo.so\n";
+    recording << "probe\t0\trunpath\thit\t1000\tlibfoo.so\t" << root << "/lib/libfoo.so\n";
+    recording << "object\t4294967295\t" << root << "/lib\t\t\t" << root << "/lib/libfoo.so\n";
+  }
+
+  const std::string report = root + "/report";
+  const std::string command = std::string(ANALYZE_OBJSEARCH) + " -r " + report + " " + root + " 2>/dev/null";
+  EXPECT_EQ(system(command.c_str()), 0);
+  std::ifstream report_file(report);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(report_file, line);) {
+    lines.push_back(line);
+  }
+
+  for (const char* const path : {"/lib/libfoo.so", "/shipped/libstdc++.so.6", "/app.1.objsearch", "/app.2.objsearch", "/report"}) {
+    unlink((root + path).c_str());
+  }
+  for (const char* const sub : {"/empty", "/lib", "/shipped", ""}) {
+    rmdir((root + sub).c_str());
+  }
+
+  ASSERT_EQ(lines.size(), 7u);
+  EXPECT_EQ(lines[0], root + "/app runs=2 probes=12 misses=8 miss_time=8.0us");
+  EXPECT_EQ(lines[1], "  object " + root + "/app DT_RUNPATH=\"" + runpath + "\"");
+  EXPECT_EQ(lines[2], "    [0] $ORIGIN/empty hits=0 misses=4 miss_time=4.0us prune");
+  EXPECT_EQ(lines[3], "    [1] $ORIGIN/lib hits=2 misses=2 miss_time=2.0us keep");
+  EXPECT_EQ(lines[4], "    [2] $ORIGIN/shipped hits=2 misses=0 miss_time=0.0us keep libstdc++");
+  // The shipped libstdc++ first, as no libfoo.so there shadows the one found in $ORIGIN/lib
+  EXPECT_EQ(lines[5], "    recommend DT_RUNPATH=\"$ORIGIN/shipped:$ORIGIN/lib\" misses=6->2 per 2 runs libstdc++ 2->0");
+  EXPECT_EQ(lines[6], "  other libpath probes=2 misses=2 miss_time=2.0us");
+}
+#endif
+
+TEST(DecisionEnv, format_and_parse) {
+  const decision_env_t decision = {0xfedcba9876543210ull, 0x0003041e, 0xfe00, 0x1234, 0, 0x6ad539cb, 999999999, "/opt/app/lib/a:b/libstdc++.so.6"};
+  char value[512];
+  ASSERT_EQ(decision_env_format(value, sizeof(value), &decision), ec_success);
+  EXPECT_STREQ(value, "AUDIT_LIBSTDCXX_DECISION=1:fedcba9876543210:3041e:fe00:1234:0:6ad539cb:3b9ac9ff:/opt/app/lib/a:b/libstdc++.so.6");
+  EXPECT_EQ(decision_env_format(value, 64, &decision), ec_fatal_error);
+
+  decision_env_t parsed = {};
+  ASSERT_EQ(decision_env_parse(strchr(value, '=') + 1, &parsed), ec_success);
+  EXPECT_EQ(parsed.key, decision.key);
+  EXPECT_EQ(parsed.glibcxx_version, decision.glibcxx_version);
+  EXPECT_EQ(parsed.dev, decision.dev);
+  EXPECT_EQ(parsed.ino, decision.ino);
+  EXPECT_EQ(parsed.size, decision.size);
+  EXPECT_EQ(parsed.mtime_sec, decision.mtime_sec);
+  EXPECT_EQ(parsed.mtime_nsec, decision.mtime_nsec);
+  EXPECT_STREQ(parsed.path, decision.path);
+
+  // An empty value only enables publishing
+  EXPECT_EQ(decision_env_parse("", &parsed), ec_non_fatal_error);
+  EXPECT_EQ(decision_env_parse("2:1:1:1:1:1:1:1:/lib", &parsed), ec_non_fatal_error);
+  EXPECT_EQ(decision_env_parse("1:1:1:1:1:1:1:/lib", &parsed), ec_non_fatal_error);
+  EXPECT_EQ(decision_env_parse("1:1:1:1:1:1:1:1:", &parsed), ec_non_fatal_error);
+  EXPECT_EQ(decision_env_parse("1:1:1:1:1:1:1:X:/lib", &parsed), ec_non_fatal_error);
+  EXPECT_EQ(decision_env_parse("1:1:100000000:1:1:1:1:1:/lib", &parsed), ec_non_fatal_error);
+  EXPECT_EQ(decision_env_parse("1:11111111111111111:1:1:1:1:1:1:/lib", &parsed), ec_non_fatal_error);
+
+  EXPECT_EQ(decision_env_key("/opt/app/bin", "$ORIGIN/../lib", "", ""), decision_env_key("/opt/app/bin", "$ORIGIN/../lib", "", ""));
+  EXPECT_NE(decision_env_key("/opt/app/bin", "$ORIGIN/../lib", "", ""), decision_env_key("/opt/app/bin", "", "$ORIGIN/../lib", ""));
+  EXPECT_NE(decision_env_key("/opt/app/bin", "$ORIGIN/../lib", "", ""), decision_env_key("/opt/app/sbin", "$ORIGIN/../lib", "", ""));
+  EXPECT_NE(decision_env_key("/opt/app/bin", "$ORIGIN/../lib", "", ""), decision_env_key("/opt/app/bin", "$ORIGIN/../lib", "", "libstdc++.so.6"));
+}
+
+TEST(DecisionEnv, publish_then_inherit) {
+  char dir[] = "/tmp/decision_env.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string lib = std::string(dir) + "/libstdc++.so.6";
+  const int fd = open(lib.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, "ELF", 3), 3);
+  close(fd);
+  struct stat st_lib;
+  ASSERT_EQ(stat(lib.c_str(), &st_lib), 0);
+
+  char path[PATH_MAX];
+  uint32_t version = 0;
+  struct stat st;
+  const uint64_t key = decision_env_key(dir, "$ORIGIN", "", "");
+
+  // Without the variable, nothing is published nor inherited
+  char other[] = "HOME=/root";
+  char* no_decision[] = {other, nullptr};
+  decision_env_capture(no_decision);
+  decision_env_publish(key, lib.c_str(), 0x0003041e, &st_lib);
+  EXPECT_STREQ(no_decision[0], "HOME=/root");
+  EXPECT_EQ(decision_env_inherit(key, path, sizeof(path), &version, &st), ec_non_fatal_error);
+
+  // The entry of the variable is replaced, in place in the array
+  char empty[] = "AUDIT_LIBSTDCXX_DECISION=";
+  char* envp[] = {other, empty, nullptr};
+  decision_env_capture(envp);
+  EXPECT_EQ(decision_env_inherit(key, path, sizeof(path), &version, &st), ec_non_fatal_error);
+  decision_env_publish(key, lib.c_str(), 0x0003041e, &st_lib);
+  EXPECT_EQ(envp[0], other);
+  ASSERT_EQ(std::string(envp[1]).rfind("AUDIT_LIBSTDCXX_DECISION=1:", 0), 0u);
+  EXPECT_EQ(envp[2], nullptr);
+
+  // After startup the array belongs to libc, and is left alone
+  char* late_envp[] = {other, empty, nullptr};
+  decision_env_capture(late_envp);
+  decision_env_release();
+  decision_env_publish(key, lib.c_str(), 0x0003041e, &st_lib);
+  EXPECT_EQ(late_envp[1], empty);
+  EXPECT_EQ(decision_env_inherit(key, path, sizeof(path), &version, &st), ec_non_fatal_error);
+
+  // What a child sees
+  decision_env_capture(envp);
+  ASSERT_EQ(decision_env_inherit(key, path, sizeof(path), &version, &st), ec_success);
+  EXPECT_EQ(std::string(path), lib);
+  EXPECT_EQ(version, 0x0003041e);
+  EXPECT_EQ(st.st_ino, st_lib.st_ino);
+  // Another search
+  EXPECT_EQ(decision_env_inherit(decision_env_key(dir, "$ORIGIN/../lib", "", ""), path, sizeof(path), &version, &st), ec_non_fatal_error);
+  // The file changed since
+  const struct timespec times[2] = {{0, UTIME_OMIT}, {st_lib.st_mtim.tv_sec + 1, 0}};
+  ASSERT_EQ(utimensat(AT_FDCWD, lib.c_str(), times, 0), 0);
+  EXPECT_EQ(decision_env_inherit(key, path, sizeof(path), &version, &st), ec_fatal_error);
+  // Or is gone
+  unlink(lib.c_str());
+  EXPECT_EQ(decision_env_inherit(key, path, sizeof(path), &version, &st), ec_fatal_error);
+  rmdir(dir);
+  decision_env_capture(no_decision);
+}
+
+#ifdef AUDIT_LIBRARY_FREESTANDING
+/**
+ * Run `payload` once with LD_AUDIT=`audit_library`, and `argument` if not NULL, its stdout into `output`
+ * @return elapsed wall time in nanoseconds, and the peak resident size in `max_rss_kb`
+ */
+static uint64_t run_audited_payload(const char* const audit_library, std::string& output, long& max_rss_kb, const char* const payload = AUDIT_PAYLOAD,
+                                    const char* const argument = nullptr) {
+  int pipe_fds[2];
+  EXPECT_EQ(pipe(pipe_fds), 0);
+  const auto start = std::chrono::steady_clock::now();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    dup2(pipe_fds[1], STDOUT_FILENO);
+    close(pipe_fds[0]);
+    setenv("LD_AUDIT", audit_library, 1);
+    execl(payload, payload, argument, static_cast<char*>(nullptr));
+    _exit(127);
+  }
+  close(pipe_fds[1]);
+  output.clear();
+  char buffer[4096];
+  for (ssize_t len = read(pipe_fds[0], buffer, sizeof(buffer)); len > 0; len = read(pipe_fds[0], buffer, sizeof(buffer))) {
+    output.append(buffer, static_cast<size_t>(len));
+  }
+  close(pipe_fds[0]);
+  int status = 0;
+  struct rusage usage;
+  EXPECT_EQ(wait4(pid, &status, 0, &usage), pid);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0)) << audit_library;
+  max_rss_kb = usage.ru_maxrss;
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+TEST(FreestandingAudit, load_cost_and_resident_size) {
+  // No DT_NEEDED, and fewer relocations than the libc linked build
+  size_t relocations[2];
+  const char* const libraries[2] = {AUDIT_LIBRARY, AUDIT_LIBRARY_FREESTANDING};
+  for (size_t i = 0; i < 2; i++) {
+    elf_image_t image;
+    ASSERT_EQ(elf_image_map(libraries[i], 0, &image), ec_success);
+    const ElfW(Dyn)* const relasz = elf_image_find_dynamic(&image, DT_RELASZ);
+    const ElfW(Dyn)* const pltrelsz = elf_image_find_dynamic(&image, DT_PLTRELSZ);
+    relocations[i] = ((relasz ? relasz->d_un.d_val : 0) + (pltrelsz ? pltrelsz->d_un.d_val : 0)) / sizeof(ElfW(Rela));
+    if (i == 1) {
+      EXPECT_EQ(elf_image_find_dynamic(&image, DT_NEEDED), nullptr);
+      EXPECT_EQ(elf_image_find_dynamic(&image, DT_JMPREL), nullptr);
+    }
+    elf_image_unmap(&image);
+  }
+  EXPECT_LT(relocations[1], relocations[0]);
+
+  // Alternate the two builds so both see the same state of the machine. Both decide the same
+  const size_t runs = 41;
+  std::vector<uint64_t> ns[2];
+  std::vector<long> rss_kb[2];
+  std::string outputs[2];
+  for (size_t run = 0; run < runs; run++) {
+    for (size_t i = 0; i < 2; i++) {
+      long max_rss_kb = 0;
+      ns[i].push_back(run_audited_payload(libraries[i], outputs[i], max_rss_kb));
+      rss_kb[i].push_back(max_rss_kb);
+    }
+    ASSERT_EQ(outputs[1], outputs[0]);
+  }
+  for (size_t i = 0; i < 2; i++) {
+    std::sort(ns[i].begin(), ns[i].end());
+    std::sort(rss_kb[i].begin(), rss_kb[i].end());
+    std::cout << libraries[i] << ": relocations " << relocations[i] << ", median startup " << (ns[i][runs / 2] / 1000) << " us, median peak RSS "
+              << rss_kb[i][runs / 2] << " KiB" << std::endl;
+  }
+  // Without a second libc in its link namespace the audit library costs less memory. The startup time is only reported,
+  // as it is too noisy on a shared machine to assert on
+  EXPECT_LT(rss_kb[1][runs / 2], rss_kb[0][runs / 2]);
+}
+
+TEST(FreestandingAudit, without_proc) {
+  // /proc hidden by a tmpfs in a new mount namespace. The freestanding build takes the environment and the auxiliary vector
+  // from the arguments of its constructor, so it still knows the path of the executable and reads AUDIT_LIBSTDCXX_FORCE
+  if (0 != system("unshare -rm true 2>/dev/null")) {
+    GTEST_SKIP() << "User and mount namespaces are not available";
+  }
+  std::string expected;
+  long max_rss_kb = 0;
+  run_audited_payload(AUDIT_LIBRARY, expected, max_rss_kb);
+
+  char dir[] = "/tmp/freestanding_audit.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string output = std::string(dir) + "/output";
+  const std::string errors = std::string(dir) + "/errors";
+  const std::string command = std::string("unshare -rm sh -c 'mount -t tmpfs none /proc && exec env LD_AUDIT=") + AUDIT_LIBRARY_FREESTANDING +
+                              " AUDIT_LIBSTDCXX_FORCE=/nonexistent/libstdc++.so.6 " + AUDIT_PAYLOAD + "' >" + output + " 2>" + errors;
+  EXPECT_EQ(system(command.c_str()), 0);
+  std::stringstream output_text;
+  output_text << std::ifstream(output).rdbuf();
+  std::stringstream errors_text;
+  errors_text << std::ifstream(errors).rdbuf();
+  unlink(output.c_str());
+  unlink(errors.c_str());
+  rmdir(dir);
+
+  EXPECT_EQ(output_text.str(), expected);
+  EXPECT_NE(errors_text.str().find("AUDIT_LIBSTDCXX_FORCE=/nonexistent/libstdc++.so.6 is not a libstdc++"), std::string::npos) << errors_text.str();
+}
+
+/**
+ * Run `payload` under `audit_library`, with `argument` if not NULL, while recording its searches
+ * @return the lines of the recording, its stdout into `output`
+ */
+static std::vector<std::string> record_audited_payload(const char* const audit_library, const char* const payload, std::string& output,
+                                                       const char* const argument = nullptr) {
+  char dir[] = "/tmp/lazy_audit.XXXXXX";
+  EXPECT_NE(mkdtemp(dir), nullptr);
+  setenv("AUDIT_LIBSTDCXX_RECORD", dir, 1);
+  long max_rss_kb = 0;
+  run_audited_payload(audit_library, output, max_rss_kb, payload, argument);
+  unsetenv("AUDIT_LIBSTDCXX_RECORD");
+  std::vector<std::string> lines;
+  DIR* const directory = opendir(dir);
+  for (const struct dirent* entry = readdir(directory); nullptr != entry; entry = readdir(directory)) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    const std::string recording = std::string(dir) + "/" + entry->d_name;
+    std::ifstream file(recording);
+    for (std::string line; std::getline(file, line);) {
+      lines.push_back(line);
+    }
+    unlink(recording.c_str());
+  }
+  closedir(directory);
+  rmdir(dir);
+  return lines;
+}
+
+/**
+ * Run `payload` under `audit_library` while recording its searches
+ * @return the number of candidates the audit library itself tried for libstdc++, its stdout into `output`
+ */
+static size_t count_audit_probes(const char* const audit_library, const char* const payload, std::string& output) {
+  size_t probes = 0;
+  for (const std::string& line : record_audited_payload(audit_library, payload, output)) {
+    probes += (line.rfind("probe\t0\taudit\t", 0) == 0);
+  }
+  return probes;
+}
+
+TEST(LazyAudit, search_waits_for_libstdcxx) {
+  const char* const libraries[2] = {AUDIT_LIBRARY, AUDIT_LIBRARY_FREESTANDING};
+  for (const char* const library : libraries) {
+    std::string eager_output;
+    std::string lazy_output;
+    // Eagerly, the shipped libstdc++ is searched for also by a C tool
+    EXPECT_GT(count_audit_probes(library, AUDIT_C_PAYLOAD, eager_output), 0u) << library;
+    const size_t eager_probes = count_audit_probes(library, AUDIT_PAYLOAD, eager_output);
+    EXPECT_GT(eager_probes, 0u) << library;
+
+    setenv("AUDIT_LIBSTDCXX_LAZY", "1", 1);
+    EXPECT_EQ(count_audit_probes(library, AUDIT_C_PAYLOAD, lazy_output), 0u) << library;
+    EXPECT_EQ(lazy_output, "C payload\n");
+    // On the search for libstdc++, the same search and the same decision
+    EXPECT_EQ(count_audit_probes(library, AUDIT_PAYLOAD, lazy_output), eager_probes) << library;
+    unsetenv("AUDIT_LIBSTDCXX_LAZY");
+    EXPECT_EQ(lazy_output, eager_output) << library;
+  }
+}
+
+
+/**
+ * The candidates for libstdc++ that ld.so opened, or was redirected from, in a recording. Rejected ones are left out
+ * @return "<flag> <outcome> <path>" of each
+ */
+static std::vector<std::string> loader_libstdcxx_probes(const std::vector<std::string>& lines) {
+  std::vector<std::string> probes;
+  for (const std::string& line : lines) {
+    std::vector<std::string> fields;
+    std::istringstream stream(line);
+    for (std::string field; std::getline(stream, field, '\t');) {
+      fields.push_back(field);
+    }
+    // probe, requester, flag, outcome, ns, name, path
+    if ((fields.size() == 7) && (fields[0] == "probe") && (fields[2] != "audit") && (fields[3] != "skip") && (fields[5] == "libstdc++.so.6")) {
+      probes.push_back(fields[2] + " " + fields[3] + " " + fields[6]);
+    }
+  }
+  return probes;
+}
+
+TEST(PlannedDecision, replaces_the_search) {
+  // The winner between the shipped copy next to the payload and the libstdc++ of ld.so.cache
+  const std::string payload = AUDIT_PAYLOAD;
+  const std::string shipped = payload.substr(0, payload.rfind('/')) + "/shipped/libstdc++.so.6";
+  char cached[PATH_MAX];
+  ASSERT_EQ(find_system_libstdcxx_from_cache("/etc/ld.so.cache", cached, sizeof(cached)), ec_success);
+  uint32_t versions[2] = {0, 0};
+  const char* const candidates[2] = {shipped.c_str(), cached};
+  for (size_t i = 0; i < 2; i++) {
+    const int fd = open(candidates[i], O_RDONLY);
+    ASSERT_GE(fd, 0) << candidates[i];
+    ASSERT_EQ(get_libstdcxx_version(fd, candidates[i], &versions[i]), ec_success);
+    close(fd);
+  }
+  const std::string winner = (versions[1] >= versions[0]) ? cached : shipped;
+
+  // A copy of the winner on LD_LIBRARY_PATH, which precedes DT_RUNPATH and ld.so.cache and is as new
+  char library_path[] = "/tmp/planned_decision.XXXXXX";
+  ASSERT_NE(mkdtemp(library_path), nullptr);
+  const std::string copy = std::string(library_path) + "/libstdc++.so.6";
+  {
+    std::ifstream in(winner, std::ios::binary);
+    std::ofstream out(copy, std::ios::binary);
+    out << in.rdbuf();
+  }
+
+  const char* const libraries[2] = {AUDIT_LIBRARY, AUDIT_LIBRARY_FREESTANDING};
+  for (const char* const library : libraries) {
+    // The payload has a DT_RUNPATH. Its first directory is redirected to the planned winner, and nothing else is tried
+    std::string output;
+    std::vector<std::string> probes = loader_libstdcxx_probes(record_audited_payload(library, AUDIT_PAYLOAD, output));
+    ASSERT_EQ(probes.size(), 1u) << library;
+    EXPECT_EQ(probes[0], "runpath hit " + winner) << library;
+
+    // The plan does not jump over LD_LIBRARY_PATH: its copy is examined, and chosen as it is as new. Before it, ld.so may
+    // miss in the hwcaps subdirectories of LD_LIBRARY_PATH, and nothing after it is tried
+    setenv("LD_LIBRARY_PATH", library_path, 1);
+    probes = loader_libstdcxx_probes(record_audited_payload(library, AUDIT_PAYLOAD, output));
+    unsetenv("LD_LIBRARY_PATH");
+    ASSERT_FALSE(probes.empty()) << library;
+    EXPECT_EQ(probes.back(), "libpath hit " + copy) << library;
+    for (size_t i = 0; i + 1 < probes.size(); i++) {
+      EXPECT_EQ(probes[i].rfind("libpath miss " + std::string(library_path) + "/", 0), 0u) << probes[i];
+    }
+    EXPECT_NE(output.find(copy + "\n"), std::string::npos) << output;
+  }
+  unlink(copy.c_str());
+  rmdir(library_path);
+}
+
+TEST(PlannedDecision, waits_for_the_rpath_of_the_requester) {
+  // The payload has a DT_RUNPATH, but the library it loads, which needs libstdc++, only has a DT_RPATH. ld.so searches that
+  // DT_RPATH before LD_LIBRARY_PATH, so the plan does not apply to it and the copy on LD_LIBRARY_PATH is examined, and chosen
+  char library_path[] = "/tmp/planned_decision.XXXXXX";
+  ASSERT_NE(mkdtemp(library_path), nullptr);
+  const std::string copy = std::string(library_path) + "/libstdc++.so.6";
+  {
+    std::ifstream in(getLibstdcppPath(), std::ios::binary);
+    std::ofstream out(copy, std::ios::binary);
+    out << in.rdbuf();
+  }
+
+  const char* const libraries[2] = {AUDIT_LIBRARY, AUDIT_LIBRARY_FREESTANDING};
+  for (const char* const library : libraries) {
+    setenv("LD_LIBRARY_PATH", library_path, 1);
+    std::string output;
+    const std::vector<std::string> probes = loader_libstdcxx_probes(record_audited_payload(library, AUDIT_DLOPEN_PAYLOAD, output));
+    unsetenv("LD_LIBRARY_PATH");
+    ASSERT_FALSE(probes.empty()) << library;
+    EXPECT_EQ(probes.back(), "libpath hit " + copy) << library;
+    EXPECT_EQ(output, copy + "\n") << library;
+  }
+  unlink(copy.c_str());
+  rmdir(library_path);
+}
+
+TEST(PlannedDecision, resident_for_a_new_namespace) {
+  // The winner between the shipped copy, in the DT_RPATH of the library the payload loads, and the libstdc++ of ld.so.cache
+  const std::string payload = AUDIT_DLOPEN_PAYLOAD;
+  const std::string shipped = payload.substr(0, payload.rfind('/')) + "/shipped/libstdc++.so.6";
+  char cached[PATH_MAX];
+  ASSERT_EQ(find_system_libstdcxx_from_cache("/etc/ld.so.cache", cached, sizeof(cached)), ec_success);
+  uint32_t versions[2] = {0, 0};
+  const char* const candidates[2] = {shipped.c_str(), cached};
+  for (size_t i = 0; i < 2; i++) {
+    const int fd = open(candidates[i], O_RDONLY);
+    ASSERT_GE(fd, 0) << candidates[i];
+    ASSERT_EQ(get_libstdcxx_version(fd, candidates[i], &versions[i]), ec_success);
+    close(fd);
+  }
+  const std::string winner = (versions[1] >= versions[0]) ? cached : shipped;
+
+  const char* const libraries[2] = {AUDIT_LIBRARY, AUDIT_LIBRARY_FREESTANDING};
+  for (const char* const library : libraries) {
+    // The library is loaded after startup, then again by dlmopen in a new namespace. Its DT_RPATH comes before LD_LIBRARY_PATH,
+    // so the first search waits for ld.so.cache, which is redirected to the winner. The search of the new namespace is
+    // answered with the same winner from its first candidate, and the audit library does not search again
+    std::string output;
+    const std::vector<std::string> lines = record_audited_payload(library, AUDIT_DLOPEN_PAYLOAD, output, "dlmopen");
+    const std::vector<std::string> probes = loader_libstdcxx_probes(lines);
+    ASSERT_EQ(probes.size(), 2u) << library;
+    EXPECT_EQ(probes[0], "cache hit " + winner) << library;
+    EXPECT_EQ(probes[1], "runpath hit " + winner) << library;
+    // One libstdc++ per namespace
+    EXPECT_EQ(std::count(output.begin(), output.end(), '\n'), 2) << output;
+    EXPECT_EQ(std::count_if(lines.begin(), lines.end(), [](const std::string& line) { return line.rfind("probe\t0\taudit\t", 0) == 0; }),
+              static_cast<std::ptrdiff_t>(count_audit_probes(library, AUDIT_DLOPEN_PAYLOAD, output)))
+      << library;
+  }
+}
+
+TEST(DecisionEnv, not_published_after_startup) {
+  // The payload unsets a variable ahead of AUDIT_LIBSTDCXX_DECISION before its dlopen, so libc has moved the entries of the
+  // initial environment array by the time the shipped libstdc++ is parsed
+  const char* const libraries[2] = {AUDIT_LIBRARY, AUDIT_LIBRARY_FREESTANDING};
+  for (const char* const library : libraries) {
+    std::string ld_audit = std::string("LD_AUDIT=") + library;
+    char unset[] = "AUDIT_LIBSTDCXX_TEST_UNSET=1";
+    char decision[] = "AUDIT_LIBSTDCXX_DECISION=";
+    char kept[] = "AUDIT_LIBSTDCXX_TEST_KEPT=1";
+    char* envp[] = {&ld_audit[0], unset, decision, kept, nullptr};
+    char* const argv[] = {const_cast<char*>(AUDIT_DLOPEN_PAYLOAD), const_cast<char*>("unsetenv"), nullptr};
+
+    int pipe_fds[2];
+    ASSERT_EQ(pipe(pipe_fds), 0);
+    const pid_t pid = fork();
+    if (pid == 0) {
+      dup2(pipe_fds[1], STDOUT_FILENO);
+      close(pipe_fds[0]);
+      execve(AUDIT_DLOPEN_PAYLOAD, argv, envp);
+      _exit(127);
+    }
+    close(pipe_fds[1]);
+    std::string output;
+    char buffer[4096];
+    for (ssize_t len = read(pipe_fds[0], buffer, sizeof(buffer)); len > 0; len = read(pipe_fds[0], buffer, sizeof(buffer))) {
+      output.append(buffer, static_cast<size_t>(len));
+    }
+    close(pipe_fds[0]);
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0)) << library;
+
+    // The libstdc++, then the variables as libc has them: the other entries are intact and the decision is not published
+    std::istringstream lines(output);
+    std::string line;
+    ASSERT_TRUE(std::getline(lines, line)) << library;
+    EXPECT_NE(line.find("libstdc++"), std::string::npos) << line;
+    std::vector<std::string> variables;
+    while (std::getline(lines, line)) {
+      variables.push_back(line);
+    }
+    EXPECT_EQ(variables, (std::vector<std::string>{"AUDIT_LIBSTDCXX_DECISION=", "AUDIT_LIBSTDCXX_TEST_KEPT=1"})) << library;
   }
 }
+#endif
 
 // clang-format off
 const std::map<std::string, std::string> gcc_ver_to_abi = {
@@ -266,3 +1855,208 @@ TEST(ParseElf, CheckThisGcc) {
       << "This test can fail if the tests are compiled with one gcc version and run with a libstdc++.so.6 from a different gcc version" << std::endl
       << "Ensure that the gcc used to compile this test matches the libstdc++.so.6 used to run it" << std::endl;
 }
+
+// clang-format off
+static const libstdcxx_fingerprint_t shipped_fingerprints[] = {
+#include "libstdcxx_fingerprints.inc"
+};
+// clang-format on
+
+TEST(LibstdcxxFingerprint, shipped_table_is_sorted) {
+  const size_t count = sizeof(shipped_fingerprints) / sizeof(shipped_fingerprints[0]);
+  ASSERT_GT(count, 0);
+  for (size_t i = 0; i < count; i++) {
+    const libstdcxx_fingerprint_t& fingerprint = shipped_fingerprints[i];
+    EXPECT_GT(fingerprint.len_build_id, 0);
+    EXPECT_LE(fingerprint.len_build_id, sizeof(fingerprint.build_id));
+    EXPECT_GE(fingerprint.glibcxx_version, 0x00030400);
+    if (i > 0) {
+      const libstdcxx_fingerprint_t& previous = shipped_fingerprints[i - 1];
+      const int order = memcmp(previous.build_id, fingerprint.build_id, sizeof(fingerprint.build_id));
+      EXPECT_TRUE((order < 0) || ((order == 0) && (previous.len_build_id < fingerprint.len_build_id))) << "Row " << i << " is out of order";
+    }
+    // Every row can be found
+    uint32_t version = 0;
+    EXPECT_EQ(libstdcxx_fingerprint_lookup(shipped_fingerprints, count, fingerprint.build_id, fingerprint.len_build_id, &version), ec_success);
+    EXPECT_EQ(version, fingerprint.glibcxx_version);
+  }
+}
+
+TEST(LibstdcxxFingerprint, lookup) {
+  const libstdcxx_fingerprint_t table[] = {
+    {{0x01, 0x02}, 2, 0x00030410},
+    {{0x01, 0x02}, 20, 0x00030411},
+    {{0x10}, 16, 0x00030420},
+    {{0xff, 0xee}, 20, 0x00030430},
+  };
+  const size_t count = sizeof(table) / sizeof(table[0]);
+  uint8_t build_id[20] = {0x01, 0x02};
+  uint32_t version = 0;
+  // The length is part of the key
+  EXPECT_EQ(libstdcxx_fingerprint_lookup(table, count, build_id, 2, &version), ec_success);
+  EXPECT_EQ(version, 0x00030410);
+  EXPECT_EQ(libstdcxx_fingerprint_lookup(table, count, build_id, 20, &version), ec_success);
+  EXPECT_EQ(version, 0x00030411);
+  EXPECT_EQ(libstdcxx_fingerprint_lookup(table, count, build_id, 16, &version), ec_non_fatal_error);
+
+  const uint8_t last[] = {0xff, 0xee, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  EXPECT_EQ(libstdcxx_fingerprint_lookup(table, count, last, sizeof(last), &version), ec_success);
+  EXPECT_EQ(version, 0x00030430);
+  const uint8_t unknown[] = {0x7f, 0x45};
+  EXPECT_EQ(libstdcxx_fingerprint_lookup(table, count, unknown, sizeof(unknown), &version), ec_non_fatal_error);
+  EXPECT_EQ(libstdcxx_fingerprint_lookup(table, 0, unknown, sizeof(unknown), &version), ec_non_fatal_error);
+  EXPECT_EQ(libstdcxx_fingerprint_lookup(table, count, build_id, 0, &version), ec_non_fatal_error);
+}
+
+TEST(LibstdcxxFingerprint, first_page_of_libstdcxx) {
+  const std::string libstdcxx_path = getLibstdcppPath();
+  const int fd = open(libstdcxx_path.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  struct stat st;
+  ASSERT_EQ(fstat(fd, &st), 0);
+  const char* const mapped = static_cast<const char*>(mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+  ASSERT_NE(mapped, MAP_FAILED);
+  libstdcxx_fingerprint_t known = {};
+  const error_code_t error_build_id = get_elf_build_id(mapped, st.st_size, known.build_id, sizeof(known.build_id), &known.len_build_id);
+  munmap(const_cast<char*>(mapped), st.st_size);
+  if (error_build_id != ec_success) {
+    close(fd);
+    GTEST_SKIP() << libstdcxx_path << " has no build-id";
+  }
+
+  // A version that is not the one of the file shows that the table answered, not the parse
+  known.glibcxx_version = 0x00123456;
+  uint32_t version = 0;
+  EXPECT_EQ(get_libstdcxx_version_from_fingerprint(fd, &known, 1, &version), ec_success);
+  EXPECT_EQ(version, 0x00123456);
+  libstdcxx_fingerprint_t other = known;
+  other.build_id[0] ^= 0xff;
+  EXPECT_EQ(get_libstdcxx_version_from_fingerprint(fd, &other, 1, &version), ec_non_fatal_error);
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+
+  // Known or not, get_libstdcxx_version agrees with the parse
+  uint32_t parsed_version = 0;
+  ASSERT_EQ(get_libstdcxx_version_from_verdef(fd, libstdcxx_path.c_str(), &parsed_version), ec_success);
+  const int fd_again = open(libstdcxx_path.c_str(), O_RDONLY);
+  ASSERT_GE(fd_again, 0);
+  ASSERT_EQ(get_libstdcxx_version(fd_again, libstdcxx_path.c_str(), &version), ec_success);
+  EXPECT_EQ(version, parsed_version);
+}
+
+// Depends on the build host, unlike the shipped table: if the libstdc++ of the host is a build of the corpus, its row agrees with the parse
+TEST(LibstdcxxFingerprint, host_libstdcxx_row) {
+  const std::string libstdcxx_path = getLibstdcppPath();
+  const int fd = open(libstdcxx_path.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  uint32_t version = 0;
+  const error_code_t error =
+    get_libstdcxx_version_from_fingerprint(fd, shipped_fingerprints, sizeof(shipped_fingerprints) / sizeof(shipped_fingerprints[0]), &version);
+  if (error != ec_success) {
+    close(fd);
+    GTEST_SKIP() << libstdcxx_path << " is not in the shipped table";
+  }
+  uint32_t parsed_version = 0;
+  ASSERT_EQ(get_libstdcxx_version_from_verdef(fd, libstdcxx_path.c_str(), &parsed_version), ec_success);
+  EXPECT_EQ(version, parsed_version);
+}
+
+TEST(ForceLibstdcxx, overrides_the_policy) {
+  // Not a libstdc++
+  EXPECT_EQ(force_libstdcxx("/nonexistent/libstdc++.so.6"), ec_fatal_error);
+  char not_libstdcxx[] = "/tmp/force_libstdcxx.XXXXXX";
+  const int fd = mkstemp(not_libstdcxx);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, "not an ELF file", 15), 15);
+  close(fd);
+  EXPECT_EQ(force_libstdcxx(not_libstdcxx), ec_fatal_error);
+  unlink(not_libstdcxx);
+
+  // Every search for libstdc++ is answered with the forced one, the others are left to ld.so
+  const std::string forced = getLibstdcppPath();
+  ASSERT_EQ(force_libstdcxx(forced.c_str()), ec_success);
+  uintptr_t cookie = 0;
+  EXPECT_STREQ(search_libstdcxx("libfoo.so", &cookie, LA_SER_ORIG), "libfoo.so");
+  EXPECT_STREQ(search_libstdcxx("/usr/lib/libfoo.so", &cookie, LA_SER_DEFAULT), "/usr/lib/libfoo.so");
+  EXPECT_EQ(std::string(search_libstdcxx("/opt/newer/libstdc++.so.6", &cookie, LA_SER_LIBPATH)), forced);
+  EXPECT_EQ(std::string(search_libstdcxx("/usr/lib/libstdc++.so.6", &cookie, LA_SER_CONFIG)), forced);
+
+  // The latched answer is given without looking at the candidate, so even candidates that do not exist get it
+  const unsigned int flags[] = {LA_SER_LIBPATH, LA_SER_RUNPATH, LA_SER_CONFIG, LA_SER_DEFAULT};
+  for (const unsigned int flag : flags) {
+    EXPECT_STREQ(search_libstdcxx("/nonexistent/glibc-hwcaps/x86-64-v3/libstdc++.so.6", &cookie, flag), forced.c_str()) << flag;
+  }
+}
+
+TEST(SearchLibstdcxx, latch_and_dedup) {
+  // Two candidates for libstdc++.so.6, a copy of the libstdc++ of the tests and a hard link to it, and an unreadable one
+  char dir[] = "/tmp/search_libstdcxx.XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::string first = std::string(dir) + "/first";
+  const std::string second = std::string(dir) + "/second";
+  const std::string unreadable = std::string(dir) + "/unreadable";
+  for (const std::string& directory : {first, second, unreadable}) {
+    ASSERT_EQ(mkdir(directory.c_str(), 0755), 0);
+  }
+  const std::string first_lib = first + "/libstdc++.so.6";
+  const std::string second_lib = second + "/libstdc++.so.6";
+  const std::string unreadable_lib = unreadable + "/libstdc++.so.6";
+  {
+    std::ifstream in(getLibstdcppPath(), std::ios::binary);
+    std::ofstream out(first_lib, std::ios::binary);
+    out << in.rdbuf();
+  }
+  ASSERT_EQ(link(first_lib.c_str(), second_lib.c_str()), 0);
+  // A socket exists for fstatat but cannot be opened, even by root
+  const int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(sock, 0);
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  ASSERT_LT(unreadable_lib.size(), sizeof(addr.sun_path));
+  memcpy(addr.sun_path, unreadable_lib.c_str(), unreadable_lib.size() + 1);
+  ASSERT_EQ(bind(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+  struct stat st_first;
+  ASSERT_EQ(stat(first_lib.c_str(), &st_first), 0);
+
+  // A shipped libstdc++ newer than any, and nothing decided yet
+  char shipped[] = "/shipped/libstdc++.so.6";
+  shipped_libstdcxx_path = shipped;
+  shipped_glibcxx_version = 0x00FF0000;
+  shipped_dev = 0;
+  shipped_ino = 0;
+  libstdcxx_decision = {nullptr, 0, 0, 0};
+  planned_decision = {nullptr, 0, 0, 0};
+  uintptr_t cookie = 0;
+
+  // The unreadable candidate is released to ld.so as is, and decides nothing
+  EXPECT_EQ(search_libstdcxx(unreadable_lib.c_str(), &cookie, LA_SER_LIBPATH), unreadable_lib.c_str());
+  EXPECT_EQ(libstdcxx_decision.path, nullptr);
+
+  // The first readable candidate is parsed once, older than the shipped one, and latches it
+  EXPECT_STREQ(search_libstdcxx(first_lib.c_str(), &cookie, LA_SER_LIBPATH), shipped);
+  EXPECT_STREQ(libstdcxx_decision.path, shipped);
+  const libstdcxx_memo_entry_t* const entry = libstdcxx_memo_find(st_first.st_dev, st_first.st_ino);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_NE(entry->glibcxx_version, 0u);
+
+  // The same name is searched again: the latch answers every candidate without looking at it
+  EXPECT_STREQ(search_libstdcxx(second_lib.c_str(), &cookie, LA_SER_CONFIG), shipped);
+  EXPECT_STREQ(search_libstdcxx("/nonexistent/libstdc++.so.6", &cookie, LA_SER_DEFAULT), shipped);
+
+  // Without the latch, the second name of the same file is answered from the memo, not parsed: a memo entry marking the
+  // file as a wrong architecture rejects the hard link, although it is a valid libstdc++
+  libstdcxx_decision = {nullptr, 0, 0, 0};
+  libstdcxx_memo_insert(st_first.st_dev, st_first.st_ino, 0xDEADBEEF);
+  EXPECT_EQ(search_libstdcxx(second_lib.c_str(), &cookie, LA_SER_CONFIG), nullptr);
+  EXPECT_EQ(libstdcxx_decision.path, nullptr);
+
+  shipped_libstdcxx_path = nullptr;
+  shipped_glibcxx_version = 0xDEADBEEF;
+  close(sock);
+  for (const std::string& path : {first_lib, second_lib, unreadable_lib}) {
+    unlink(path.c_str());
+  }
+  for (const std::string& directory : {first, second, unreadable}) {
+    rmdir(directory.c_str());
+  }
+  rmdir(dir);
+}